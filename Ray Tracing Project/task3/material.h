@@ -5,6 +5,8 @@
 #define material_h
 #include "vec3.h"
 
+#include <memory>
+
 struct hit_record;
 
 class material {
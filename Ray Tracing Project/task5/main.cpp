@@ -12,6 +12,8 @@
 #include "camera.h"
 #include <cstdlib>
 #include "material.h"
+#include <string>
+#include <vector>
 
 using namespace std;
 
@@ -19,24 +21,49 @@ using namespace std;
 
 const double INF = numeric_limits<double>::infinity();
 
-color ray_color(const ray& r, const hittable& world, int depth) {
-    hit_record rec;
+// Paths may be cut by Russian roulette once they have bounced this often.
+const int roulette_depth = 3;
 
-    // If we've exceeded the ray bounce limit, no more light is gathered.
-    if (depth <= 0)
-        return color(0,0,0);
+// Follows one path iteratively. throughput is the product of the attenuations picked
+// up so far. From roulette_depth bounces on, a path survives with probability equal
+// to its throughput luminance (capped at 1) and survivors are divided by that
+// probability, so the image stays unbiased. Returns the bounce count in bounces.
+color ray_color(ray r, const hittable& world, int max_depth, int& bounces) {
+    color radiance(0,0,0);
+    color throughput(1,1,1);
+    bounces = 0;
+
+    // Each iteration traces one ray; the path ends after max_depth rays.
+    for (int depth = 0; depth < max_depth; depth++) {
+        hit_record rec;
+
+        if (!world.hit(r, 0.001, INF, rec)) {
+            vec3 unit_direction = unit_vector(r.direction());
+            auto t = 0.5*(unit_direction.y() + 1.0);
+            radiance += throughput * ((1.0-t)*color(1.0, 1.0, 1.0) + t*color(0.5, 0.7, 1.0));
+            break;
+        }
 
-    if (world.hit(r, 0.001, INF, rec)) {
         ray scattered;
         color attenuation;
-        if (rec.mat_ptr->scatter(r, rec, attenuation, scattered))
-            return attenuation * ray_color(scattered, world, depth-1);
-        return color(0,0,0);
+        if (!rec.mat_ptr->scatter(r, rec, attenuation, scattered))
+            break;
+
+        throughput = throughput * attenuation;
+        r = scattered;
+        bounces++;
+
+        if (bounces >= roulette_depth) {
+            double p = fmin(1.0, luminance(throughput));
+            if (p < 1) {
+                if (random_double() >= p)
+                    break;
+                throughput /= p;
+            }
+        }
     }
 
-    vec3 unit_direction = unit_vector(r.direction());
-    auto t = 0.5*(unit_direction.y() + 1.0);
-    return (1.0-t)*color(1.0, 1.0, 1.0) + t*color(0.5, 0.7, 1.0);
+    return radiance;
 }
 
 int main() {
@@ -77,6 +104,7 @@ int main() {
     camera cam;
     
     // Render
+    vector<long> path_lengths(max_depth + 1, 0);
     std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
     img << "P3\n" << image_width << ' ' << image_height << "\n255\n";
     
@@ -88,13 +116,31 @@ int main() {
                 auto u = (i + random_double()) / (image_width-1);
                 auto v = (j + random_double()) / (image_height-1);
                 ray r = cam.get_ray(u, v);
-                pixel_color += ray_color(r, world, max_depth);
+                int bounces;
+                pixel_color += ray_color(r, world, max_depth, bounces);
+                path_lengths[bounces]++;
             }
 //            write_color(cout, pixel_color, samples_per_pixel);
             write_color(img, pixel_color, samples_per_pixel);
 
         }
     }
-    std::cerr << "\nDone.\n";
+    // One row each for 0-4 bounces, then doubling ranges.
+    long paths = 0, total_bounces = 0;
+    for (int b = 0; b <= max_depth; b++) {
+        paths += path_lengths[b];
+        total_bounces += b * path_lengths[b];
+    }
+    std::cerr << "\nPath length: mean " << double(total_bounces) / paths << " bounces over " << paths << " paths\n";
+    for (int lo = 0; lo <= max_depth; ) {
+        int hi = lo < 5 ? lo : min(2 * lo - 2, max_depth);
+        long count = 0;
+        for (int b = lo; b <= hi; b++)
+            count += path_lengths[b];
+        if (count > 0)
+            std::cerr << "  " << lo << (hi > lo ? "-" + to_string(hi) : "") << ": " << 100.0 * count / paths << "%\n";
+        lo = hi + 1;
+    }
+    std::cerr << "Done.\n";
     system("open image.ppm");
 }
@@ -9,6 +9,8 @@
 #include "sphere.h"
 #include "hittable.h"
 
+#include <memory>
+
 struct hit_record;
 
 class material {
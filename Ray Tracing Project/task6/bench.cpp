@@ -0,0 +1,393 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+
+// Microbenchmarks for the motion blur renderer.
+// Usage: bench [name ...]   (no names runs everything)
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+#include "vec3.h"
+#include "ray.h"
+#include "sampler.h"
+#include "motion_bvh.h"
+#include "scenes.h"
+#include "camera.h"
+#include "path_tracer.h"
+
+using namespace std;
+
+// Keeps the optimizer from dropping the benchmarked work.
+volatile double bench_sink;
+
+template <class Body>
+double seconds_for(Body body) {
+    auto start = chrono::steady_clock::now();
+    body();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void report(const string& name, double count, double seconds, const char* unit) {
+    cout << "  " << name << ": " << count / seconds / 1e6 << " M" << unit << "/s\n";
+}
+
+
+// Primary rays of a 400-pixel-wide image, with times spread over the shutter.
+vector<ray> camera_rays(const camera& cam, int samples_per_pixel) {
+    const auto aspect_ratio = 16.0 / 9.0;
+    const int image_width = 400;
+    const int image_height = static_cast<int>(image_width / aspect_ratio);
+
+    vector<ray> rays;
+    for (int j = 0; j < image_height; ++j)
+        for (int i = 0; i < image_width; ++i)
+            for (int s = 0; s < samples_per_pixel; ++s) {
+                sampler rng = sampler::for_sample(j*image_width + i, s);
+                rays.push_back(cam.get_ray((i + rng.random_double()) / (image_width-1),
+                                           (j + rng.random_double()) / (image_height-1), rng));
+            }
+    return rays;
+}
+
+double trace_all(const hittable& world, const vector<ray>& rays) {
+    return seconds_for([&] {
+        long hits = 0;
+        hit_record rec;
+        for (const auto& r : rays)
+            hits += world.hit(r, 0.001, numeric_limits<double>::infinity(), rec);
+        bench_sink = hits;
+    });
+}
+
+// Rays whose closest hit differs between two worlds.
+long mismatched_hits(const hittable& a, const hittable& b, const vector<ray>& rays) {
+    long mismatches = 0;
+    for (const auto& r : rays) {
+        hit_record ra, rb;
+        bool ha = a.hit(r, 0.001, numeric_limits<double>::infinity(), ra);
+        bool hb = b.hit(r, 0.001, numeric_limits<double>::infinity(), rb);
+        mismatches += ha != hb || (ha && (ra.t != rb.t || ra.mat_id != rb.mat_id));
+    }
+    return mismatches;
+}
+
+
+// Reports the box swept over its whole shutter whatever instant it is asked
+// about, so a motion_bvh over these is an ordinary BVH of swept boxes.
+class swept : public hittable {
+    public:
+        swept(shared_ptr<hittable> object, double time0, double time1)
+            : object(object), time0(time0), time1(time1) {}
+
+        virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override {
+            return object->hit(r, t_min, t_max, rec);
+        }
+
+        virtual bool bounding_box(double, double, aabb& output_box) const override {
+            return object->bounding_box(time0, time1, output_box);
+        }
+
+    public:
+        shared_ptr<hittable> object;
+        double time0, time1;
+};
+
+// The same spheres frozen at mid-shutter: the best any tree over moving
+// geometry can hope for.
+hittable_list frozen_at(const hittable_list& list, double time) {
+    hittable_list frozen;
+    for (const auto& object : list.objects) {
+        if (auto m = dynamic_cast<const moving_sphere*>(object.get()))
+            frozen.add(make_shared<sphere>(m->center(time), m->radius, m->mat_id));
+        else
+            frozen.add(object);
+    }
+    return frozen;
+}
+
+void bench_motion() {
+    scene world = moving_spheres();
+    cout << "motion (moving_spheres, " << world.objects.objects.size() << " objects)\n";
+    auto rays = camera_rays(camera(point3(13,4,3), point3(0,1,0), vec3(0,1,0), 30, 16.0 / 9.0, 0.0, 10.0, 0.0, 1.0), 2);
+
+    hittable_list swept_objects;
+    for (const auto& object : world.objects.objects)
+        swept_objects.add(make_shared<swept>(object, 0.0, 1.0));
+
+    bvh_build_stats swept_stats, motion_stats, frozen_stats;
+    motion_bvh swept_tree(swept_objects, 0.0, 1.0, &swept_stats);
+    motion_bvh motion_tree(world.objects, 0.0, 1.0, &motion_stats);
+    motion_bvh frozen_tree(frozen_at(world.objects, 0.5), 0.0, 1.0, &frozen_stats);
+    cout << "  swept boxes " << swept_stats << '\n';
+    cout << "  motion " << motion_stats << '\n';
+
+    cout << "  mismatches against the flat list: swept " << mismatched_hits(world.objects, swept_tree, rays)
+         << ", motion " << mismatched_hits(world.objects, motion_tree, rays) << '\n';
+    report("flat hittable_list", rays.size(), trace_all(world.objects, rays), "rays");
+    report("BVH over swept boxes", rays.size(), trace_all(swept_tree, rays), "rays");
+    report("motion BVH", rays.size(), trace_all(motion_tree, rays), "rays");
+    report("static spheres at mid-shutter, same tree", rays.size(), trace_all(frozen_tree, rays), "rays");
+}
+
+
+// Renders world at width x height with spp samples per pixel drawn from sequence.
+float_image render_at(thread_pool& pool, const scene& sc, const hittable& world, const light_list& lights,
+                      const camera& cam, const color& background, int width, int height, int spp,
+                      bool light_sampling, double& seconds, sample_sequence sequence = independent_samples) {
+    render_options options;
+    options.sampling.min_spp = options.sampling.max_spp = spp;
+    options.sampling.sequence = sequence;
+    options.light_sampling = light_sampling;
+    vector<pixel_statistics> pixels;
+    path_histogram lengths;
+    float_image image;
+    seconds = seconds_for([&] {
+        image = render_scene(pool, world, sc.materials, lights, cam, background, width, height, 50, options,
+                             pixels, lengths);
+    });
+    return image;
+}
+
+double rms_error(const float_image& a, const float_image& b) {
+    double sum = 0;
+    for (size_t k = 0; k < a.rgb.size(); k++)
+        sum += (a.rgb[k] - b.rgb[k]) * (a.rgb[k] - b.rgb[k]);
+    return sqrt(sum / a.rgb.size());
+}
+
+double mean_value(const float_image& a) {
+    double sum = 0;
+    for (float x : a.rgb)
+        sum += x;
+    return sum / a.rgb.size();
+}
+
+// The error against a 1024-spp reference of renders with and without light
+// sampling, for the scenes of main lit only by their emitters. The error falls
+// as one over the square root of spp, so the squared ratio of the errors is how
+// many times more samples the plain renders need for the same error.
+void bench_lights() {
+    struct light_scene { const char* name; scene sc; camera cam; };
+    const int width = 96, height = 54;
+    light_scene scenes[] = {
+        {"simple_light", simple_light(),
+         camera(point3(26,3,6), point3(0,2,0), vec3(0,1,0), 20, 16.0 / 9.0, 0.0, 10.0, 0.0, 1.0)},
+        {"random_scene (emissive)", random_scene(),
+         camera(point3(13,2,3), point3(0,0,0), vec3(0,1,0), 20, 16.0 / 9.0, 0.1, 10.0, 0.0, 1.0)},
+    };
+
+    thread_pool pool(std::thread::hardware_concurrency());
+    for (auto& ls : scenes) {
+        motion_bvh world(ls.sc.objects, 0.0, 1.0);
+        light_list lights(ls.sc.objects, ls.sc.materials);
+        cout << "lights (" << ls.name << ", " << lights.size() << " lights, " << width << "x" << height << ")\n";
+
+        double seconds;
+        auto reference = render_at(pool, ls.sc, world, lights, ls.cam, color(0,0,0), width, height, 1024, true, seconds);
+        auto plain_reference = render_at(pool, ls.sc, world, lights, ls.cam, color(0,0,0), width, height, 1024, false, seconds);
+        cout << "  mean of the 1024-spp references: with light sampling " << mean_value(reference)
+             << ", without " << mean_value(plain_reference) << '\n';
+
+        for (int spp : {4, 16, 64}) {
+            double t_plain, t_nee;
+            double plain = rms_error(render_at(pool, ls.sc, world, lights, ls.cam, color(0,0,0), width, height, spp, false, t_plain), reference);
+            double nee = rms_error(render_at(pool, ls.sc, world, lights, ls.cam, color(0,0,0), width, height, spp, true, t_nee), reference);
+            cout << "  " << spp << " spp: rms error " << plain << " without, " << nee << " with light sampling ("
+                 << t_plain * 1000 << " / " << t_nee * 1000 << " ms), "
+                 << (plain / nee) * (plain / nee) << "x the samples for the same error, "
+                 << (plain / nee) * (plain / nee) * t_plain / t_nee << "x the time\n";
+        }
+    }
+}
+
+
+// The error against a 4096-spp Sobol reference of every sequence at 1 to 256
+// spp, on main's scenes. Independent samples halve their error for each four
+// times the samples; the others do better while the integrand is smooth. The
+// last column is how many independent samples would give the same error.
+void bench_convergence() {
+    struct convergence_scene { const char* name; scene sc; camera cam; color background; };
+    const int width = 96, height = 54;
+    convergence_scene scenes[] = {
+        {"random_scene (emissive)", random_scene(),
+         camera(point3(13,2,3), point3(0,0,0), vec3(0,1,0), 20, 16.0 / 9.0, 0.1, 10.0, 0.0, 1.0), color(0,0,0)},
+        {"simple_light", simple_light(),
+         camera(point3(26,3,6), point3(0,2,0), vec3(0,1,0), 20, 16.0 / 9.0, 0.0, 10.0, 0.0, 1.0), color(0,0,0)},
+        {"moving_spheres", moving_spheres(),
+         camera(point3(13,4,3), point3(0,1,0), vec3(0,1,0), 30, 16.0 / 9.0, 0.0, 10.0, 0.0, 1.0),
+         color(0.70, 0.80, 1.00)},
+    };
+    const int counts[] = {1, 4, 16, 64, 256};
+
+    thread_pool pool(std::thread::hardware_concurrency());
+    for (auto& cs : scenes) {
+        motion_bvh world(cs.sc.objects, 0.0, 1.0);
+        light_list lights(cs.sc.objects, cs.sc.materials);
+        cout << "convergence (" << cs.name << ", " << width << "x" << height << ")\n";
+
+        double seconds;
+        auto reference = render_at(pool, cs.sc, world, lights, cs.cam, cs.background, width, height, 4096, true,
+                                   seconds, sobol_samples);
+        double independent_error[5];
+        for (int k = independent_samples; k <= blue_noise_samples; k++) {
+            auto sequence = static_cast<sample_sequence>(k);
+            cout << "  " << sequence_name(sequence) << ":";
+            for (int c = 0; c < 5; c++) {
+                double error = rms_error(render_at(pool, cs.sc, world, lights, cs.cam, cs.background, width, height,
+                                                   counts[c], true, seconds, sequence), reference);
+                if (sequence == independent_samples)
+                    independent_error[c] = error;
+                double ratio = independent_error[c] / error;
+                cout << ' ' << counts[c] << " spp " << error << " (" << ratio * ratio << "x)";
+            }
+            cout << '\n';
+        }
+    }
+}
+
+
+// The former scatter of metal and isotropic, which drew points in the unit
+// sphere by rejection: kept here only to compare against. Their draw count
+// varies, so the renderer, with a fixed count of sample dimensions per bounce,
+// cannot use them.
+vec3 rejection_in_unit_sphere(sampler& rng) {
+    while (true) {
+        auto p = vec3::random(rng, -1,1);
+        if (p.length_squared() >= 1) continue;
+        return p;
+    }
+}
+
+bool rejection_metal_scatter(const metal& m, const ray& r_in, const hit_record& rec, sampler& rng,
+                             scatter_sample& s) {
+    vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
+    s.direction = reflected + m.fuzz*rejection_in_unit_sphere(rng);
+    s.weight = m.albedo;
+    return dot(s.direction, rec.normal) > 0;
+}
+
+bool rejection_isotropic_scatter(const isotropic& m, const ray& r_in, const hit_record& rec, sampler& rng,
+                                 scatter_sample& s) {
+    s.direction = rejection_in_unit_sphere(rng);
+    s.weight = m.albedo->value(rec.u, rec.v, rec.p);
+    return true;
+}
+
+// Hits on a surface facing +y, seen from directions spread over the hemisphere.
+vector<pair<ray, hit_record>> scatter_inputs(int count) {
+    vector<pair<ray, hit_record>> inputs;
+    sampler rng(7);
+    for (int k = 0; k < count; k++) {
+        hit_record rec;
+        rec.p = point3(0, 0, 0);
+        rec.normal = vec3(0, 1, 0);
+        rec.u = rec.v = 0.5;
+        rec.front_face = true;
+        vec3 d = onb(rec.normal).local(random_cosine_direction(rng));
+        inputs.push_back({ray(d, -d, 0.5), rec});
+    }
+    return inputs;
+}
+
+template <class Scatter>
+double scatter_all(const vector<pair<ray, hit_record>>& inputs, int rounds, Scatter scatter) {
+    sampler rng(11);
+    return seconds_for([&] {
+        long kept = 0;
+        double sum = 0;
+        for (int round = 0; round < rounds; round++)
+            for (const auto& in : inputs) {
+                scatter_sample s;
+                kept += scatter(in.first, in.second, rng, s);
+                sum += s.direction.y();
+            }
+        bench_sink = sum + kept;
+    });
+}
+
+// The sample of a material against its eval and pdf: the mean weight of its
+// samples must match the integral of eval over the hemisphere, estimated with
+// uniform directions, and pdf must give back the density sample drew with.
+void check_material(const string& name, const material& m, const ray& r_in, const hit_record& rec) {
+    const int n = 1 << 20;
+    sampler rng(17);
+    color by_sample(0,0,0), by_eval(0,0,0);
+    double pdf_error = 0;
+    for (int k = 0; k < n; k++) {
+        scatter_sample s;
+        if (m.sample(r_in, rec, rng, s)) {
+            by_sample += s.weight;
+            pdf_error = max(pdf_error, fabs(m.pdf(r_in, rec, s.direction) - s.pdf) / s.pdf);
+        }
+        vec3 d = random_unit_vector(rng);
+        by_eval += m.eval(r_in, rec, d) * (4*PI);
+    }
+    cout << "  " << name << ": reflectance by sample " << by_sample / n << ", by eval " << by_eval / n
+         << ", largest relative pdf mismatch " << pdf_error << '\n';
+}
+
+// Calls per second of the closed-form sample of each material, next to the
+// rejection-sampled scatter metal and isotropic used before.
+void bench_scatter() {
+    const int rounds = 20;
+    auto inputs = scatter_inputs(1 << 16);
+    lambertian diffuse(color(0.5, 0.5, 0.5));
+    metal rough(color(0.8, 0.8, 0.8), 0.3);
+    metal mirror(color(0.8, 0.8, 0.8), 0.0);
+    dielectric glass(1.5);
+    isotropic fog(color(0.5, 0.5, 0.5));
+    cout << "scatter (" << inputs.size() * rounds << " calls each)\n";
+
+    auto run = [&](const string& name, auto scatter) {
+        report(name, double(inputs.size()) * rounds, scatter_all(inputs, rounds, scatter), "calls");
+    };
+    auto sample_of = [](const material& m) {
+        return [&m](const ray& r, const hit_record& rec, sampler& rng, scatter_sample& s) {
+            return m.sample(r, rec, rng, s);
+        };
+    };
+    run("lambertian sample", sample_of(diffuse));
+    run("metal (fuzz 0.3) sample, GGX", sample_of(rough));
+    run("metal (fuzz 0.3) scatter by rejection", [&](const ray& r, const hit_record& rec, sampler& rng, scatter_sample& s) {
+        return rejection_metal_scatter(rough, r, rec, rng, s);
+    });
+    run("metal (fuzz 0) sample", sample_of(mirror));
+    run("dielectric sample", sample_of(glass));
+    run("isotropic sample", sample_of(fog));
+    run("isotropic scatter by rejection", [&](const ray& r, const hit_record& rec, sampler& rng, scatter_sample& s) {
+        return rejection_isotropic_scatter(fog, r, rec, rng, s);
+    });
+
+    hit_record rec = inputs[0].second;
+    vec3 d = unit_vector(vec3(1, -1, 0));
+    ray r_in(-d, d, 0.5);
+    check_material("lambertian", diffuse, r_in, rec);
+    check_material("metal (fuzz 0.3) at 45 degrees", rough, r_in, rec);
+    check_material("metal (fuzz 0.8) at 45 degrees", metal(color(1,1,1), 0.8), r_in, rec);
+}
+
+
+struct benchmark {
+    const char* name;
+    void (*run)();
+};
+
+int main(int argc, char* argv[]) {
+    vector<benchmark> benchmarks = {
+        {"motion", bench_motion},
+        {"lights", bench_lights},
+        {"scatter", bench_scatter},
+        {"convergence", bench_convergence},
+    };
+
+    for (const auto& b : benchmarks) {
+        bool selected = argc == 1;
+        for (int a = 1; a < argc; a++)
+            selected = selected || strcmp(argv[a], b.name) == 0;
+        if (selected)
+            b.run();
+    }
+}
@@ -37,15 +37,14 @@ class camera {
             time1 = _time1;
         }
 
-        ray get_ray(double s, double t) const {
-            vec3 rd = lens_radius * random_in_unit_disk();
+        ray get_ray(double s, double t, sampler& rng) const {
+            rng.start_dimension(lens_dimension, 2);
+            vec3 rd = lens_radius * random_in_unit_disk(rng);
             vec3 offset = u * rd.x() + v * rd.y();
 
-            return ray(
-                origin + offset,
-                lower_left_corner + s*horizontal + t*vertical - origin - offset,
-                random_double(time0, time1)
-            );
+            rng.start_dimension(time_dimension, 1);
+            double time = rng.random_double(time0, time1);
+            return ray(origin + offset, lower_left_corner + s*horizontal + t*vertical - origin - offset, time);
         }
 
     private:
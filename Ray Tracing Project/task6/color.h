@@ -14,7 +14,14 @@ inline double clamp(double x, double min, double max) {
     return x;
 }
 
-void write_color(std::ostream &out, color pixel_color, int samples_per_pixel) {
+// Relative luminance of a linear RGB color (Rec. 709 weights).
+inline double luminance(const color& c) {
+    return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+}
+
+// The 8-bit value of every component: averaged over the samples and
+// gamma-corrected for gamma=2.0.
+inline void color_bytes(color pixel_color, int samples_per_pixel, unsigned char out[3]) {
     auto r = pixel_color.x();
     auto g = pixel_color.y();
     auto b = pixel_color.z();
@@ -24,12 +31,20 @@ void write_color(std::ostream &out, color pixel_color, int samples_per_pixel) {
     r = sqrt(scale * r);
     g = sqrt(scale * g);
     b = sqrt(scale * b);
-    
 
-    // Write the translated [0,255] value of each color component.
-    out << static_cast<int>(256 * clamp(r, 0.0, 0.999)) << ' '
-        << static_cast<int>(256 * clamp(g, 0.0, 0.999)) << ' '
-        << static_cast<int>(256 * clamp(b, 0.0, 0.999)) << '\n';
+    // The translated [0,255] value of each color component.
+    out[0] = static_cast<unsigned char>(256 * clamp(r, 0.0, 0.999));
+    out[1] = static_cast<unsigned char>(256 * clamp(g, 0.0, 0.999));
+    out[2] = static_cast<unsigned char>(256 * clamp(b, 0.0, 0.999));
+}
+
+// One ASCII P3 pixel. The renderers write whole images through image.h instead.
+void write_color(std::ostream &out, color pixel_color, int samples_per_pixel) {
+    unsigned char rgb[3];
+    color_bytes(pixel_color, samples_per_pixel, rgb);
+    out << static_cast<int>(rgb[0]) << ' '
+        << static_cast<int>(rgb[1]) << ' '
+        << static_cast<int>(rgb[2]) << '\n';
 }
 
 #endif /* color_h */
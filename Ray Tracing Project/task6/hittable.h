@@ -10,6 +10,7 @@
 #include "vec3.h"
 
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <limits>
 #include <memory>
@@ -37,7 +38,7 @@ class material;
 struct hit_record {
     point3 p;
     vec3 normal;
-    shared_ptr<material> mat_ptr;
+    uint32_t mat_id;        // index into the scene's material_table
     double t;
     double u;
     double v;
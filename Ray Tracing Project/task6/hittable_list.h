@@ -5,6 +5,7 @@
 #ifndef hittable_list_h
 #define hittable_list_h
 #include "hittable.h"
+#include "material.h"
 
 #include <memory>
 #include <vector>
@@ -29,15 +30,15 @@ class hittable_list : public hittable  {
 
 
 bool hittable_list::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
-    hit_record temp_rec;
     auto hit_anything = false;
     auto closest_so_far = t_max;
 
+    // Objects only write rec when they report a hit, and every hit is closer than
+    // the last, so the record is filled in place instead of copied.
     for (const auto& object : objects) {
-        if (object->hit(r, t_min, closest_so_far, temp_rec)) {
+        if (object->hit(r, t_min, closest_so_far, rec)) {
             hit_anything = true;
-            closest_so_far = temp_rec.t;
-            rec = temp_rec;
+            closest_so_far = rec.t;
         }
     }
 
@@ -60,4 +61,11 @@ bool hittable_list::bounding_box(double time0, double time1, aabb& output_box) c
     return true;
 }
 
+// What a scene function hands the renderer: the objects, and the materials they
+// refer to by index.
+struct scene {
+    hittable_list objects;
+    material_table materials;
+};
+
 #endif /* hittable_list_h */
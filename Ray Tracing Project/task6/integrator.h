@@ -0,0 +1,89 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef integrator_h
+#define integrator_h
+
+#include "color.h"
+#include "sampler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+
+// Paths may be cut by Russian roulette once they have bounced this often.
+const int default_roulette_depth = 3;
+
+
+// Russian roulette: a path survives with probability p, the luminance of its
+// throughput capped at 1, and survivors are divided by p so the estimate stays
+// unbiased. Paths carrying full throughput are never cut.
+inline bool survives_roulette(color& throughput, sampler& rng) {
+    double p = std::min(1.0, luminance(throughput));
+    if (p >= 1)
+        return true;
+    if (rng.random_double() >= p)
+        return false;
+    throughput /= p;
+    return true;
+}
+
+
+// How many bounces the paths of a render took. The tile workers add to it
+// concurrently, so the counters are atomic.
+struct path_histogram {
+    static const int bins = 65;     // the last bin also holds longer paths
+    std::atomic<long> counts[bins];
+
+    path_histogram() {
+        for (auto& c : counts)
+            c = 0;
+    }
+
+    void add(int bounces) {
+        counts[std::min(bounces, bins - 1)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    long total() const {
+        long n = 0;
+        for (const auto& c : counts)
+            n += c;
+        return n;
+    }
+
+    double mean() const {
+        double sum = 0;
+        for (int b = 0; b < bins; b++)
+            sum += double(b) * counts[b];
+        long n = total();
+        return n ? sum / n : 0;
+    }
+};
+
+// Prints the mean and the share of paths per bounce count: one row each for
+// 0-4 bounces, then doubling ranges.
+inline std::ostream& operator<<(std::ostream &out, const path_histogram &h) {
+    long n = std::max(1L, h.total());
+    out << "Path length: mean " << h.mean() << " bounces over " << h.total() << " paths\n";
+
+    for (int lo = 0; lo < path_histogram::bins; ) {
+        int hi = lo < 5 ? lo : std::min(2 * lo - 2, path_histogram::bins - 1);
+        long c = 0;
+        for (int b = lo; b <= hi; b++)
+            c += h.counts[b];
+        if (c > 0) {
+            std::string label = lo == hi ? std::to_string(lo) : std::to_string(lo) + "-" + std::to_string(hi);
+            char row[64];
+            std::snprintf(row, sizeof(row), "  %5s: %6.2f%%\n", label.c_str(), 100.0 * c / n);
+            out << row;
+        }
+        lo = hi + 1;
+    }
+    return out;
+}
+
+#endif /* integrator_h */
@@ -0,0 +1,160 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef lights_h
+#define lights_h
+
+#include "color.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "moving_sphere.h"
+#include "onb.h"
+#include "sampler.h"
+#include "sphere.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+// An emissive sphere, moving or not, as the light sampler sees it.
+struct sphere_light {
+    point3 center0, center1;
+    double time0 = 0, time1 = 1;
+    double radius;
+    uint32_t mat_id;
+
+    point3 center(double time) const {
+        if (time1 == time0)
+            return center0;
+        return center0 + ((time - time0) / (time1 - time0))*(center1 - center0);
+    }
+
+    // Cosine of the half angle of the cone the sphere fills seen from p, or 1
+    // when p is inside it and no direction can be sampled.
+    double cos_theta_max(const point3& p, double time) const {
+        double d2 = (center(time) - p).length_squared();
+        if (d2 <= radius*radius)
+            return 1;
+        return std::sqrt(1 - radius*radius / d2);
+    }
+
+    // Density over solid angle of sample_direction, the same for every direction
+    // in the cone; 0 from inside.
+    double pdf(const point3& p, double time) const {
+        double cos_max = cos_theta_max(p, time);
+        return cos_max < 1 ? 1 / (2*PI * (1 - cos_max)) : 0;
+    }
+
+    // A direction from p uniformly within the cone of the sphere, which unlike
+    // points on its surface never wastes a sample on the far side.
+    vec3 sample_direction(const point3& p, double time, sampler& rng) const {
+        double cos_theta = 1 + rng.random_double() * (cos_theta_max(p, time) - 1);
+        double sin_theta = std::sqrt(std::max(0.0, 1 - cos_theta*cos_theta));
+        double phi = 2*PI * rng.random_double();
+        return onb(unit_vector(center(time) - p)).local(std::cos(phi)*sin_theta, std::sin(phi)*sin_theta, cos_theta);
+    }
+
+    // Whether rec, found along a ray at the given time, lies on this light.
+    bool owns(const hit_record& rec, double time) const {
+        return rec.mat_id == mat_id
+            && std::fabs((rec.p - center(time)).length() - radius) <= 1e-6 * radius + 1e-9;
+    }
+};
+
+
+// The emissive spheres of a scene, for next-event estimation. A light is picked
+// with probability proportional to its power, its emission summed over the
+// channels times its cross-section; weighing the channels by luminance instead
+// would starve blue lights of samples.
+class light_list {
+    public:
+        light_list() {}
+        light_list(const hittable_list& objects, const material_table& materials) {
+            collect(objects, materials);
+            double total = 0;
+            for (double& c : cdf) {
+                total += c;
+                c = total;
+            }
+            for (double& c : cdf)
+                c /= total;
+            by_material.resize(materials.size());
+            for (uint32_t i = 0; i < lights.size(); i++)
+                by_material[lights[i].mat_id].push_back(i);
+        }
+
+        bool empty() const { return lights.empty(); }
+        size_t size() const { return lights.size(); }
+
+        // Picks a light by power; its probability goes to probability.
+        uint32_t pick(sampler& rng, double& probability) const {
+            double u = rng.random_double();
+            auto found = std::upper_bound(cdf.begin(), cdf.end(), u);
+            uint32_t i = found == cdf.end() ? static_cast<uint32_t>(cdf.size() - 1)
+                                            : static_cast<uint32_t>(found - cdf.begin());
+            probability = selection_probability(i);
+            return i;
+        }
+
+        double selection_probability(uint32_t i) const {
+            return i == 0 ? cdf[0] : cdf[i] - cdf[i-1];
+        }
+
+        // The light rec lies on, or -1 when it lies on none.
+        int find(const hit_record& rec, double time) const {
+            if (rec.mat_id >= by_material.size())
+                return -1;
+            for (uint32_t i : by_material[rec.mat_id])
+                if (lights[i].owns(rec, time))
+                    return static_cast<int>(i);
+            return -1;
+        }
+
+        // Density over solid angle with which light sampling from p picks the
+        // direction towards light i.
+        double pdf(uint32_t i, const point3& p, double time) const {
+            return selection_probability(i) * lights[i].pdf(p, time);
+        }
+
+    public:
+        std::vector<sphere_light> lights;
+
+    private:
+        // Spheres and moving spheres with an emitting material, through nested
+        // lists. Other emitters are still found by paths that hit them.
+        void collect(const hittable_list& list, const material_table& materials) {
+            for (const auto& object : list.objects) {
+                sphere_light light;
+                if (auto nested = dynamic_cast<const hittable_list*>(object.get())) {
+                    collect(*nested, materials);
+                    continue;
+                } else if (auto s = dynamic_cast<const sphere*>(object.get())) {
+                    light.center0 = light.center1 = s->center;
+                    light.radius = s->radius;
+                    light.mat_id = s->mat_id;
+                } else if (auto m = dynamic_cast<const moving_sphere*>(object.get())) {
+                    light.center0 = m->center0;
+                    light.center1 = m->center1;
+                    light.time0 = m->time0;
+                    light.time1 = m->time1;
+                    light.radius = m->radius;
+                    light.mat_id = m->mat_id;
+                } else {
+                    continue;
+                }
+                color emitted = materials[light.mat_id].emitted(0.5, 0.5, light.center0);
+                double sum = emitted.x() + emitted.y() + emitted.z();
+                if (materials[light.mat_id].is_emitter() && sum > 0) {
+                    lights.push_back(light);
+                    cdf.push_back(sum * light.radius * light.radius);
+                }
+            }
+        }
+
+        std::vector<double> cdf;
+        std::vector<std::vector<uint32_t>> by_material;
+};
+
+#endif /* lights_h */
@@ -2,7 +2,7 @@
 //  Copyright © 2020 melihkurtaran. All rights reserved.
 
 #include <iostream>
-#include <fstream>
+#include <chrono>
 #include "ray.h"
 #include "vec3.h"
 #include "color.h"
@@ -12,125 +12,33 @@
 #include "camera.h"
 #include <cstdlib>
 #include "material.h"
+#include "path_tracer.h"
+#include "scenes.h"
+#include "motion_bvh.h"
 
 using namespace std;
 
-// Constants
-
-const double INF = numeric_limits<double>::infinity();
-
-hittable_list simple_light() {
-    hittable_list objects;
-
-    auto material = make_shared<lambertian>(color(0.2, 0.2, 0.7));
-    auto redlight = make_shared<diffuse_light>(color(1,0,0));
-    auto bluelight = make_shared<diffuse_light>(color(0,0,1));
-    auto greenlight = make_shared<diffuse_light>(color(0,1,0));
-    objects.add(make_shared<sphere>(point3(0,-1000,0), 1000, material));
-    objects.add(make_shared<sphere>(point3(-3, 2, 2), 2, redlight));
-    objects.add(make_shared<sphere>(point3(3, 2, 2), 2, greenlight));
-    objects.add(make_shared<sphere>(point3(0, 6, 6), 2, bluelight));
-    objects.add(make_shared<sphere>(point3(0, 2, 2), 2, material));
-
-    return objects;
-}
-
-hittable_list two_spheres() {
-    hittable_list objects;
-
-    auto material = make_shared<lambertian>(color(0.2, 0.2, 0.7));
-    objects.add(make_shared<sphere>(point3(0,-1000,0), 1000, material));
-    objects.add(make_shared<sphere>(point3(0, 2, 0), 2, material));
-
-    return objects;
+// path in single quotes for the shell, each ' in it closed, escaped and reopened.
+std::string shell_quoted(const std::string& path) {
+    std::string quoted = "'";
+    for (char c : path)
+        quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+    return quoted + "'";
 }
 
-color ray_color(const ray& r, const color& background, const hittable& world, int depth) {
-    hit_record rec;
-
-    // If we've exceeded the ray bounce limit, no more light is gathered.
-    if (depth <= 0)
-        return color(0,0,0);
-
-    // If the ray hits nothing, return the background color.
-    if (!world.hit(r, 0.001, INF, rec))
-        return background;
-
-    ray scattered;
-    color attenuation;
-    color emitted = rec.mat_ptr->emitted(rec.u, rec.v, rec.p);
-
-    if (!rec.mat_ptr->scatter(r, rec, attenuation, scattered))
-        return emitted;
-
-    return emitted + attenuation * ray_color(scattered, background, world, depth-1);
-}
-
-hittable_list random_scene() {
-    hittable_list world;
-
-    auto ground_material = make_shared<lambertian>(color(0.7, 0.2, 0.3));
-    world.add(make_shared<sphere>(point3(0,-1000,0), 1000, ground_material));
-
-    for (int a = -11; a < 11; a++) {
-        for (int b = -11; b < 11; b++) {
-            auto choose_mat = random_double();
-            point3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
-
-            if ((center - point3(4, 0.2, 0)).length() > 0.9) {
-                shared_ptr<material> sphere_material;
-
-                if (choose_mat < 0.8) {
-                    // diffuse
-                    auto albedo = color::random() * color::random();
-                    sphere_material = make_shared<diffuse_light>(albedo);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                } else if (choose_mat < 0.95) {
-                    // metal
-                    auto albedo = color::random(0.5, 1);
-                    auto fuzz = random_double(0, 0.5);
-                    sphere_material = make_shared<metal>(albedo, fuzz);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                } else {
-                    // glass
-                    sphere_material = make_shared<dielectric>(1.5);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-            }
-        }
-    }
-
-    auto material1 = make_shared<lambertian>(color(0.2, 0.2, 0.7));
-    world.add(make_shared<sphere>(point3(-5, 1.5, 0), 1.5, material1));
-
-    auto material2 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
-    world.add(make_shared<sphere>(point3(-1, 1.5, 0), 1.5, material2));
-
-    auto material3 = make_shared<dielectric>(0.9);
-    world.add(make_shared<sphere>(point3(2, 1, 0), 1, material3));
-    auto material4 = make_shared<dielectric>(1.1);
-    world.add(make_shared<sphere>(point3(5, 1, 0), 1, material4));
-    auto material5 = make_shared<dielectric>(2.5);
-    world.add(make_shared<sphere>(point3(8, 1, 0), 1, material5));
+int main(int argc, char* argv[]) {
     
-    return world;
-}
-
-
-int main() {
-    
-    ofstream img("image.ppm");
+    render_options options = parse_render_options(argc, argv);
 
     // Image
     const auto aspect_ratio = 16.0 / 9.0;
     const int image_width = 400;
     const int image_height = static_cast<int>(image_width / aspect_ratio);
-    const int samples_per_pixel = 100;
     const int max_depth = 50;
     
     // World
     
-    hittable_list world;
+    scene world;
 
     point3 lookfrom;
     point3 lookat;
@@ -138,7 +46,7 @@ int main() {
     auto aperture = 0.0;
     color background(0,0,0);
 
-    switch (1) {
+    switch (options.scene) {
         case 1:
             world = random_scene();
             background = color(0.0, 0.0, 0.0);
@@ -157,8 +65,24 @@ int main() {
             vfov = 20.0;
             break;
             break;
+
+        case 3:
+            world = moving_spheres();
+            background = color(0.70, 0.80, 1.00);
+            lookfrom = point3(13,4,3);
+            lookat = point3(0,1,0);
+            vfov = 30.0;
+            break;
     }
 
+    // Boxes at shutter open and close, interpolated by each ray's time.
+    bvh_build_stats bvh_stats;
+    motion_bvh world_bvh(world.objects, 0.0, 1.0, &bvh_stats);
+    std::cerr << world.objects.objects.size() << " objects, " << bvh_stats << "\n";
+    light_list lights(world.objects, world.materials);
+    if (options.light_sampling)
+        std::cerr << "Sampling " << lights.size() << " lights\n";
+
     // Camera
 
     vec3 vup(0,1,0);
@@ -166,24 +90,38 @@ int main() {
     camera cam(lookfrom, lookat, vup, vfov, aspect_ratio, aperture, dist_to_focus, 0.0, 1.0);
     
     // Render
-    std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
-    img << "P3\n" << image_width << ' ' << image_height << "\n255\n";
-    
-    for (int j = image_height-1; j >= 0; --j) {
-        std::cerr << "\rScanlines remaining: " << j << ' ' << std::flush;
-        for (int i = 0; i < image_width; ++i) {
-            color pixel_color(0, 0, 0);
-            for (int s = 0; s < samples_per_pixel; ++s) {
-                auto u = (i + random_double()) / (image_width-1);
-                auto v = (j + random_double()) / (image_height-1);
-                ray r = cam.get_ray(u, v);
-                pixel_color += ray_color(r, background, world, max_depth);
-            }
-//            write_color(cout, pixel_color, samples_per_pixel);
-            write_color(img, pixel_color, samples_per_pixel);
-
-        }
+    thread_pool pool(options.threads);
+    std::cerr << "Rendering with " << pool.size() << " threads, "
+              << options.tile_size << "x" << options.tile_size << " tiles, "
+              << sequence_name(options.sampling.sequence) << " samples\n";
+
+    std::vector<pixel_statistics> pixels;
+    path_histogram path_lengths;
+
+    auto framebuffer = render_scene(pool, world_bvh, world.materials, lights, cam, background,
+                                    image_width, image_height, max_depth, options, pixels, path_lengths);
+
+    std::cerr << "\n";
+    long total_samples = 0;
+    for (const auto& stats : pixels)
+        total_samples += stats.count;
+    std::cerr << "Average " << double(total_samples) / pixels.size() << " samples per pixel\n";
+    std::cerr << path_lengths;
+
+    auto write_start = std::chrono::steady_clock::now();
+    if (!write_image(options.output, framebuffer, 1)) {
+        std::cerr << "Could not write " << options.output << '\n';
+        return 1;
     }
-    std::cerr << "\nDone.\n";
-    system("open image.ppm");
+    std::cerr << "Wrote " << options.output << " in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - write_start).count()
+              << " ms\n";
+    if (!options.heatmap.empty() &&
+        !write_image(options.heatmap, sample_heatmap(pixels, image_width, image_height, options.sampling), 1))
+        std::cerr << "Could not write " << options.heatmap << '\n';
+    std::cerr << "Done.\n";
+#ifdef __APPLE__
+    if (options.open)
+        system(("open " + shell_quoted(options.output)).c_str());
+#endif
 }
@@ -5,8 +5,22 @@
 #ifndef material_h
 #define material_h
 #include "hittable.h"
+#include "onb.h"
 #include "texture.h"
 
+#include <vector>
+
+
+// A direction drawn by material::sample. weight is what the path throughput is
+// multiplied by: the BSDF times the cosine over pdf, or the attenuation of a
+// specular bounce. pdf is the density over solid angle, and 0 for a specular
+// bounce, whose direction no other strategy could have drawn.
+struct scatter_sample {
+    vec3 direction;
+    color weight;
+    double pdf;
+};
+
 
 class material {
     public:
@@ -14,9 +28,23 @@ class material {
             return color(0,0,0);
         }
 
-        virtual bool scatter(
-            const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered
-        ) const = 0;
+        virtual bool is_emitter() const { return false; }
+
+        // Draws the direction the path continues in after r_in hits at rec, or
+        // returns false when it is absorbed. Every material draws in closed form,
+        // with a fixed count of random numbers and no rejection loop.
+        virtual bool sample(const ray& r_in, const hit_record& rec, sampler& rng, scatter_sample& s) const = 0;
+
+        // The BSDF times the cosine towards direction, and the density with which
+        // sample draws direction; both 0 for specular materials, which light
+        // sampling cannot reach.
+        virtual color eval(const ray& r_in, const hit_record& rec, const vec3& direction) const {
+            return color(0,0,0);
+        }
+
+        virtual double pdf(const ray& r_in, const hit_record& rec, const vec3& direction) const {
+            return 0;
+        }
 };
 
 
@@ -25,37 +53,122 @@ class lambertian : public material {
         lambertian(const color& a) : albedo(make_shared<solid_color>(a)) {}
         lambertian(shared_ptr<texture> a) : albedo(a) {}
 
-        virtual bool scatter(
-            const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered
-        ) const override {
-            auto scatter_direction = rec.normal + random_unit_vector();
-
-            scattered = ray(rec.p, scatter_direction, r_in.time());
-            attenuation = albedo->value(rec.u, rec.v, rec.p);
+        // Cosine-weighted, so the weight is the plain albedo.
+        virtual bool sample(const ray& r_in, const hit_record& rec, sampler& rng, scatter_sample& s) const override {
+            s.direction = onb(rec.normal).local(random_cosine_direction(rng));
+            s.weight = albedo->value(rec.u, rec.v, rec.p);
+            s.pdf = std::fmax(dot(rec.normal, s.direction), 0.0) / PI;
             return true;
         }
 
+        virtual color eval(const ray& r_in, const hit_record& rec, const vec3& direction) const override {
+            return albedo->value(rec.u, rec.v, rec.p) * pdf(r_in, rec, direction);
+        }
+
+        virtual double pdf(const ray& r_in, const hit_record& rec, const vec3& direction) const override {
+            return std::fmax(dot(rec.normal, unit_vector(direction)), 0.0) / PI;
+        }
+
     public:
         shared_ptr<texture> albedo;
 };
 
 
+// A GGX microfacet reflector, with fuzz read as its roughness: alpha = fuzz^2.
+// Without fuzz it is a perfect mirror. albedo is its reflectance at every angle.
 class metal : public material {
     public:
-        metal(const color& a, double f) : albedo(a), fuzz(f < 1 ? f : 1) {}
+        metal(const color& a, double f) : albedo(a), fuzz(f < 1 ? f : 1), alpha(fuzz * fuzz) {}
 
-        virtual bool scatter(
-            const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered
-        ) const override {
-            vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
-            scattered = ray(rec.p, reflected + fuzz*random_in_unit_sphere(), r_in.time());
-            attenuation = albedo;
-            return (dot(scattered.direction(), rec.normal) > 0);
+        // Draws a microfacet normal among those visible from r_in (Heitz 2018),
+        // so the weight only holds the shadowing of the reflected direction.
+        virtual bool sample(const ray& r_in, const hit_record& rec, sampler& rng, scatter_sample& s) const override {
+            vec3 unit_direction = unit_vector(r_in.direction());
+            if (specular()) {
+                s.direction = reflect(unit_direction, rec.normal);
+                s.weight = albedo;
+                s.pdf = 0;
+                return dot(s.direction, rec.normal) > 0;
+            }
+
+            onb frame(rec.normal);
+            vec3 wo = frame.to_local(-unit_direction);
+            if (wo.z() <= 0)
+                return false;
+
+            // The visible normals, in the frame where the lobe is a hemisphere.
+            vec3 vh = unit_vector(vec3(alpha * wo.x(), alpha * wo.y(), wo.z()));
+            double len2 = vh.x()*vh.x() + vh.y()*vh.y();
+            vec3 t1 = len2 > 0 ? vec3(-vh.y(), vh.x(), 0) / std::sqrt(len2) : vec3(1, 0, 0);
+            vec3 t2 = cross(vh, t1);
+            double r = std::sqrt(rng.random_double());
+            double phi = 2*PI * rng.random_double();
+            double p1 = r * std::cos(phi);
+            double p2 = r * std::sin(phi);
+            double blend = 0.5 * (1 + vh.z());
+            p2 = (1 - blend) * std::sqrt(1 - p1*p1) + blend * p2;
+            vec3 nh = p1*t1 + p2*t2 + std::sqrt(std::fmax(0.0, 1 - p1*p1 - p2*p2))*vh;
+            vec3 h = unit_vector(vec3(alpha * nh.x(), alpha * nh.y(), std::fmax(0.0, nh.z())));
+
+            vec3 wi = 2*dot(wo, h)*h - wo;
+            if (wi.z() <= 0)
+                return false;
+            s.direction = frame.local(wi);
+            s.weight = albedo * ((1 + lambda(wo.z())) / (1 + lambda(wo.z()) + lambda(wi.z())));
+            s.pdf = distribution(h.z()) / (4 * wo.z() * (1 + lambda(wo.z())));
+            return true;
+        }
+
+        virtual color eval(const ray& r_in, const hit_record& rec, const vec3& direction) const override {
+            double cos_o, cos_i, cos_h;
+            if (!half_vector(r_in, rec, direction, cos_o, cos_i, cos_h))
+                return color(0,0,0);
+            return albedo * (distribution(cos_h) / (4 * cos_o * (1 + lambda(cos_o) + lambda(cos_i))));
+        }
+
+        virtual double pdf(const ray& r_in, const hit_record& rec, const vec3& direction) const override {
+            double cos_o, cos_i, cos_h;
+            if (!half_vector(r_in, rec, direction, cos_o, cos_i, cos_h))
+                return 0;
+            return distribution(cos_h) / (4 * cos_o * (1 + lambda(cos_o)));
         }
 
     public:
         color albedo;
         double fuzz;
+        double alpha;
+
+    private:
+        bool specular() const { return alpha < 1e-4; }
+
+        // The GGX distribution of normals at cos_h from the surface normal.
+        double distribution(double cos_h) const {
+            double a2 = alpha * alpha;
+            double d = cos_h * cos_h * (a2 - 1) + 1;
+            return a2 / (PI * d * d);
+        }
+
+        // Smith's shadowing: 1 / (1 + lambda) is the share of facets seen at cos.
+        double lambda(double cos) const {
+            double tan2 = (1 - cos * cos) / (cos * cos);
+            return 0.5 * (std::sqrt(1 + alpha * alpha * tan2) - 1);
+        }
+
+        // The cosines of both directions and of their half vector with the normal,
+        // or false when either lies below the surface.
+        bool half_vector(const ray& r_in, const hit_record& rec, const vec3& direction,
+                         double& cos_o, double& cos_i, double& cos_h) const {
+            if (specular())
+                return false;
+            vec3 wo = -unit_vector(r_in.direction());
+            vec3 wi = unit_vector(direction);
+            cos_o = dot(wo, rec.normal);
+            cos_i = dot(wi, rec.normal);
+            if (cos_o <= 0 || cos_i <= 0)
+                return false;
+            cos_h = dot(unit_vector(wo + wi), rec.normal);
+            return true;
+        }
 };
 
 
@@ -63,10 +176,7 @@ class dielectric : public material {
     public:
         dielectric(double index_of_refraction) : ir(index_of_refraction) {}
 
-        virtual bool scatter(
-            const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered
-        ) const override {
-            attenuation = color(1.0, 1.0, 1.0);
+        virtual bool sample(const ray& r_in, const hit_record& rec, sampler& rng, scatter_sample& s) const override {
             double refraction_ratio = rec.front_face ? (1.0/ir) : ir;
 
             vec3 unit_direction = unit_vector(r_in.direction());
@@ -74,14 +184,13 @@ class dielectric : public material {
             double sin_theta = sqrt(1.0 - cos_theta*cos_theta);
 
             bool cannot_refract = refraction_ratio * sin_theta > 1.0;
-            vec3 direction;
 
-            if (cannot_refract || reflectance(cos_theta, refraction_ratio) > random_double())
-                direction = reflect(unit_direction, rec.normal);
+            if (cannot_refract || reflectance(cos_theta, refraction_ratio) > rng.random_double())
+                s.direction = reflect(unit_direction, rec.normal);
             else
-                direction = refract(unit_direction, rec.normal, refraction_ratio);
-
-            scattered = ray(rec.p, direction, r_in.time());
+                s.direction = refract(unit_direction, rec.normal, refraction_ratio);
+            s.weight = color(1.0, 1.0, 1.0);
+            s.pdf = 0;
             return true;
         }
 
@@ -103,9 +212,7 @@ class diffuse_light : public material {
         diffuse_light(shared_ptr<texture> a) : emit(a) {}
         diffuse_light(color c) : emit(make_shared<solid_color>(c)) {}
 
-        virtual bool scatter(
-            const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered
-        ) const override {
+        virtual bool sample(const ray& r_in, const hit_record& rec, sampler& rng, scatter_sample& s) const override {
             return false;
         }
 
@@ -113,6 +220,8 @@ class diffuse_light : public material {
             return emit->value(u, v, p);
         }
 
+        virtual bool is_emitter() const override { return true; }
+
     public:
         shared_ptr<texture> emit;
 };
@@ -123,16 +232,41 @@ class isotropic : public material {
         isotropic(color c) : albedo(make_shared<solid_color>(c)) {}
         isotropic(shared_ptr<texture> a) : albedo(a) {}
 
-        virtual bool scatter(
-            const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered
-        ) const override {
-            scattered = ray(rec.p, random_in_unit_sphere(), r_in.time());
-            attenuation = albedo->value(rec.u, rec.v, rec.p);
+        // Scatters uniformly over the sphere, whatever the normal.
+        virtual bool sample(const ray& r_in, const hit_record& rec, sampler& rng, scatter_sample& s) const override {
+            s.direction = random_unit_vector(rng);
+            s.weight = albedo->value(rec.u, rec.v, rec.p);
+            s.pdf = 1 / (4*PI);
             return true;
         }
 
+        virtual color eval(const ray& r_in, const hit_record& rec, const vec3& direction) const override {
+            return albedo->value(rec.u, rec.v, rec.p) / (4*PI);
+        }
+
+        virtual double pdf(const ray& r_in, const hit_record& rec, const vec3& direction) const override {
+            return 1 / (4*PI);
+        }
+
     public:
         shared_ptr<texture> albedo;
 };
 
+// Every material of a scene, owned in one place. Primitives and hit records refer
+// to a material by its index, so recording a hit copies no reference count.
+class material_table {
+    public:
+        uint32_t add(shared_ptr<material> m) {
+            materials.push_back(m);
+            return static_cast<uint32_t>(materials.size() - 1);
+        }
+
+        const material& operator[](uint32_t id) const { return *materials[id]; }
+
+        size_t size() const { return materials.size(); }
+
+    public:
+        std::vector<shared_ptr<material>> materials;
+};
+
 #endif /* material_h */
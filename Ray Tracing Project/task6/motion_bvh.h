@@ -0,0 +1,372 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef motion_bvh_h
+#define motion_bvh_h
+
+#include "hittable.h"
+#include "hittable_list.h"
+#include "aabb.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+
+// What the builder reports about the tree it made.
+struct bvh_build_stats {
+    double build_seconds = 0;
+    size_t node_count = 0;
+    size_t leaf_count = 0;
+    double sah_cost = 0;   // expected cost of a random ray, relative to the root box
+};
+
+inline std::ostream& operator<<(std::ostream &out, const bvh_build_stats &s) {
+    return out << "BVH: " << s.node_count << " nodes, " << s.leaf_count << " leaves, SAH cost "
+               << s.sah_cost << ", built in " << s.build_seconds * 1000 << " ms";
+}
+
+
+// Surface area heuristic costs, relative to one primitive intersection.
+const double bvh_traversal_cost = 1.0;
+const double bvh_intersection_cost = 1.0;
+const int bvh_bin_count = 12;
+
+
+// One scene object as seen by the builder: its box when the shutter opens and
+// when it closes, and the centroid halfway between.
+struct motion_primitive {
+    shared_ptr<hittable> object;
+    aabb box0;
+    aabb box1;
+    point3 centroid;
+};
+
+// A node's two boxes. Summing their areas scores a split by the boxes rays meet
+// on average rather than by the box swept over the whole shutter.
+struct motion_bounds {
+    aabb box0;
+    aabb box1;
+
+    void enclose(const motion_primitive& p, bool first) {
+        box0 = first ? p.box0 : surrounding_box(box0, p.box0);
+        box1 = first ? p.box1 : surrounding_box(box1, p.box1);
+    }
+
+    double area() const { return 0.5 * (box0.area() + box1.area()); }
+};
+
+
+// 56-byte node of the flattened tree, laid out like linear_bvh_node in task7 but
+// with a box at each end of the shutter. A ray at time t tests the box
+// interpolated between them: that bounds every object whose box moves linearly
+// over the shutter, as a moving_sphere's does, and is much tighter than the box
+// swept over the whole shutter once things move further than they are wide.
+struct motion_bvh_node {
+    float bounds0_min[3];   // at time0
+    float bounds0_max[3];
+    float bounds1_min[3];   // at time1
+    float bounds1_max[3];
+    uint32_t offset;    // leaf: first primitive, interior: index of the second child
+    uint16_t count;     // primitives in a leaf, 0 for an interior node
+    uint8_t axis;       // split axis of an interior node
+    uint8_t pad;
+};
+
+static_assert(sizeof(motion_bvh_node) == 56, "motion_bvh_node must stay 56 bytes");
+
+
+// Binned SAH tree over the boxes at shutter open and close, compacted into one
+// array and traversed with an explicit stack. Objects that move other than
+// linearly between time0 and time1 should be given a box that already covers
+// their path at both ends.
+class motion_bvh : public hittable {
+    public:
+        motion_bvh() {}
+        motion_bvh(const hittable_list& list, double time0, double time1,
+                   bvh_build_stats* stats = nullptr);
+
+        virtual bool hit(
+            const ray& r, double t_min, double t_max, hit_record& rec) const override;
+
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
+
+    public:
+        std::vector<motion_bvh_node> nodes;
+        std::vector<shared_ptr<hittable>> objects;  // in leaf order, keeps them alive
+        std::vector<const hittable*> leaf_objects;  // same order, what traversal reads
+        double time0 = 0;
+        double time1 = 1;
+
+        static const int max_leaf_size = 4;
+        static const int max_depth = 64;
+
+    private:
+        uint32_t build(std::vector<motion_primitive>& primitives, size_t start, size_t end,
+                       bvh_build_stats& stats, int depth);
+};
+
+
+struct motion_split_result {
+    size_t mid;     // first index of the right half
+    int axis;       // split axis, or -1 when all centroids coincide
+    double cost;    // sum of count*area over both halves
+};
+
+// Bins the mid-shutter centroids along each axis, picks the cheapest plane by the
+// surface area heuristic and partitions the range around it.
+motion_split_result motion_sah_split(std::vector<motion_primitive>& primitives, size_t start, size_t end) {
+    aabb centroid_bounds(primitives[start].centroid, primitives[start].centroid);
+    for (size_t i = start + 1; i < end; i++)
+        centroid_bounds = surrounding_box(centroid_bounds, aabb(primitives[i].centroid, primitives[i].centroid));
+
+    int best_axis = -1;
+    int best_bin = 0;
+    double best_cost = std::numeric_limits<double>::infinity();
+
+    for (int axis = 0; axis < 3; axis++) {
+        double lo = centroid_bounds.min()[axis];
+        double extent = centroid_bounds.max()[axis] - lo;
+        if (extent <= 0)
+            continue;
+
+        motion_bounds bin_bounds[bvh_bin_count];
+        size_t bin_size[bvh_bin_count] = {};
+        for (size_t i = start; i < end; i++) {
+            int b = std::min(bvh_bin_count - 1, static_cast<int>(bvh_bin_count * (primitives[i].centroid[axis] - lo) / extent));
+            bin_bounds[b].enclose(primitives[i], bin_size[b] == 0);
+            bin_size[b]++;
+        }
+
+        // Sweep from the right to get the area and count of every right-hand side.
+        double right_area[bvh_bin_count];
+        size_t right_size[bvh_bin_count];
+        motion_bounds acc;
+        size_t count = 0;
+        for (int b = bvh_bin_count - 1; b > 0; b--) {
+            if (bin_size[b]) {
+                acc.box0 = count ? surrounding_box(acc.box0, bin_bounds[b].box0) : bin_bounds[b].box0;
+                acc.box1 = count ? surrounding_box(acc.box1, bin_bounds[b].box1) : bin_bounds[b].box1;
+            }
+            count += bin_size[b];
+            right_area[b] = count ? acc.area() : 0;
+            right_size[b] = count;
+        }
+
+        count = 0;
+        for (int b = 0; b < bvh_bin_count - 1; b++) {
+            if (bin_size[b]) {
+                acc.box0 = count ? surrounding_box(acc.box0, bin_bounds[b].box0) : bin_bounds[b].box0;
+                acc.box1 = count ? surrounding_box(acc.box1, bin_bounds[b].box1) : bin_bounds[b].box1;
+            }
+            count += bin_size[b];
+            if (count == 0 || right_size[b+1] == 0)
+                continue;
+
+            double cost = count * acc.area() + right_size[b+1] * right_area[b+1];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = b;
+            }
+        }
+    }
+
+    if (best_axis < 0) {
+        // All centroids coincide: any split is as good as another.
+        auto mid = start + (end - start) / 2;
+        motion_bounds left, right;
+        for (size_t i = start; i < mid; i++) left.enclose(primitives[i], i == start);
+        for (size_t i = mid; i < end; i++) right.enclose(primitives[i], i == mid);
+        return {mid, -1, (mid - start) * left.area() + (end - mid) * right.area()};
+    }
+
+    double lo = centroid_bounds.min()[best_axis];
+    double extent = centroid_bounds.max()[best_axis] - lo;
+    auto split = std::partition(primitives.begin() + start, primitives.begin() + end,
+        [&](const motion_primitive& p) {
+            int b = std::min(bvh_bin_count - 1, static_cast<int>(bvh_bin_count * (p.centroid[best_axis] - lo) / extent));
+            return b <= best_bin;
+        });
+
+    return {static_cast<size_t>(split - primitives.begin()), best_axis, best_cost};
+}
+
+
+inline void set_node_bounds(float (&lo)[3], float (&hi)[3], const aabb& box) {
+    for (int a = 0; a < 3; a++) {
+        lo[a] = std::nextafter(static_cast<float>(box.min()[a]), -INFINITY);
+        hi[a] = std::nextafter(static_cast<float>(box.max()[a]), INFINITY);
+    }
+}
+
+
+motion_bvh::motion_bvh(const hittable_list& list, double time0, double time1, bvh_build_stats* stats)
+    : time0(time0), time1(time1) {
+    auto start_time = std::chrono::steady_clock::now();
+
+    // A box asked for over an instant is the box at that instant.
+    std::vector<motion_primitive> primitives;
+    primitives.reserve(list.objects.size());
+    for (const auto& object : list.objects) {
+        motion_primitive p;
+        p.object = object;
+        if (!object->bounding_box(time0, time0, p.box0) || !object->bounding_box(time1, time1, p.box1))
+            std::cerr << "No bounding box in BVH builder.\n";
+        p.centroid = 0.25 * (p.box0.min() + p.box0.max() + p.box1.min() + p.box1.max());
+        primitives.push_back(p);
+    }
+
+    nodes.reserve(2 * primitives.size());
+    objects.reserve(primitives.size());
+
+    bvh_build_stats local_stats;
+    if (!primitives.empty())
+        build(primitives, 0, primitives.size(), local_stats, 0);
+
+    for (const auto& object : objects)
+        leaf_objects.push_back(object.get());
+
+    if (!nodes.empty()) {
+        const auto& root = nodes[0];
+        aabb root0(point3(root.bounds0_min[0], root.bounds0_min[1], root.bounds0_min[2]),
+                   point3(root.bounds0_max[0], root.bounds0_max[1], root.bounds0_max[2]));
+        aabb root1(point3(root.bounds1_min[0], root.bounds1_min[1], root.bounds1_min[2]),
+                   point3(root.bounds1_max[0], root.bounds1_max[1], root.bounds1_max[2]));
+        local_stats.sah_cost /= 0.5 * (root0.area() + root1.area());
+    }
+    local_stats.build_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    if (stats)
+        *stats = local_stats;
+}
+
+
+uint32_t motion_bvh::build(std::vector<motion_primitive>& primitives, size_t start, size_t end,
+                           bvh_build_stats& stats, int depth) {
+    auto index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+    stats.node_count++;
+
+    motion_bounds bounds;
+    for (size_t i = start; i < end; i++)
+        bounds.enclose(primitives[i], i == start);
+    set_node_bounds(nodes[index].bounds0_min, nodes[index].bounds0_max, bounds.box0);
+    set_node_bounds(nodes[index].bounds1_min, nodes[index].bounds1_max, bounds.box1);
+
+    size_t span = end - start;
+    motion_split_result split = {start, -1, 0};
+    bool make_leaf = span == 1 || depth >= max_depth - 1;
+
+    if (!make_leaf) {
+        split = motion_sah_split(primitives, start, end);
+        double leaf_cost = span * bounds.area() * bvh_intersection_cost;
+        double split_cost = bounds.area() * bvh_traversal_cost + split.cost * bvh_intersection_cost;
+        make_leaf = span <= max_leaf_size && leaf_cost <= split_cost;
+    }
+
+    if (make_leaf) {
+        nodes[index].offset = static_cast<uint32_t>(objects.size());
+        nodes[index].count = static_cast<uint16_t>(span);
+        for (size_t i = start; i < end; i++)
+            objects.push_back(primitives[i].object);
+        stats.leaf_count++;
+        stats.sah_cost += span * bounds.area() * bvh_intersection_cost;
+        return index;
+    }
+
+    stats.sah_cost += bounds.area() * bvh_traversal_cost;
+    build(primitives, start, split.mid, stats, depth + 1);
+    uint32_t second = build(primitives, split.mid, end, stats, depth + 1);
+
+    // nodes may have been reallocated by the recursive calls.
+    nodes[index].offset = second;
+    nodes[index].count = 0;
+    nodes[index].axis = static_cast<uint8_t>(split.axis < 0 ? 0 : split.axis);
+    return index;
+}
+
+
+bool motion_bvh::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+    if (nodes.empty())
+        return false;
+
+    const point3 origin = r.origin();
+    const vec3 inv_dir(1 / r.direction().x(), 1 / r.direction().y(), 1 / r.direction().z());
+    const bool dir_is_neg[3] = { inv_dir.x() < 0, inv_dir.y() < 0, inv_dir.z() < 0 };
+
+    // Where the ray's time falls in the shutter, clamped so a stray time still
+    // gets a box that bounds the objects at one of its ends.
+    double s = time1 > time0 ? (r.time() - time0) / (time1 - time0) : 0;
+    s = s < 0 ? 0 : (s > 1 ? 1 : s);
+
+    uint32_t stack[max_depth];
+    int stack_size = 0;
+    uint32_t current = 0;
+    bool hit_anything = false;
+
+    while (true) {
+        const motion_bvh_node& node = nodes[current];
+
+        // Slab test against the node box at the ray's time, using the closest hit
+        // found so far.
+        double t0 = t_min, t1 = t_max;
+        for (int a = 0; a < 3 && t0 <= t1; a++) {
+            double lo = node.bounds0_min[a] + s * (node.bounds1_min[a] - node.bounds0_min[a]);
+            double hi = node.bounds0_max[a] + s * (node.bounds1_max[a] - node.bounds0_max[a]);
+            double near = ((dir_is_neg[a] ? hi : lo) - origin[a]) * inv_dir[a];
+            double far  = ((dir_is_neg[a] ? lo : hi) - origin[a]) * inv_dir[a];
+            t0 = near > t0 ? near : t0;
+            t1 = far < t1 ? far : t1;
+        }
+
+        if (t0 <= t1) {
+            if (node.count > 0) {
+                for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                    if (leaf_objects[i]->hit(r, t_min, t_max, rec)) {
+                        hit_anything = true;
+                        t_max = rec.t;
+                    }
+                }
+            } else {
+                // Visit the child on the near side of the split plane first.
+                if (dir_is_neg[node.axis]) {
+                    stack[stack_size++] = current + 1;
+                    current = node.offset;
+                } else {
+                    stack[stack_size++] = node.offset;
+                    current = current + 1;
+                }
+                continue;
+            }
+        }
+
+        if (stack_size == 0)
+            break;
+        current = stack[--stack_size];
+    }
+
+    return hit_anything;
+}
+
+
+// The box swept over the shutter: the union of the root boxes at both ends.
+bool motion_bvh::bounding_box(double time0, double time1, aabb& output_box) const {
+    if (nodes.empty())
+        return false;
+
+    const auto& root = nodes[0];
+    output_box = surrounding_box(
+        aabb(point3(root.bounds0_min[0], root.bounds0_min[1], root.bounds0_min[2]),
+             point3(root.bounds0_max[0], root.bounds0_max[1], root.bounds0_max[2])),
+        aabb(point3(root.bounds1_min[0], root.bounds1_min[1], root.bounds1_min[2]),
+             point3(root.bounds1_max[0], root.bounds1_max[1], root.bounds1_max[2])));
+    return true;
+}
+
+#endif /* motion_bvh_h */
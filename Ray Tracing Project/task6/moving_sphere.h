@@ -10,8 +10,8 @@ class moving_sphere : public hittable {
     public:
         moving_sphere() {}
         moving_sphere(
-            point3 cen0, point3 cen1, double _time0, double _time1, double r, shared_ptr<material> m)
-            : center0(cen0), center1(cen1), time0(_time0), time1(_time1), radius(r), mat_ptr(m)
+            point3 cen0, point3 cen1, double _time0, double _time1, double r, uint32_t m)
+            : center0(cen0), center1(cen1), time0(_time0), time1(_time1), radius(r), mat_id(m)
         {};
 
         virtual bool hit(
@@ -25,7 +25,7 @@ class moving_sphere : public hittable {
         point3 center0, center1;
         double time0, time1;
         double radius;
-        shared_ptr<material> mat_ptr;
+        uint32_t mat_id;
 };
 
 point3 moving_sphere::center(double time) const {
@@ -54,7 +54,7 @@ bool moving_sphere::hit(const ray& r, double t_min, double t_max, hit_record& re
     rec.p = r.at(rec.t);
     auto outward_normal = (rec.p - center(r.time())) / radius;
     rec.set_face_normal(r, outward_normal);
-    rec.mat_ptr = mat_ptr;
+    rec.mat_id = mat_id;
 
     return true;
 }
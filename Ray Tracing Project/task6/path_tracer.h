@@ -0,0 +1,141 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef path_tracer_h
+#define path_tracer_h
+
+#include "camera.h"
+#include "hittable.h"
+#include "integrator.h"
+#include "lights.h"
+#include "material.h"
+#include "render.h"
+
+#include <limits>
+#include <vector>
+
+
+// Weight of a sample taken with density a when b could have taken it too.
+inline double power_heuristic(double a, double b) {
+    return a*a / (a*a + b*b);
+}
+
+// Next-event estimation at a non-specular hit: a light picked by power, a
+// direction within its cone, and a shadow ray that has to reach that light before
+// anything else. Weighted by the power heuristic against the material sampling
+// the same direction, which ray_color counts when its bounce hits the light.
+// depth picks the bounce's sample dimensions.
+color sample_light(const ray& r_in, const hit_record& rec, const material& mat, const hittable& world,
+                   const material_table& materials, const light_list& lights, sampler& rng, int depth) {
+    const double time = r_in.time();
+    double pick_probability;
+    rng.start_dimension(bounce_dimension(depth, light_pick_dimension), 1);
+    const sphere_light& light = lights.lights[lights.pick(rng, pick_probability)];
+    double light_pdf = pick_probability * light.pdf(rec.p, time);
+    if (light_pdf == 0)
+        return color(0,0,0);
+
+    // Directions the material never scatters to, e.g. below the surface, carry
+    // nothing and need no shadow ray.
+    rng.start_dimension(bounce_dimension(depth, light_dimension), 2);
+    vec3 direction = light.sample_direction(rec.p, time, rng);
+    double bsdf_pdf = mat.pdf(r_in, rec, direction);
+    if (bsdf_pdf == 0)
+        return color(0,0,0);
+
+    hit_record shadow;
+    if (!world.hit(ray(rec.p, direction, time), 0.001, std::numeric_limits<double>::infinity(), shadow)
+        || !light.owns(shadow, time))
+        return color(0,0,0);
+
+    color emitted = materials[shadow.mat_id].emitted(shadow.u, shadow.v, shadow.p);
+    return mat.eval(r_in, rec, direction) * emitted * (power_heuristic(light_pdf, bsdf_pdf) / light_pdf);
+}
+
+
+// Follows one path iteratively. throughput is the product of the attenuations
+// picked up so far; from roulette_depth bounces on, Russian roulette ends paths
+// that can no longer carry much light. The bounce count goes to lengths.
+// With light sampling, every hit that is not specular also samples a light, and
+// emission the path then runs into is weighted against that by MIS.
+color ray_color(ray r, const color& background, const hittable& world, const material_table& materials,
+                const light_list& lights, int max_depth, const render_options& options, sampler& rng,
+                path_histogram& lengths) {
+    const bool light_sampling = options.light_sampling && !lights.empty();
+    color radiance(0,0,0);
+    color throughput(1,1,1);
+    int bounces = 0;
+
+    // The density with which the last bounce picked r, and where it bounced; 0
+    // when r comes from the camera or a bounce that sampled no light, e.g. a
+    // specular one, whose hits on lights count in full.
+    double bsdf_pdf = 0;
+    point3 bounce_point;
+
+    // Each iteration traces one ray; the path ends after max_depth rays.
+    for (int depth = 0; depth < max_depth; depth++) {
+        hit_record rec;
+
+        // If the ray hits nothing, it picks up the background color.
+        if (!world.hit(r, 0.001, std::numeric_limits<double>::infinity(), rec)) {
+            radiance += throughput * background;
+            break;
+        }
+
+        const material& mat = materials[rec.mat_id];
+        color emitted = mat.emitted(rec.u, rec.v, rec.p);
+        if (bsdf_pdf > 0 && mat.is_emitter()) {
+            int light = lights.find(rec, r.time());
+            double light_pdf = light < 0 ? 0 : lights.pdf(static_cast<uint32_t>(light), bounce_point, r.time());
+            emitted = emitted * power_heuristic(bsdf_pdf, light_pdf);
+        }
+        radiance += throughput * emitted;
+
+        scatter_sample sample;
+        rng.start_dimension(bounce_dimension(depth, bsdf_dimension), 2);
+        if (!mat.sample(r, rec, rng, sample))
+            break;
+
+        bsdf_pdf = 0;
+        if (light_sampling && sample.pdf > 0) {
+            radiance += throughput * sample_light(r, rec, mat, world, materials, lights, rng, depth);
+            bsdf_pdf = sample.pdf;
+            bounce_point = rec.p;
+        }
+
+        throughput = throughput * sample.weight;
+        r = ray(rec.p, sample.direction, r.time());
+        bounces++;
+
+        rng.start_dimension(bounce_dimension(depth, roulette_dimension), 1);
+        if (options.roulette && bounces >= options.roulette_depth && !survives_roulette(throughput, rng))
+            break;
+    }
+
+    lengths.add(bounces);
+    return radiance;
+}
+
+
+// Renders world as seen by cam with the sampling and tiling settings of options;
+// main and the benchmarks both come through here. The statistics of every pixel
+// are left in pixels and the paths counted in lengths.
+float_image render_scene(thread_pool& pool, const hittable& world, const material_table& materials,
+                         const light_list& lights, const camera& cam, const color& background,
+                         int image_width, int image_height, int max_depth, const render_options& options,
+                         std::vector<pixel_statistics>& pixels, path_histogram& lengths) {
+    return render_adaptive(pool, image_width, image_height, options.tile_size, options.sampling, pixels,
+        [&](int i, int j, int first, int count, pixel_statistics& stats) {
+            for (int s = first; s < first + count; ++s) {
+                sampler rng = sampler::for_pixel(options.sampling.sequence, i, j, image_width, s,
+                                                 options.sampling.max_spp);
+                auto u = (i + rng.random_double()) / (image_width-1);
+                auto v = (j + rng.random_double()) / (image_height-1);
+                ray r = cam.get_ray(u, v, rng);
+                stats.add(ray_color(r, background, world, materials, lights, max_depth, options, rng, lengths));
+            }
+        });
+}
+
+#endif /* path_tracer_h */
@@ -0,0 +1,187 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef render_h
+#define render_h
+
+#include "adaptive.h"
+#include "image.h"
+#include "integrator.h"
+#include "thread_pool.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+struct render_options {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    int tile_size = 16;
+    std::string output = "image.ppm";   // .ppm (binary P6), .pfm or .png
+    std::string heatmap;                // samples per pixel image, written when set
+    sampling_options sampling;
+    bool roulette = true;               // Russian roulette after roulette_depth bounces
+    int roulette_depth = default_roulette_depth;
+    int scene = 1;                      // which of main's scenes to render
+    bool light_sampling = true;         // next-event estimation with MIS at diffuse hits
+    bool open = false;                  // show the image when done; macOS only
+};
+
+
+inline void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--threads N] [--tile-size N] [--output FILE]\n"
+              << "       [--spp N] [--min-spp N] [--threshold X] [--heatmap FILE]\n"
+              << "       [--roulette-depth N] [--no-roulette] [--scene N]\n"
+              << "       [--no-light-sampling] [--sampler independent|stratified|sobol|blue-noise]\n"
+              << "       [--open]\n";
+}
+
+// Accepts both "--threads 8" and "--threads=8".
+render_options parse_render_options(int argc, char* argv[]) {
+    render_options options;
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        std::string value;
+
+        if (arg == "--no-roulette") {
+            options.roulette = false;
+            continue;
+        }
+        if (arg == "--no-light-sampling") {
+            options.light_sampling = false;
+            continue;
+        }
+        if (arg == "--open") {
+            options.open = true;
+            continue;
+        }
+
+        auto eq = arg.find('=');
+        if (eq != std::string::npos) {
+            value = arg.substr(eq + 1);
+            arg = arg.substr(0, eq);
+        } else if (a + 1 < argc) {
+            value = argv[++a];
+        }
+
+        int number = std::atoi(value.c_str());
+        if (arg == "--threads" && number > 0) {
+            options.threads = static_cast<unsigned>(number);
+        } else if (arg == "--tile-size" && number > 0) {
+            options.tile_size = number;
+        } else if (arg == "--output" && !value.empty()) {
+            options.output = value;
+        } else if (arg == "--spp" && number > 0) {
+            options.sampling.max_spp = number;
+        } else if (arg == "--min-spp" && number > 0) {
+            options.sampling.min_spp = number;
+        } else if (arg == "--threshold" && !value.empty() && std::atof(value.c_str()) >= 0) {
+            options.sampling.threshold = std::atof(value.c_str());
+        } else if (arg == "--heatmap" && !value.empty()) {
+            options.heatmap = value;
+        } else if (arg == "--roulette-depth" && !value.empty() && number >= 0) {
+            options.roulette_depth = number;
+        } else if (arg == "--sampler" && parse_sequence(value, options.sampling.sequence)) {
+            // parse_sequence has stored it.
+        } else if (arg == "--scene" && number > 0) {
+            options.scene = number;
+        } else {
+            print_usage(argv[0]);
+            std::exit(1);
+        }
+    }
+
+    options.sampling.min_spp = std::min(options.sampling.min_spp, options.sampling.max_spp);
+    return options;
+}
+
+
+// Splits the image into tile_size x tile_size tiles and shades them on the pool.
+// shade(i, j) returns the color of pixel (i, j) and must draw its random
+// numbers from samplers seeded by the pixel, so the result does not depend on the
+// thread count.
+// Nothing is written out while rendering: the float framebuffer is returned whole.
+template <class Shade>
+float_image render_tiles(
+    thread_pool& pool, int image_width, int image_height, int tile_size, Shade shade
+) {
+    float_image framebuffer(image_width, image_height);
+
+    int tiles_x = (image_width + tile_size - 1) / tile_size;
+    int tiles_y = (image_height + tile_size - 1) / tile_size;
+    int tile_count = tiles_x * tiles_y;
+
+    std::atomic<int> tiles_remaining(tile_count);
+    std::mutex progress_lock;
+
+    pool.parallel_for(tile_count, [&](size_t tile) {
+        // Start from the top of the image, like the old scanline loop.
+        int x0 = static_cast<int>(tile % tiles_x) * tile_size;
+        int y1 = image_height - static_cast<int>(tile / tiles_x) * tile_size;
+        int x1 = std::min(x0 + tile_size, image_width);
+        int y0 = std::max(y1 - tile_size, 0);
+
+        for (int j = y1-1; j >= y0; --j) {
+            for (int i = x0; i < x1; ++i) {
+                framebuffer.set(i, j, shade(i, j));
+            }
+        }
+
+        int remaining = --tiles_remaining;
+        std::lock_guard<std::mutex> guard(progress_lock);
+        std::cerr << "\rTiles remaining: " << remaining << ' ' << std::flush;
+    });
+
+    return framebuffer;
+}
+
+
+// Renders in passes. Every pixel first gets min_spp samples (max_spp when adaptive
+// sampling is off); after that each pass gives the pixels that have not converged
+// half as many samples again as they have, up to max_spp.
+// sample(i, j, first, count, stats) adds samples first .. first+count-1 of pixel
+// (i, j) to stats, seeding each from the pixel and the sample index, so neither
+// the passes nor the threads change the result. The statistics of every pixel are
+// left in pixels, e.g. for sample_heatmap.
+template <class Sample>
+float_image render_adaptive(
+    thread_pool& pool, int image_width, int image_height, int tile_size,
+    const sampling_options& options, std::vector<pixel_statistics>& pixels, Sample sample
+) {
+    const bool adaptive = options.threshold > 0;
+    pixels.assign(static_cast<size_t>(image_width) * image_height, pixel_statistics());
+    std::vector<char> active(pixels.size(), 1);
+
+    for (int pass = 0; ; pass++) {
+        auto framebuffer = render_tiles(pool, image_width, image_height, tile_size,
+            [&](int i, int j) {
+                size_t p = static_cast<size_t>(j) * image_width + i;
+                pixel_statistics& stats = pixels[p];
+                if (active[p]) {
+                    int target = pass == 0 ? (adaptive ? options.min_spp : options.max_spp)
+                                           : std::min(options.max_spp, stats.count + std::max(stats.count / 2, 1));
+                    sample(i, j, stats.count, target - stats.count, stats);
+                }
+                return stats.mean();
+            });
+
+        if (!adaptive)
+            return framebuffer;
+
+        active = unconverged_pixels(pixels, image_width, image_height, options);
+        auto remaining = std::count(active.begin(), active.end(), 1);
+        std::cerr << "\rPass " << pass + 1 << ": " << remaining << " pixels not converged\n";
+        if (remaining == 0)
+            return framebuffer;
+    }
+}
+
+#endif /* render_h */
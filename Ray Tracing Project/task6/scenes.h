@@ -0,0 +1,117 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef scenes_h
+#define scenes_h
+
+#include "hittable_list.h"
+#include "material.h"
+#include "moving_sphere.h"
+#include "sampler.h"
+#include "sphere.h"
+
+scene simple_light() {
+    scene objects;
+
+    auto material = objects.materials.add(make_shared<lambertian>(color(0.2, 0.2, 0.7)));
+    auto redlight = objects.materials.add(make_shared<diffuse_light>(color(1,0,0)));
+    auto bluelight = objects.materials.add(make_shared<diffuse_light>(color(0,0,1)));
+    auto greenlight = objects.materials.add(make_shared<diffuse_light>(color(0,1,0)));
+    objects.objects.add(make_shared<sphere>(point3(0,-1000,0), 1000, material));
+    objects.objects.add(make_shared<sphere>(point3(-3, 2, 2), 2, redlight));
+    objects.objects.add(make_shared<sphere>(point3(3, 2, 2), 2, greenlight));
+    objects.objects.add(make_shared<sphere>(point3(0, 6, 6), 2, bluelight));
+    objects.objects.add(make_shared<sphere>(point3(0, 2, 2), 2, material));
+
+    return objects;
+}
+
+scene two_spheres() {
+    scene objects;
+
+    auto material = objects.materials.add(make_shared<lambertian>(color(0.2, 0.2, 0.7)));
+    objects.objects.add(make_shared<sphere>(point3(0,-1000,0), 1000, material));
+    objects.objects.add(make_shared<sphere>(point3(0, 2, 0), 2, material));
+
+    return objects;
+}
+
+scene random_scene() {
+    scene world;
+    sampler rng(2020);
+
+    auto ground_material = world.materials.add(make_shared<lambertian>(color(0.7, 0.2, 0.3)));
+    world.objects.add(make_shared<sphere>(point3(0,-1000,0), 1000, ground_material));
+
+    for (int a = -11; a < 11; a++) {
+        for (int b = -11; b < 11; b++) {
+            auto choose_mat = rng.random_double();
+            point3 center(a + 0.9*rng.random_double(), 0.2, b + 0.9*rng.random_double());
+
+            if ((center - point3(4, 0.2, 0)).length() > 0.9) {
+                uint32_t sphere_material;
+
+                if (choose_mat < 0.8) {
+                    // diffuse
+                    auto albedo = color::random(rng) * color::random(rng);
+                    sphere_material = world.materials.add(make_shared<diffuse_light>(albedo));
+                    world.objects.add(make_shared<sphere>(center, 0.2, sphere_material));
+                } else if (choose_mat < 0.95) {
+                    // metal
+                    auto albedo = color::random(rng, 0.5, 1);
+                    auto fuzz = rng.random_double(0, 0.5);
+                    sphere_material = world.materials.add(make_shared<metal>(albedo, fuzz));
+                    world.objects.add(make_shared<sphere>(center, 0.2, sphere_material));
+                } else {
+                    // glass
+                    sphere_material = world.materials.add(make_shared<dielectric>(1.5));
+                    world.objects.add(make_shared<sphere>(center, 0.2, sphere_material));
+                }
+            }
+        }
+    }
+
+    auto material1 = world.materials.add(make_shared<lambertian>(color(0.2, 0.2, 0.7)));
+    world.objects.add(make_shared<sphere>(point3(-5, 1.5, 0), 1.5, material1));
+
+    auto material2 = world.materials.add(make_shared<metal>(color(0.7, 0.6, 0.5), 0.0));
+    world.objects.add(make_shared<sphere>(point3(-1, 1.5, 0), 1.5, material2));
+
+    auto material3 = world.materials.add(make_shared<dielectric>(0.9));
+    world.objects.add(make_shared<sphere>(point3(2, 1, 0), 1, material3));
+    auto material4 = world.materials.add(make_shared<dielectric>(1.1));
+    world.objects.add(make_shared<sphere>(point3(5, 1, 0), 1, material4));
+    auto material5 = world.materials.add(make_shared<dielectric>(2.5));
+    world.objects.add(make_shared<sphere>(point3(8, 1, 0), 1, material5));
+    
+    return world;
+}
+
+// Thousands of small spheres, each crossing about its own width several times
+// over while the shutter is open. Boxes swept over the shutter overlap heavily
+// here, which is what motion_bvh is for.
+scene moving_spheres() {
+    scene world;
+    sampler rng(2026);
+
+    auto ground_material = world.materials.add(make_shared<lambertian>(color(0.5, 0.5, 0.5)));
+    world.objects.add(make_shared<sphere>(point3(0,-1000,0), 1000, ground_material));
+
+    for (int a = -30; a < 30; a++) {
+        for (int b = -30; b < 30; b++) {
+            point3 center0(a + 0.9*rng.random_double(), 0.15 + 2*rng.random_double(), b + 0.9*rng.random_double());
+            vec3 motion(rng.random_double(-1, 1), rng.random_double(-0.5, 0.5), rng.random_double(-1, 1));
+
+            auto albedo = color::random(rng) * color::random(rng);
+            auto material = rng.random_double() < 0.1
+                ? world.materials.add(make_shared<diffuse_light>(4 * albedo))
+                : world.materials.add(make_shared<lambertian>(albedo));
+            world.objects.add(make_shared<moving_sphere>(center0, center0 + motion, 0.0, 1.0, 0.15, material));
+        }
+    }
+
+    return world;
+}
+
+#endif /* scenes_h */
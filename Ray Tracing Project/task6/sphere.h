@@ -11,8 +11,8 @@
 class sphere : public hittable {
     public:
         sphere() {}
-        sphere(point3 cen, double r, shared_ptr<material> m)
-            : center(cen), radius(r), mat_ptr(m) {};
+        sphere(point3 cen, double r, uint32_t m)
+            : center(cen), radius(r), mat_id(m) {};
 
         virtual bool hit(
             const ray& r, double tmin, double tmax, hit_record& rec) const override;
@@ -21,7 +21,7 @@ class sphere : public hittable {
     public:
         point3 center;
         double radius;
-        shared_ptr<material> mat_ptr;
+        uint32_t mat_id;
     private:
         static void get_sphere_uv(const point3& p, double& u, double& v) {
             // p: a given point on the sphere of radius one, centered at the origin.
@@ -54,7 +54,7 @@ bool sphere::hit(const ray& r, double t_min, double t_max, hit_record& rec) cons
             rec.p = r.at(rec.t);
             vec3 outward_normal = (rec.p - center) / radius;
             rec.set_face_normal(r, outward_normal);
-            rec.mat_ptr = mat_ptr;
+            rec.mat_id = mat_id;
             return true;
         }
         temp = (-half_b + root) / a;
@@ -63,7 +63,7 @@ bool sphere::hit(const ray& r, double t_min, double t_max, hit_record& rec) cons
             rec.p = r.at(rec.t);
             vec3 outward_normal = (rec.p - center) / radius;
             rec.set_face_normal(r, outward_normal);
-            rec.mat_ptr = mat_ptr;
+            rec.mat_id = mat_id;
             return true;
         }
     }
@@ -5,31 +5,21 @@
 
 #ifndef vec3_h
 #define vec3_h
-#include <random>
+#include <cmath>
+#include "sampler.h"
 const double PI = 3.1415926535897932385;
 
-inline double random_double() {
-    static std::uniform_real_distribution<double> distribution(0.0, 1.0);
-    static std::mt19937 generator;
-    return distribution(generator);
-}
-
-inline double random_double(double min, double max) {
-    // Returns a random real in [min,max).
-    return min + (max-min)*random_double();
-}
-
 class vec3 {
     public:
         vec3() : e{0,0,0} {}
         vec3(double e0, double e1, double e2) : e{e0, e1, e2} {}
 
-        inline static vec3 random() {
-            return vec3(random_double(), random_double(), random_double());
+        inline static vec3 random(sampler& rng) {
+            return vec3(rng.random_double(), rng.random_double(), rng.random_double());
         }
 
-        inline static vec3 random(double min, double max) {
-            return vec3(random_double(min,max), random_double(min,max), random_double(min,max));
+        inline static vec3 random(sampler& rng, double min, double max) {
+            return vec3(rng.random_double(min,max), rng.random_double(min,max), rng.random_double(min,max));
         }
     
     
@@ -122,22 +112,23 @@ inline vec3 unit_vector(vec3 v) {
     return v / v.length();
 }
 
-vec3 random_in_unit_sphere() {
-    while (true) {
-        auto p = vec3::random(-1,1);
-        if (p.length_squared() >= 1) continue;
-        return p;
-    }
-}
-
 //Lambertian Reflectance model
-vec3 random_unit_vector() {
-    auto a = random_double(0, 2*PI);
-    auto z = random_double(-1, 1);
+vec3 random_unit_vector(sampler& rng) {
+    auto a = rng.random_double(0, 2*PI);
+    auto z = rng.random_double(-1, 1);
     auto r = sqrt(1 - z*z);
     return vec3(r*cos(a), r*sin(a), z);
 }
 
+// A direction in the hemisphere around +z with density cos(theta) / pi, drawn
+// in closed form from the unit disk projected up.
+vec3 random_cosine_direction(sampler& rng) {
+    auto phi = rng.random_double(0, 2*PI);
+    auto r2 = rng.random_double();
+    auto r = sqrt(r2);
+    return vec3(r*cos(phi), r*sin(phi), sqrt(1 - r2));
+}
+
 vec3 reflect(const vec3& v, const vec3& n) {
     return v - 2*dot(v,n)*n;
 }
@@ -149,12 +140,22 @@ vec3 refract(const vec3& uv, const vec3& n, double etai_over_etat) {
     return r_out_perp + r_out_parallel;
 }
 
-vec3 random_in_unit_disk() {
-    while (true) {
-        auto p = vec3(random_double(-1,1), random_double(-1,1), 0);
-        if (p.length_squared() >= 1) continue;
-        return p;
+// Shirley and Chiu's concentric map of the unit square onto the disk: two
+// numbers per point, which a low-discrepancy sampler keeps evenly spread.
+vec3 random_in_unit_disk(sampler& rng) {
+    auto a = rng.random_double(-1,1);
+    auto b = rng.random_double(-1,1);
+    if (a == 0 && b == 0)
+        return vec3(0, 0, 0);
+    double r, theta;
+    if (fabs(a) > fabs(b)) {
+        r = a;
+        theta = PI/4 * (b / a);
+    } else {
+        r = b;
+        theta = PI/2 - PI/4 * (a / b);
     }
+    return vec3(r*cos(theta), r*sin(theta), 0);
 }
 
 #endif /* vec3_h */
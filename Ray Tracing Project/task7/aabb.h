@@ -34,6 +34,21 @@ class aabb {
             return 2*(a*b + b*c + c*a);
         }
 
+        // Grows the box in place to enclose other; cheaper than surrounding_box in build loops.
+        void expand(const aabb& other) {
+            for (int a = 0; a < 3; a++) {
+                if (other.minimum[a] < minimum[a]) minimum[a] = other.minimum[a];
+                if (other.maximum[a] > maximum[a]) maximum[a] = other.maximum[a];
+            }
+        }
+
+        void expand(const point3& p) {
+            for (int a = 0; a < 3; a++) {
+                if (p[a] < minimum[a]) minimum[a] = p[a];
+                if (p[a] > maximum[a]) maximum[a] = p[a];
+            }
+        }
+
         int longest_axis() const {
             auto a = maximum.x() - minimum.x();
             auto b = maximum.y() - minimum.y();
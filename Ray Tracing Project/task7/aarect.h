@@ -16,15 +16,22 @@ class xy_rect : public hittable {
         xy_rect() {}
 
         xy_rect(
-            double _x0, double _x1, double _y0, double _y1, double _k, shared_ptr<material> mat
-        ) : x0(_x0), x1(_x1), y0(_y0), y1(_y1), k(_k), mp(mat) {};
+            real _x0, real _x1, real _y0, real _y1, real _k, uint32_t mat
+        ) : x0(_x0), x1(_x1), y0(_y0), y1(_y1), k(_k), mat_id(mat) {};
 
         virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
 
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override {
+            // The bounding box must have non-zero width in each dimension, so pad the Z
+            // dimension a small amount.
+            output_box = aabb(point3(x0,y0, k-0.0001), point3(x1, y1, k+0.0001));
+            return true;
+        }
+
 
     public:
-        shared_ptr<material> mp;
-        double x0, x1, y0, y1, k;
+        uint32_t mat_id;
+        real x0, x1, y0, y1, k;
 };
 
 class xz_rect : public hittable {
@@ -32,14 +39,21 @@ class xz_rect : public hittable {
         xz_rect() {}
 
         xz_rect(
-            double _x0, double _x1, double _z0, double _z1, double _k, shared_ptr<material> mat
-        ) : x0(_x0), x1(_x1), z0(_z0), z1(_z1), k(_k), mp(mat) {};
+            real _x0, real _x1, real _z0, real _z1, real _k, uint32_t mat
+        ) : x0(_x0), x1(_x1), z0(_z0), z1(_z1), k(_k), mat_id(mat) {};
 
         virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
 
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override {
+            // The bounding box must have non-zero width in each dimension, so pad the Y
+            // dimension a small amount.
+            output_box = aabb(point3(x0,k-0.0001,z0), point3(x1, k+0.0001, z1));
+            return true;
+        }
+
     public:
-        shared_ptr<material> mp;
-        double x0, x1, z0, z1, k;
+        uint32_t mat_id;
+        real x0, x1, z0, z1, k;
 };
 
 class yz_rect : public hittable {
@@ -47,16 +61,23 @@ class yz_rect : public hittable {
         yz_rect() {}
 
         yz_rect(
-            double _y0, double _y1, double _z0, double _z1, double _k, shared_ptr<material> mat
-        ) : y0(_y0), y1(_y1), z0(_z0), z1(_z1), k(_k), mp(mat) {};
+            real _y0, real _y1, real _z0, real _z1, real _k, uint32_t mat
+        ) : y0(_y0), y1(_y1), z0(_z0), z1(_z1), k(_k), mat_id(mat) {};
 
         virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
 
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override {
+            // The bounding box must have non-zero width in each dimension, so pad the X
+            // dimension a small amount.
+            output_box = aabb(point3(k-0.0001, y0, z0), point3(k+0.0001, y1, z1));
+            return true;
+        }
+
    
 
     public:
-        shared_ptr<material> mp;
-        double y0, y1, z0, z1, k;
+        uint32_t mat_id;
+        real y0, y1, z0, z1, k;
 };
 
 bool xy_rect::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
@@ -74,8 +95,11 @@ bool xy_rect::hit(const ray& r, double t_min, double t_max, hit_record& rec) con
     rec.t = t;
     auto outward_normal = vec3(0, 0, 1);
     rec.set_face_normal(r, outward_normal);
-    rec.mat_ptr = mp;
+    rec.mat_id = mat_id;
+    // On the plane exactly, whatever the rounding of t.
     rec.p = r.at(t);
+    rec.p[2] = k;
+    rec.error = 0;
 
     return true;
 }
@@ -95,8 +119,10 @@ bool xz_rect::hit(const ray& r, double t_min, double t_max, hit_record& rec) con
     rec.t = t;
     auto outward_normal = vec3(0, 1, 0);
     rec.set_face_normal(r, outward_normal);
-    rec.mat_ptr = mp;
+    rec.mat_id = mat_id;
     rec.p = r.at(t);
+    rec.p[1] = k;
+    rec.error = 0;
 
     return true;
 }
@@ -116,8 +142,10 @@ bool yz_rect::hit(const ray& r, double t_min, double t_max, hit_record& rec) con
     rec.t = t;
     auto outward_normal = vec3(1, 0, 0);
     rec.set_face_normal(r, outward_normal);
-    rec.mat_ptr = mp;
+    rec.mat_id = mat_id;
     rec.p = r.at(t);
+    rec.p[0] = k;
+    rec.error = 0;
 
     return true;
 }
@@ -0,0 +1,131 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef adaptive_h
+#define adaptive_h
+
+#include "image.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// How many paths a pixel gets. With threshold 0 every pixel takes max_spp samples;
+// otherwise a pixel stops between min_spp and max_spp once the 95% confidence
+// interval of its luminance, and that of its neighbours, is within threshold of
+// the square root of its mean.
+struct sampling_options {
+    int min_spp = 16;
+    int max_spp = 100;
+    double threshold = 0;
+    sample_sequence sequence = sobol_samples;  // what the samples draw from
+};
+
+
+// Running mean and variance of the samples of one pixel, by Welford's method. The
+// variance is tracked on luminance only; the color mean is kept as a plain sum.
+struct pixel_statistics {
+    int count = 0;
+    color sum;
+    double mean_luminance = 0;
+    double m2 = 0;
+    uint64_t cost = 0;      // box and primitive tests of its samples, with RT_COUNTERS
+
+    void add(const color& sample) {
+        sum += sample;
+        count++;
+        double y = luminance(sample);
+        double delta = y - mean_luminance;
+        mean_luminance += delta / count;
+        m2 += delta * (y - mean_luminance);
+    }
+
+    color mean() const { return count ? sum / count : color(0,0,0); }
+
+    // Half width of the 95% confidence interval of the mean luminance.
+    double error() const {
+        if (count < 2)
+            return INFINITY;
+        return 1.96 * std::sqrt(m2 / (count - 1) / count);
+    }
+
+    // Error over the allowed error, converged at or below 1. The allowance grows
+    // with the square root of the mean, roughly how visible noise is; dark pixels
+    // are measured against one 8-bit step so a stray sample cannot stall them.
+    double error_ratio(double threshold) const {
+        return error() / (threshold * std::sqrt(std::max(mean_luminance, 1.0 / 256)));
+    }
+};
+
+
+// Which pixels still need samples after a pass. A pixel keeps going while any pixel
+// of its 3x3 neighbourhood is above the threshold: a few dozen samples often miss
+// a rare bright path entirely and look converged, but a neighbour usually saw it.
+std::vector<char> unconverged_pixels(const std::vector<pixel_statistics>& pixels, int width, int height,
+                                     const sampling_options& options) {
+    std::vector<double> ratio(pixels.size());
+    for (size_t p = 0; p < pixels.size(); p++)
+        ratio[p] = pixels[p].error_ratio(options.threshold);
+
+    std::vector<char> active(pixels.size(), 0);
+    for (int j = 0; j < height; ++j) {
+        for (int i = 0; i < width; ++i) {
+            size_t p = static_cast<size_t>(j) * width + i;
+            if (pixels[p].count >= options.max_spp)
+                continue;
+            double worst = 0;
+            for (int y = std::max(j-1, 0); y <= std::min(j+1, height-1); ++y)
+                for (int x = std::max(i-1, 0); x <= std::min(i+1, width-1); ++x)
+                    worst = std::max(worst, ratio[static_cast<size_t>(y) * width + x]);
+            active[p] = worst > 1;
+        }
+    }
+    return active;
+}
+
+
+// Sample counts as a heat ramp from black (min_spp) over red and yellow to white
+// (max_spp), for writing next to the render with write_image(path, heatmap, 1).
+float_image sample_heatmap(const std::vector<pixel_statistics>& pixels, int width, int height,
+                           const sampling_options& options) {
+    float_image heatmap(width, height);
+    double range = std::max(1, options.max_spp - options.min_spp);
+    for (int j = 0; j < height; ++j) {
+        for (int i = 0; i < width; ++i) {
+            double t = (pixels[static_cast<size_t>(j) * width + i].count - options.min_spp) / range;
+            t = clamp(t, 0.0, 1.0) * 3;
+            heatmap.set(i, j, color(clamp(t, 0.0, 1.0), clamp(t - 1, 0.0, 1.0), clamp(t - 2, 0.0, 1.0)));
+        }
+    }
+    return heatmap;
+}
+
+
+// The traversal cost of every pixel, in box and primitive tests over all its
+// samples, as the heat ramp of sample_heatmap from black (none) to white (the
+// 99th percentile or more). All black without RT_COUNTERS, which counts no cost.
+float_image cost_heatmap(const std::vector<pixel_statistics>& pixels, int width, int height) {
+    std::vector<uint64_t> sorted;
+    sorted.reserve(pixels.size());
+    for (const auto& stats : pixels)
+        sorted.push_back(stats.cost);
+    std::sort(sorted.begin(), sorted.end());
+    double top = sorted.empty() ? 0 : static_cast<double>(sorted[sorted.size() * 99 / 100]);
+
+    float_image heatmap(width, height);
+    for (int j = 0; j < height; ++j) {
+        for (int i = 0; i < width; ++i) {
+            double t = top > 0 ? pixels[static_cast<size_t>(j) * width + i].cost / top : 0;
+            t = clamp(t, 0.0, 1.0) * 3;
+            heatmap.set(i, j, color(clamp(t, 0.0, 1.0), clamp(t - 1, 0.0, 1.0), clamp(t - 2, 0.0, 1.0)));
+        }
+    }
+    return heatmap;
+}
+
+#endif /* adaptive_h */
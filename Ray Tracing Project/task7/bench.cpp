@@ -0,0 +1,959 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+
+// Microbenchmarks for the hot pieces of the renderer.
+// Usage: bench [name ...]   (no names runs everything)
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "vec3.h"
+#include "sampler.h"
+#include "camera.h"
+#include "linear_bvh.h"
+#include "wide_bvh.h"
+#include "compiled_scene.h"
+#include "aarect.h"
+#include "instance.h"
+#include "mesh_loader.h"
+#include "scene_cache.h"
+#include "scene_file.h"
+#include "triangle_mesh.h"
+#include "sphere_set.h"
+#include "scenes.h"
+#include "image.h"
+#include "path_tracer.h"
+
+using namespace std;
+
+// Keeps the optimizer from dropping the benchmarked work.
+volatile double bench_sink;
+
+template <class Body>
+double seconds_for(Body body) {
+    auto start = chrono::steady_clock::now();
+    body();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void report(const string& name, double count, double seconds, const char* unit) {
+    cout << "  " << name << ": " << count / seconds / 1e6 << " M" << unit << "/s\n";
+}
+
+
+// The generator every vec3.h used before the sampler: one global mt19937.
+inline double global_random_double() {
+    static std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    static std::mt19937 generator;
+    return distribution(generator);
+}
+
+void bench_rng() {
+    const long n = 50000000;
+    cout << "rng\n";
+
+    auto t_old = seconds_for([&] {
+        double sum = 0;
+        for (long k = 0; k < n; k++) sum += global_random_double();
+        bench_sink = sum;
+    });
+    report("global mt19937 random_double", n, t_old, "samples");
+
+    auto t_new = seconds_for([&] {
+        sampler rng(1);
+        double sum = 0;
+        for (long k = 0; k < n; k++) sum += rng.random_double();
+        bench_sink = sum;
+    });
+    report("pcg32 sampler random_double", n, t_new, "samples");
+
+    const long paths = 1000000;
+    auto t_seed = seconds_for([&] {
+        double sum = 0;
+        for (long k = 0; k < paths; k++) {
+            sampler rng = sampler::for_sample(k, k & 127);
+            sum += random_unit_vector(rng).x();
+        }
+        bench_sink = sum;
+    });
+    report("per-sample seed + random_unit_vector", paths, t_seed, "paths");
+}
+
+
+// Camera rays over a 400x225 image, samples of one pixel next to each other.
+vector<ray> camera_rays(const camera& cam, int samples_per_pixel) {
+    const auto aspect_ratio = 16.0 / 9.0;
+    const int image_width = 400;
+    const int image_height = static_cast<int>(image_width / aspect_ratio);
+
+    vector<ray> rays;
+    for (int j = 0; j < image_height; ++j)
+        for (int i = 0; i < image_width; ++i)
+            for (int s = 0; s < samples_per_pixel; ++s) {
+                sampler rng = sampler::for_sample(j*image_width + i, s);
+                rays.push_back(cam.get_ray((i + rng.random_double()) / (image_width-1),
+                                           (j + rng.random_double()) / (image_height-1)));
+            }
+    return rays;
+}
+
+vector<ray> pyramid_camera_rays(int samples_per_pixel) {
+    return camera_rays(camera(point3(6,10,12), point3(0,0,0), vec3(0,1,0), 20, 16.0 / 9.0), samples_per_pixel);
+}
+
+vector<ray> three_boxes_camera_rays(int samples_per_pixel) {
+    return camera_rays(camera(point3(5,3,2), point3(0.25,0.25,-1), vec3(0,1,0), 20, 16.0 / 9.0), samples_per_pixel);
+}
+
+vector<ray> random_spheres_camera_rays(int samples_per_pixel) {
+    return camera_rays(camera(point3(13,2,3), point3(0,0,0), vec3(0,1,0), 20, 16.0 / 9.0), samples_per_pixel);
+}
+
+double trace_all(const hittable& world, const vector<ray>& rays) {
+    return seconds_for([&] {
+        long hits = 0;
+        hit_record rec;
+        for (const auto& r : rays)
+            hits += world.hit(r, 0.001, numeric_limits<double>::infinity(), rec);
+        bench_sink = hits;
+    });
+}
+
+void bench_bvh() {
+    cout << "bvh (pyramid)\n";
+    hittable_list objects = pyramid().objects;
+    auto rays = pyramid_camera_rays(4);
+
+    bvh_build_stats stats;
+    bvh_node tree(objects, 0, 1, &stats);
+    cout << "  bvh_node " << stats << '\n';
+
+    bvh_build_stats linear_stats;
+    linear_bvh flat_tree(objects, 0, 1, &linear_stats);
+    cout << "  linear_bvh " << linear_stats << '\n';
+
+    report("flat hittable_list", rays.size(), trace_all(objects, rays), "rays");
+    report("binned SAH bvh_node", rays.size(), trace_all(tree, rays), "rays");
+    report("linear_bvh", rays.size(), trace_all(flat_tree, rays), "rays");
+
+    bvh_build_stats wide4_stats, wide8_stats;
+    wide_bvh<4> wide4(objects, 0, 1, &wide4_stats);
+    wide_bvh<8> wide8(objects, 0, 1, &wide8_stats);
+    cout << "  wide_bvh<4> " << wide4_stats << '\n';
+    cout << "  wide_bvh<8> " << wide8_stats << '\n';
+    report("wide_bvh<4>", rays.size(), trace_all(wide4, rays), "rays");
+    report("wide_bvh<8>", rays.size(), trace_all(wide8, rays), "rays");
+}
+
+
+template <int N>
+double trace_packets(const wide_bvh<N>& world, const vector<ray>& rays) {
+    return seconds_for([&] {
+        long hits = 0;
+        hit_record recs[packet_size];
+        for (size_t k = 0; k < rays.size(); k += packet_size) {
+            int n = static_cast<int>(min<size_t>(packet_size, rays.size() - k));
+            hits += __builtin_popcount(world.hit_packet(&rays[k], n, 0.001, numeric_limits<double>::infinity(), recs));
+        }
+        bench_sink = hits;
+    });
+}
+
+void bench_packets() {
+    struct packet_scene { const char* name; hittable_list objects; vector<ray> rays; };
+    packet_scene scenes[] = {
+        {"three_boxes (task3)", three_boxes().objects, three_boxes_camera_rays(8)},
+        {"pyramid (task7)", pyramid().objects, pyramid_camera_rays(8)},
+    };
+
+    for (auto& sc : scenes) {
+        cout << "packets " << sc.name << '\n';
+        wide_bvh<4> world(sc.objects, 0, 1);
+        report("single primary rays", sc.rays.size(), trace_all(world, sc.rays), "rays");
+        report("8-ray packets", sc.rays.size(), trace_packets(world, sc.rays), "rays");
+    }
+}
+
+
+// Rays whose closest hit differs between two worlds.
+long mismatched_hits(const hittable& a, const hittable& b, const vector<ray>& rays) {
+    long mismatches = 0;
+    hit_record ra, rb;
+    for (const auto& r : rays) {
+        bool ha = a.hit(r, 0.001, numeric_limits<double>::infinity(), ra);
+        bool hb = b.hit(r, 0.001, numeric_limits<double>::infinity(), rb);
+        mismatches += ha != hb || (ha && (ra.t != rb.t || ra.mat_id != rb.mat_id));
+    }
+    return mismatches;
+}
+
+void bench_spheres() {
+    cout << "spheres (random_spheres)\n";
+    hittable_list objects = random_spheres().objects;
+    hittable_list grouped = group_spheres(objects);
+    auto rays = random_spheres_camera_rays(4);
+
+    sphere_set all;
+    for (const auto& object : objects.objects)
+        all.add(static_cast<const sphere&>(*object));
+
+    cout << "  " << objects.objects.size() << " spheres in " << grouped.objects.size() << " leaves\n";
+    cout << "  mismatched hits, sphere_set vs list: " << mismatched_hits(objects, all, rays) << '\n';
+
+    report("flat hittable_list of spheres", rays.size(), trace_all(objects, rays), "rays");
+    report("one sphere_set", rays.size(), trace_all(all, rays), "rays");
+
+    wide_bvh<4> single(objects, 0, 1);
+    wide_bvh<4> sets(grouped, 0, 1);
+    cout << "  mismatched hits, sphere_set leaves vs sphere leaves: " << mismatched_hits(single, sets, rays) << '\n';
+    report("wide_bvh<4>, one sphere per primitive", rays.size(), trace_all(single, rays), "rays");
+    report("wide_bvh<4>, sphere_set primitives", rays.size(), trace_all(sets, rays), "rays");
+}
+
+
+// Every box of a list rebuilt the way box used to be: a hittable_list of six rects.
+hittable_list boxes_as_rects(const hittable_list& list) {
+    hittable_list out;
+    for (const auto& object : list.objects) {
+        auto b = dynamic_cast<const box*>(object.get());
+        if (!b) {
+            out.add(object);
+            continue;
+        }
+        point3 p0 = b->box_min, p1 = b->box_max;
+        auto sides = make_shared<hittable_list>();
+        sides->add(make_shared<xy_rect>(p0.x(), p1.x(), p0.y(), p1.y(), p1.z(), b->mat_id));
+        sides->add(make_shared<xy_rect>(p0.x(), p1.x(), p0.y(), p1.y(), p0.z(), b->mat_id));
+        sides->add(make_shared<xz_rect>(p0.x(), p1.x(), p0.z(), p1.z(), p1.y(), b->mat_id));
+        sides->add(make_shared<xz_rect>(p0.x(), p1.x(), p0.z(), p1.z(), p0.y(), b->mat_id));
+        sides->add(make_shared<yz_rect>(p0.y(), p1.y(), p0.z(), p1.z(), p1.x(), b->mat_id));
+        sides->add(make_shared<yz_rect>(p0.y(), p1.y(), p0.z(), p1.z(), p0.x(), b->mat_id));
+        out.add(sides);
+    }
+    return out;
+}
+
+void bench_box() {
+    cout << "box (slab test vs six rects), sizeof(box) " << sizeof(box) << " bytes\n";
+    struct box_scene { const char* name; hittable_list objects; vector<ray> rays; };
+    box_scene scenes[] = {
+        {"three_boxes (task3)", three_boxes().objects, three_boxes_camera_rays(8)},
+        {"pyramid (task7)", pyramid().objects, pyramid_camera_rays(4)},
+    };
+
+    for (auto& sc : scenes) {
+        hittable_list rects = boxes_as_rects(sc.objects);
+        wide_bvh<4> slab_world(sc.objects, 0, 1), rect_world(rects, 0, 1);
+        cout << "  " << sc.name << ", mismatched hits: " << mismatched_hits(sc.objects, rects, sc.rays) << '\n';
+        report("flat list, six rects per box", sc.rays.size(), trace_all(rects, sc.rays), "rays");
+        report("flat list, slab boxes", sc.rays.size(), trace_all(sc.objects, sc.rays), "rays");
+        report("wide_bvh<4>, six rects per box", sc.rays.size(), trace_all(rect_world, sc.rays), "rays");
+        report("wide_bvh<4>, slab boxes", sc.rays.size(), trace_all(slab_world, sc.rays), "rays");
+    }
+}
+
+
+// The same tree traced through virtual hittable::hit calls and through the typed
+// arrays of compiled_scene.
+void bench_compiled() {
+    struct compiled_bench_scene { const char* name; hittable_list objects; vector<ray> rays; };
+    compiled_bench_scene scenes[] = {
+        {"three_boxes (task3)", three_boxes().objects, three_boxes_camera_rays(8)},
+        {"pyramid (task7)", pyramid().objects, pyramid_camera_rays(4)},
+        {"random_spheres", random_spheres().objects, random_spheres_camera_rays(4)},
+        {"random_spheres, sphere_sets", group_spheres(random_spheres().objects), random_spheres_camera_rays(4)},
+    };
+
+    // The worlds take turns, round after round, and each keeps its fastest
+    // round; a stall or a frequency change then hits both alike.
+    const int rounds = 9;
+    for (auto& sc : scenes) {
+        cout << "compiled " << sc.name << ", best of " << rounds << '\n';
+        wide_bvh<4> virtual_world(sc.objects, 0, 1);
+        compiled_scene<4> world(sc.objects, 0, 1);
+        cout << "  mismatched hits: " << mismatched_hits(virtual_world, world, sc.rays) << '\n';
+        auto trace_packets = [&](const auto& w) {
+            return seconds_for([&] {
+                long hits = 0;
+                hit_record recs[packet_size];
+                for (size_t k = 0; k < sc.rays.size(); k += packet_size) {
+                    int n = static_cast<int>(min<size_t>(packet_size, sc.rays.size() - k));
+                    hits += __builtin_popcount(w.hit_packet(&sc.rays[k], n, 0.001, numeric_limits<double>::infinity(), recs));
+                }
+                bench_sink = hits;
+            });
+        };
+        double t_virtual = 1e30, t_compiled = 1e30, t_virtual_packets = 1e30, t_packets = 1e30;
+        for (int round = 0; round < rounds; round++) {
+            t_virtual = min(t_virtual, trace_all(virtual_world, sc.rays));
+            t_compiled = min(t_compiled, trace_all(world, sc.rays));
+            t_virtual_packets = min(t_virtual_packets, trace_packets(virtual_world));
+            t_packets = min(t_packets, trace_packets(world));
+        }
+        report("wide_bvh<4>, virtual primitives", sc.rays.size(), t_virtual, "rays");
+        report("compiled_scene<4>", sc.rays.size(), t_compiled, "rays");
+        report("wide_bvh<4>, virtual primitives, 8-ray packets", sc.rays.size(), t_virtual_packets, "rays");
+        report("compiled_scene<4>, 8-ray packets", sc.rays.size(), t_packets, "rays");
+    }
+}
+
+
+// How two worlds that compute the same hits along different paths disagree:
+// rays that hit in one and miss in the other, and hits whose t differ by more
+// than rounding in real allows. A surface off by a relative gamma(16) moves t
+// by that over the cosine with the normal, so grazing hits get more room; a ray
+// tangent to one sphere may still clip it in one world and pass to another.
+struct hit_differences {
+    long hit_or_miss = 0;
+    long t = 0;
+};
+
+hit_differences differing_hits(const hittable& a, const hittable& b, const vector<ray>& rays) {
+    hit_differences differences;
+    hit_record ra, rb;
+    for (const auto& r : rays) {
+        bool ha = a.hit(r, 0.001, numeric_limits<double>::infinity(), ra);
+        bool hb = b.hit(r, 0.001, numeric_limits<double>::infinity(), rb);
+        if (ha != hb) {
+            differences.hit_or_miss++;
+        } else if (ha) {
+            vec3 d = unit_vector(r.direction());
+            double cosine = max(fabs(dot(d, ra.normal)), fabs(dot(d, rb.normal)));
+            differences.t += fabs(ra.t - rb.t) > rounding_error<real>(16) * ra.t / cosine;
+        }
+    }
+    return differences;
+}
+
+template <int N>
+size_t tree_bytes(const wide_bvh<N>& tree) {
+    return tree.nodes.size() * sizeof(wide_bvh_node<N>) + tree.leaf_objects.size() * sizeof(const hittable*)
+         + tree.objects.size() * sizeof(shared_ptr<hittable>);
+}
+
+// A thousand rotated, scaled copies of one cluster of 64 spheres: as instances
+// of one bottom-level tree, and as 64000 spheres in one tree.
+void bench_instances() {
+    cout << "instances (1000 copies of 64 spheres)\n";
+    sampler rng(5);
+    hittable_list cluster;
+    for (int k = 0; k < 64; k++)
+        cluster.add(make_shared<sphere>(point3::random(rng, -1, 1), rng.random_double(0.05, 0.2), 0));
+
+    vector<affine_transform> placements;
+    vector<double> scales;
+    for (int x = 0; x < 10; x++)
+        for (int y = 0; y < 10; y++)
+            for (int z = 0; z < 10; z++) {
+                double scale = rng.random_double(0.5, 1.2);
+                scales.push_back(scale);
+                placements.push_back(affine_transform::translation(vec3(3*x, 3*y, 3*z))
+                                     * affine_transform::rotation(vec3::random(rng, -1, 1), rng.random_double(0, 360))
+                                     * affine_transform::scaling(vec3(scale, scale, scale)));
+            }
+
+    hittable_list flat;
+    for (size_t i = 0; i < placements.size(); i++)
+        for (const auto& object : cluster.objects) {
+            const auto& s = static_cast<const sphere&>(*object);
+            flat.add(make_shared<sphere>(placements[i].point(s.center), s.radius * scales[i], s.mat_id));
+        }
+
+    wide_bvh<4> flat_world;
+    auto t_flat = seconds_for([&] { flat_world = wide_bvh<4>(flat, 0, 1); });
+
+    instanced_scene world;
+    auto t_bottom = seconds_for([&] { world.add_geometry(cluster); });
+    auto t_top = seconds_for([&] {
+        for (const auto& placement : placements)
+            world.add_instance(0, placement);
+        world.build_top();
+    });
+
+    size_t flat_bytes = flat.objects.size() * sizeof(sphere) + tree_bytes(flat_world);
+    size_t instanced_bytes = cluster.objects.size() * sizeof(sphere) + tree_bytes(*world.geometries[0])
+                           + world.instances.size() * sizeof(instance) + tree_bytes(world.top);
+    cout << "  flat: " << flat_bytes / 1024 << " KiB, built in " << t_flat * 1000 << " ms\n";
+    cout << "  instanced: " << instanced_bytes / 1024 << " KiB, bottom level built in " << t_bottom * 1000
+         << " ms, instances and top level in " << t_top * 1000 << " ms\n";
+
+    auto rays = camera_rays(camera(point3(-20, 35, -25), point3(13.5, 13.5, 13.5), vec3(0,1,0), 40, 16.0 / 9.0), 1);
+    auto differences = differing_hits(flat_world, world, rays);
+    cout << "  hit or miss differs: " << differences.hit_or_miss << " rays, t beyond rounding: "
+         << differences.t << " rays\n";
+    report("flat wide_bvh<4>", rays.size(), trace_all(flat_world, rays), "rays");
+    report("instanced, two levels", rays.size(), trace_all(world, rays), "rays");
+
+    // Move every copy and refit only the top.
+    auto t_move = seconds_for([&] {
+        for (uint32_t i = 0; i < world.instances.size(); i++)
+            world.set_transform(i, affine_transform::translation(vec3(0, 0.5, 0)) * placements[i]);
+        world.build_top();
+    });
+    cout << "  moved all instances and rebuilt the top level in " << t_move * 1000 << " ms\n";
+}
+
+
+long file_size(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return -1;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+// Stands in for glm::vec3, to feed triangle_mesh the way the OpenGL projects would.
+struct xyz { float x, y, z; };
+
+// The torus GenerateParametricShapeFrom2D makes from ParametricCircle, with the
+// same vertex and index layout, except that the profile circle wraps around as
+// well, so the surface is closed and shares every vertex.
+void parametric_torus(int vertical_segments, int rotation_segments,
+                      vector<xyz>& positions, vector<xyz>& normals, vector<uint32_t>& indices) {
+    const double two_pi = 2 * 3.1415926535897932385;
+    for (int r = 0; r < rotation_segments; ++r)
+        for (int v = 0; v < vertical_segments; ++v) {
+            double t = two_pi * v / vertical_segments, a = two_pi * r / rotation_segments;
+            double x = 0.7 + 0.3 * cos(t), y = 0.3 * sin(t);
+            positions.push_back({float(x * cos(a)), float(y), float(-x * sin(a))});
+            normals.push_back({float(cos(t) * cos(a)), float(sin(t)), float(-cos(t) * sin(a))});
+        }
+
+    auto index = [&](int v, int r) {
+        return uint32_t((r % rotation_segments) * vertical_segments + v % vertical_segments);
+    };
+    for (int r = 0; r < rotation_segments; ++r)
+        for (int v = 0; v < vertical_segments; ++v) {
+            indices.insert(indices.end(), {index(v + 1, r), index(v, r + 1), index(v, r)});
+            indices.insert(indices.end(), {index(v + 1, r), index(v + 1, r + 1), index(v, r + 1)});
+        }
+}
+
+void write_obj(const char* path, const vector<xyz>& positions, const vector<xyz>& normals,
+               const vector<uint32_t>& indices) {
+    FILE* file = fopen(path, "w");
+    for (const auto& p : positions) fprintf(file, "v %.6f %.6f %.6f\n", p.x, p.y, p.z);
+    for (const auto& n : normals) fprintf(file, "vn %.6f %.6f %.6f\n", n.x, n.y, n.z);
+    for (size_t i = 0; i < indices.size(); i += 3)
+        fprintf(file, "f %u//%u %u//%u %u//%u\n", indices[i] + 1, indices[i] + 1,
+                indices[i+1] + 1, indices[i+1] + 1, indices[i+2] + 1, indices[i+2] + 1);
+    fclose(file);
+}
+
+void write_ply(const char* path, const vector<xyz>& positions, const vector<xyz>& normals,
+               const vector<uint32_t>& indices) {
+    FILE* file = fopen(path, "wb");
+    fprintf(file, "ply\nformat binary_little_endian 1.0\nelement vertex %zu\n"
+                  "property float x\nproperty float y\nproperty float z\n"
+                  "property float nx\nproperty float ny\nproperty float nz\n"
+                  "element face %zu\nproperty list uchar int vertex_indices\nend_header\n",
+            positions.size(), indices.size() / 3);
+    for (size_t i = 0; i < positions.size(); i++) {
+        fwrite(&positions[i], sizeof(xyz), 1, file);
+        fwrite(&normals[i], sizeof(xyz), 1, file);
+    }
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        unsigned char three = 3;
+        fwrite(&three, 1, 1, file);
+        fwrite(&indices[i], sizeof(uint32_t), 3, file);
+    }
+    fclose(file);
+}
+
+// Loading and tracing a million-triangle torus, and rays aimed exactly at its
+// vertices and edge midpoints from inside the tube, which a test that is not
+// watertight lets through now and then.
+void bench_mesh() {
+    vector<xyz> positions, normals;
+    vector<uint32_t> indices;
+    parametric_torus(500, 1000, positions, normals, indices);
+    cout << "mesh (torus, " << indices.size() / 3 << " triangles)\n";
+
+    write_obj("bench_mesh.obj", positions, normals, indices);
+    write_ply("bench_mesh.ply", positions, normals, indices);
+
+    mesh_data obj, ply;
+    auto t_obj = seconds_for([&] { load_obj("bench_mesh.obj", obj); });
+    auto t_ply = seconds_for([&] { load_ply("bench_mesh.ply", ply); });
+    cout << "  load obj: " << t_obj * 1000 << " ms, " << file_size("bench_mesh.obj") / (1 << 20) << " MiB, "
+         << obj.triangle_count() << " triangles, " << (obj.normals.empty() ? "no" : "with") << " normals\n";
+    cout << "  load binary ply: " << t_ply * 1000 << " ms, " << file_size("bench_mesh.ply") / (1 << 20) << " MiB, "
+         << ply.triangle_count() << " triangles, " << (ply.normals.empty() ? "no" : "with") << " normals\n";
+    // The OBJ holds six decimals.
+    bool agree = obj.indices == ply.indices && obj.positions.size() == ply.positions.size();
+    for (size_t i = 0; agree && i < obj.positions.size(); i++)
+        agree = fabs(obj.positions[i] - ply.positions[i]) <= 1e-6f;
+    cout << "  obj and ply agree: " << (agree ? "yes" : "no") << '\n';
+    remove("bench_mesh.obj");
+    remove("bench_mesh.ply");
+
+    bvh_build_stats stats;
+    triangle_mesh mesh(std::move(ply), 0, &stats);
+    cout << "  " << stats << '\n';
+    triangle_mesh from_arrays(positions, normals, indices, 0);
+    cout << "  from GenerateParametricShapeFrom2D-style arrays: " << from_arrays.triangle_count() << " triangles\n";
+
+    auto rays = camera_rays(camera(point3(0, 2.5, 2.5), point3(0, 0, 0), vec3(0,1,0), 40, 16.0 / 9.0), 4);
+    report("camera rays", rays.size(), trace_all(mesh, rays), "rays");
+
+    // From the core circle of the tube through every vertex and every edge
+    // midpoint of the ring of profile vertices around it.
+    long aimed = 0, leaks = 0;
+    for (int r = 0; r < 1000; r += 7) {
+        double a = 2 * 3.1415926535897932385 * r / 1000;
+        point3 core(0.7 * cos(a), 0, -0.7 * sin(a));
+        for (int v = 0; v < 500; v++) {
+            const xyz& p = positions[r * 500 + v];
+            const xyz& q = positions[r * 500 + (v + 1) % 500];
+            point3 targets[2] = { point3(p.x, p.y, p.z), point3(0.5 * (p.x + q.x), 0.5 * (p.y + q.y), 0.5 * (p.z + q.z)) };
+            for (const auto& target : targets) {
+                hit_record rec;
+                aimed++;
+                leaks += !mesh.hit(ray(core, target - core), 0, numeric_limits<double>::infinity(), rec);
+            }
+        }
+    }
+    cout << "  rays through vertices and edges that escaped: " << leaks << " of " << aimed << '\n';
+}
+
+// Both BVH builders on a quarter and a full million spheres and the million
+// triangle torus, on one thread and on a pool of every core, and the camera
+// rays per second through the trees they make.
+void bench_build() {
+    thread_pool pool(max(1u, thread::hardware_concurrency()));
+    cout << "build (pool of " << pool.size() << " threads)\n";
+
+    auto build_all = [&](const string& name, const function<void(const bvh_build_options&, bvh_build_stats&)>& build_one,
+                         const function<double()>& trace, size_t ray_count) {
+        for (int mode = sah_build; mode <= lbvh_build; mode++) {
+            bvh_build_options build;
+            build.mode = static_cast<bvh_build_mode>(mode);
+            for (thread_pool* p : {static_cast<thread_pool*>(nullptr), &pool}) {
+                build.pool = p;
+                bvh_build_stats stats;
+                build_one(build, stats);
+                cout << "  " << name << ", " << bvh_build_name(build.mode) << (p ? " on the pool " : " on one thread ")
+                     << stats << '\n';
+            }
+            report(name + ", " + bvh_build_name(build.mode) + " camera rays", ray_count, trace(), "rays");
+        }
+    };
+
+    auto grid_rays = camera_rays(camera(point3(0, 1.5, 2.2), point3(0, 0, 0), vec3(0,1,0), 40, 16.0 / 9.0), 1);
+    const pair<const char*, int> grids[] = {{"grid_256k", 512}, {"grid_1m", 1024}};
+    for (const auto& g : grids) {
+        hittable_list objects = sphere_grid(g.second).objects;
+        wide_bvh<4> tree;
+        build_all(g.first, [&](const bvh_build_options& build, bvh_build_stats& stats) {
+                      tree = wide_bvh<4>(objects, 0, 1, &stats, build);
+                  },
+                  [&] { return trace_all(tree, grid_rays); }, grid_rays.size());
+    }
+
+    vector<xyz> positions, normals;
+    vector<uint32_t> indices;
+    parametric_torus(500, 1000, positions, normals, indices);
+    auto torus_rays = camera_rays(camera(point3(0, 2.5, 2.5), point3(0, 0, 0), vec3(0,1,0), 40, 16.0 / 9.0), 1);
+    triangle_mesh mesh;
+    build_all("torus_1m", [&](const bvh_build_options& build, bvh_build_stats& stats) {
+                  mesh = triangle_mesh(mesh_from_arrays(positions, normals, indices), 0, &stats, build);
+              },
+              [&] { return trace_all(mesh, torus_rays); }, torus_rays.size());
+}
+
+// A million spheres written as a text scene: parsing it and building the
+// compiled scene, against writing that out once and mapping it back.
+void bench_scene_file() {
+    const int side = 1000;
+    FILE* file = fopen("bench_scene.scene", "w");
+    fprintf(file, "camera lookfrom 0 40 60 lookat 0 0 0 vfov 40\n");
+    fprintf(file, "material ground lambertian 0.5 0.5 0.5\nmaterial red lambertian 0.7 0.2 0.3\n"
+                  "material mirror metal 0.7 0.6 0.5 0.1\nmaterial glass dielectric 1.5\n");
+    const char* names[] = {"red", "mirror", "glass"};
+    sampler rng(2020);
+    for (int i = 0; i < side; i++)
+        for (int k = 0; k < side; k++)
+            fprintf(file, "sphere %.6f 0.02 %.6f 0.02 %s\n", 0.05 * (i - side / 2) + 0.03 * rng.random_double(),
+                    0.05 * (k - side / 2) + 0.03 * rng.random_double(), names[(i + k) % 3]);
+    fprintf(file, "xz_rect -100 100 -100 100 0 ground\n");
+    fclose(file);
+    cout << "scene_file (" << side * side + 1 << " primitives, " << file_size("bench_scene.scene") / (1 << 20) << " MiB of text)\n";
+
+    scene sc;
+    camera_settings view;
+    auto t_parse = seconds_for([&] { load_scene_file("bench_scene.scene", sc, view); });
+    compiled_scene<4> built;
+    auto t_build = seconds_for([&] { built = compiled_scene<4>(sc.objects, 0, 1); });
+    auto t_write = seconds_for([&] { write_scene_cache("bench_scene.rtsc", view, sc.materials, built); });
+
+    camera_settings cached_view;
+    material_table cached_materials;
+    compiled_scene<4> cached;
+    auto t_load = seconds_for([&] { load_scene_cache("bench_scene.rtsc", cached_view, cached_materials, cached); });
+    cout << "  parse text: " << t_parse * 1000 << " ms\n";
+    cout << "  build compiled_scene<4>: " << t_build * 1000 << " ms\n";
+    cout << "  write cache: " << t_write * 1000 << " ms, " << file_size("bench_scene.rtsc") / (1 << 20) << " MiB\n";
+    cout << "  load cache: " << t_load * 1000 << " ms, " << (t_parse + t_build) / t_load << "x faster than parse and build\n";
+    remove("bench_scene.scene");
+    remove("bench_scene.rtsc");
+
+    auto rays = camera_rays(camera(view.lookfrom, view.lookat, view.vup, view.vfov, 16.0 / 9.0), 1);
+    cout << "  mismatched hits, built against cached: " << mismatched_hits(built, cached, rays) << '\n';
+}
+
+
+// One bounce per camera ray: closest hit, then the material's sample, which is
+// the part of a path that looks up the material of the hit.
+void bench_shading() {
+    struct shading_scene { const char* name; scene world; vector<ray> rays; };
+    shading_scene scenes[] = {
+        {"pyramid (task7)", pyramid(), pyramid_camera_rays(4)},
+        {"random_spheres", random_spheres(), random_spheres_camera_rays(4)},
+    };
+
+    for (auto& sc : scenes) {
+        cout << "shading " << sc.name << ", " << sc.world.materials.size() << " materials\n";
+        wide_bvh<4> world(sc.world.objects, 0, 1);
+        auto t = seconds_for([&] {
+            sampler rng(1);
+            double sum = 0;
+            hit_record rec;
+            for (const auto& r : sc.rays) {
+                if (!world.hit(r, 0.001, numeric_limits<double>::infinity(), rec))
+                    continue;
+                scatter_sample s;
+                if (sc.world.materials[rec.mat_id].sample(r, rec, rng, s))
+                    sum += s.weight.x() + s.direction.y();
+            }
+            bench_sink = sum;
+        });
+        report("hit + sample", sc.rays.size(), t, "rays");
+    }
+}
+
+
+// The former scatter of metal, which drew a point in the unit sphere by
+// rejection: kept here only to compare against. Its draw count varies, so the
+// renderer, with a fixed count of sample dimensions per bounce, cannot use it.
+vec3 rejection_in_unit_sphere(sampler& rng) {
+    while (true) {
+        auto p = vec3::random(rng, -1,1);
+        if (p.length_squared() >= 1) continue;
+        return p;
+    }
+}
+
+bool rejection_metal_scatter(const metal& m, const ray& r_in, const hit_record& rec, sampler& rng,
+                             scatter_sample& s) {
+    vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
+    s.direction = reflected + m.fuzz*rejection_in_unit_sphere(rng);
+    s.weight = m.albedo;
+    return dot(s.direction, rec.normal) > 0;
+}
+
+// Hits on a surface facing +y, seen from directions spread over the hemisphere.
+vector<pair<ray, hit_record>> scatter_inputs(int count) {
+    vector<pair<ray, hit_record>> inputs;
+    sampler rng(7);
+    for (int k = 0; k < count; k++) {
+        hit_record rec;
+        rec.p = point3(0, 0, 0);
+        rec.normal = vec3(0, 1, 0);
+        rec.u = rec.v = 0.5;
+        rec.error = 0;
+        rec.front_face = true;
+        vec3 d = onb(rec.normal).local(random_cosine_direction(rng));
+        inputs.push_back({ray(d, -d), rec});
+    }
+    return inputs;
+}
+
+template <class Scatter>
+double scatter_all(const vector<pair<ray, hit_record>>& inputs, int rounds, Scatter scatter) {
+    sampler rng(11);
+    return seconds_for([&] {
+        long kept = 0;
+        double sum = 0;
+        for (int round = 0; round < rounds; round++)
+            for (const auto& in : inputs) {
+                scatter_sample s;
+                kept += scatter(in.first, in.second, rng, s);
+                sum += s.direction.y();
+            }
+        bench_sink = sum + kept;
+    });
+}
+
+// The sample of a material against its eval and pdf: the mean weight of its
+// samples must match the integral of eval over the sphere, estimated with
+// uniform directions, and pdf must give back the density sample drew with.
+void check_material(const string& name, const material& m, const ray& r_in, const hit_record& rec) {
+    const int n = 1 << 20;
+    sampler rng(17);
+    color by_sample(0,0,0), by_eval(0,0,0);
+    double pdf_error = 0;
+    for (int k = 0; k < n; k++) {
+        scatter_sample s;
+        if (m.sample(r_in, rec, rng, s)) {
+            by_sample += s.weight;
+            pdf_error = max(pdf_error, fabs(m.pdf(r_in, rec, s.direction) - s.pdf) / s.pdf);
+        }
+        vec3 d = random_unit_vector(rng);
+        by_eval += m.eval(r_in, rec, d) * (4*PI);
+    }
+    cout << "  " << name << ": reflectance by sample " << by_sample / n << ", by eval " << by_eval / n
+         << ", largest relative pdf mismatch " << pdf_error << '\n';
+}
+
+// Calls per second of the closed-form sample of each material, next to the
+// rejection-sampled scatter metal used before.
+void bench_scatter() {
+    const int rounds = 20;
+    auto inputs = scatter_inputs(1 << 16);
+    lambertian diffuse(color(0.5, 0.5, 0.5));
+    metal rough(color(0.8, 0.8, 0.8), 0.3);
+    metal mirror(color(0.8, 0.8, 0.8), 0.0);
+    dielectric glass(1.5);
+    cout << "scatter (" << inputs.size() * rounds << " calls each)\n";
+
+    auto run = [&](const string& name, auto scatter) {
+        report(name, double(inputs.size()) * rounds, scatter_all(inputs, rounds, scatter), "calls");
+    };
+    auto sample_of = [](const material& m) {
+        return [&m](const ray& r, const hit_record& rec, sampler& rng, scatter_sample& s) {
+            return m.sample(r, rec, rng, s);
+        };
+    };
+    run("lambertian sample", sample_of(diffuse));
+    run("metal (fuzz 0.3) sample, GGX", sample_of(rough));
+    run("metal (fuzz 0.3) scatter by rejection", [&](const ray& r, const hit_record& rec, sampler& rng, scatter_sample& s) {
+        return rejection_metal_scatter(rough, r, rec, rng, s);
+    });
+    run("metal (fuzz 0) sample", sample_of(mirror));
+    run("dielectric sample", sample_of(glass));
+
+    hit_record rec = inputs[0].second;
+    vec3 d = unit_vector(vec3(1, -1, 0));
+    ray r_in(-d, d);
+    check_material("lambertian", diffuse, r_in, rec);
+    check_material("metal (fuzz 0.3) at 45 degrees", rough, r_in, rec);
+    check_material("metal (fuzz 0.8) at 45 degrees", metal(color(1,1,1), 0.8), r_in, rec);
+}
+
+
+void bench_output() {
+    cout << "output (1920x1080)\n";
+    float_image image(1920, 1080);
+    sampler rng(7);
+    for (auto& value : image.rgb)
+        value = static_cast<float>(100 * rng.random_double());
+
+    auto t_p3 = seconds_for([&] {
+        ofstream img("bench_p3.ppm");
+        img << "P3\n" << image.width << ' ' << image.height << "\n255\n";
+        for (int j = image.height-1; j >= 0; --j)
+            for (int i = 0; i < image.width; ++i)
+                write_color(img, image.get(i, j), 100);
+    });
+
+    struct format { const char* name; const char* path; };
+    format formats[] = {
+        {"P6 ppm", "bench_p6.ppm"}, {"float pfm", "bench.pfm"}, {"stored png", "bench.png"},
+    };
+
+    cout << "  P3 ppm, write_color per pixel: " << t_p3 * 1000 << " ms, "
+         << file_size("bench_p3.ppm") / 1024 << " KiB\n";
+    remove("bench_p3.ppm");
+    for (const auto& f : formats) {
+        auto t = seconds_for([&] { write_image(f.path, image, 100); });
+        cout << "  " << f.name << ": " << t * 1000 << " ms, " << file_size(f.path) / 1024 << " KiB\n";
+        remove(f.path);
+    }
+}
+
+
+// Where every ray of rays hits world first, or -1, through single rays or
+// through packets.
+vector<double> hit_distances(const hittable& world, const vector<ray>& rays) {
+    vector<double> t(rays.size(), -1);
+    hit_record rec;
+    for (size_t k = 0; k < rays.size(); k++)
+        if (world.hit(rays[k], 0.001, numeric_limits<double>::infinity(), rec))
+            t[k] = rec.t;
+    return t;
+}
+
+template <int N>
+vector<double> packet_distances(const wide_bvh<N>& world, const vector<ray>& rays) {
+    vector<double> t(rays.size(), -1);
+    hit_record recs[packet_size];
+    for (size_t k = 0; k < rays.size(); k += packet_size) {
+        int n = static_cast<int>(min<size_t>(packet_size, rays.size() - k));
+        unsigned hits = world.hit_packet(&rays[k], n, 0.001, numeric_limits<double>::infinity(), recs);
+        for (int i = 0; i < n; i++)
+            if (hits & (1u << i))
+                t[k + i] = recs[i].t;
+    }
+    return t;
+}
+
+template <class T>
+long differences(const vector<T>& a, const vector<T>& b) {
+    long count = 0;
+    for (size_t k = 0; k < a.size(); k++)
+        count += a[k] != b[k];
+    return count;
+}
+
+// Every kernel level this CPU runs, on the kernels that have a copy per level,
+// against the scalar one. The levels have to agree bit for bit.
+void bench_isa() {
+    cout << "isa (the CPU supports " << isa_name(detected_isa()) << ")\n";
+    hittable_list objects = pyramid().objects;
+    auto rays = pyramid_camera_rays(4);
+    wide_bvh<4> wide4(objects, 0, 1);
+    wide_bvh<8> wide8(objects, 0, 1);
+    wide_bvh<16> wide16(objects, 0, 1);
+
+    sphere_set spheres;
+    for (const auto& object : random_spheres().objects.objects)
+        spheres.add(static_cast<const sphere&>(*object));
+    auto sphere_rays = random_spheres_camera_rays(1);
+
+    vector<xyz> positions, normals;
+    vector<uint32_t> indices;
+    parametric_torus(200, 400, positions, normals, indices);
+    triangle_mesh mesh(positions, normals, indices, 0);
+    auto mesh_rays = camera_rays(camera(point3(0, 2.5, 2.5), point3(0, 0, 0), vec3(0,1,0), 40, 16.0 / 9.0), 1);
+
+    float_image image(1920, 1080);
+    sampler rng(7);
+    for (auto& value : image.rgb)
+        value = static_cast<float>(100 * rng.random_double());
+
+    struct kernel {
+        const char* name;
+        function<vector<double>()> run;
+        size_t count;
+        vector<double> scalar;
+    };
+    vector<kernel> kernels = {
+        {"wide_bvh<4>", [&] { return hit_distances(wide4, rays); }, rays.size(), {}},
+        {"wide_bvh<8>", [&] { return hit_distances(wide8, rays); }, rays.size(), {}},
+        {"wide_bvh<16>", [&] { return hit_distances(wide16, rays); }, rays.size(), {}},
+        {"wide_bvh<4>, 8-ray packets", [&] { return packet_distances(wide4, rays); }, rays.size(), {}},
+        {"sphere_set of random_spheres", [&] { return hit_distances(spheres, sphere_rays); }, sphere_rays.size(), {}},
+        {"triangle_mesh (torus)", [&] { return hit_distances(mesh, mesh_rays); }, mesh_rays.size(), {}},
+    };
+
+    vector<unsigned char> scalar_bytes;
+    for (int k = isa_scalar; k <= detected_isa(); k++) {
+        auto level = static_cast<isa_level>(k);
+        select_isa(level);
+        cout << "  " << isa_name(level) << '\n';
+        for (auto& kn : kernels) {
+            vector<double> t;
+            report(string("  ") + kn.name, kn.count, seconds_for([&] { t = kn.run(); }), "rays");
+            if (level == isa_scalar)
+                kn.scalar = t;
+            else if (long d = differences(t, kn.scalar))
+                cout << "    differs from scalar on " << d << " rays\n";
+        }
+        vector<unsigned char> bytes;
+        report("  image_bytes 1920x1080", image.rgb.size(), seconds_for([&] { bytes = image_bytes(image, 100); }),
+               "values");
+        if (level == isa_scalar)
+            scalar_bytes = bytes;
+        else if (long d = differences(bytes, scalar_bytes))
+            cout << "    differs from scalar in " << d << " bytes\n";
+    }
+    select_isa(detected_isa());
+}
+
+
+// The error against a 4096-spp Sobol reference of every sequence at 1 to 256
+// spp, on the scenes of the earlier tasks and this one. The figure in brackets
+// is how many times more independent samples give the same error.
+void bench_convergence() {
+    struct convergence_scene { const char* name; scene sc; camera cam; };
+    const int width = 96, height = 54;
+    const double aspect_ratio = 16.0 / 9.0;
+    convergence_scene scenes[] = {
+        {"task1_spheres", task1_spheres(), camera(point3(-0.4, 0, -2.5), point3(-0.4, 0, -1.5), vec3(0,1,0), 90, aspect_ratio)},
+        {"task5_dielectrics", dielectric_spheres(), camera(point3(0, 0, 0), point3(0, 0, -1), vec3(0,1,0), 90, aspect_ratio)},
+        {"task6_random_spheres", random_spheres(), camera(point3(13,2,3), point3(0,0,0), vec3(0,1,0), 20, aspect_ratio)},
+        {"task7_pyramid", pyramid(), camera(point3(6,10,12), point3(0,0,0), vec3(0,1,0), 20, aspect_ratio)},
+    };
+    const int counts[] = {1, 4, 16, 64, 256};
+
+    thread_pool pool(std::thread::hardware_concurrency());
+    for (auto& cs : scenes) {
+        compiled_scene<4> world(cs.sc.objects, 0, 1);
+        cout << "convergence (" << cs.name << ", " << width << "x" << height << ")\n";
+        auto render = [&](int spp, sample_sequence sequence) {
+            render_options options;
+            options.sampling.min_spp = options.sampling.max_spp = spp;
+            options.sampling.sequence = sequence;
+            vector<pixel_statistics> pixels;
+            path_histogram lengths;
+            return render_scene(pool, world, cs.sc.materials, cs.cam, width, height, 50, options, pixels, lengths);
+        };
+
+        auto reference = render(4096, sobol_samples);
+        double independent_error[5];
+        for (int k = independent_samples; k <= blue_noise_samples; k++) {
+            auto sequence = static_cast<sample_sequence>(k);
+            cout << "  " << sequence_name(sequence) << ":";
+            for (int c = 0; c < 5; c++) {
+                double error = rms_error(render(counts[c], sequence), reference);
+                if (sequence == independent_samples)
+                    independent_error[c] = error;
+                double ratio = independent_error[c] / error;
+                cout << ' ' << counts[c] << " spp " << error << " (" << ratio * ratio << "x)";
+            }
+            cout << '\n';
+        }
+    }
+}
+
+
+struct benchmark {
+    const char* name;
+    void (*run)();
+};
+
+int main(int argc, char* argv[]) {
+    vector<benchmark> benchmarks = {
+        {"rng", bench_rng},
+        {"bvh", bench_bvh},
+        {"packets", bench_packets},
+        {"spheres", bench_spheres},
+        {"box", bench_box},
+        {"compiled", bench_compiled},
+        {"instances", bench_instances},
+        {"mesh", bench_mesh},
+        {"build", bench_build},
+        {"scene_file", bench_scene_file},
+        {"shading", bench_shading},
+        {"scatter", bench_scatter},
+        {"output", bench_output},
+        {"convergence", bench_convergence},
+        {"isa", bench_isa},
+    };
+
+    for (const auto& b : benchmarks) {
+        bool selected = argc == 1;
+        for (int a = 1; a < argc; a++)
+            selected = selected || strcmp(argv[a], b.name) == 0;
+        if (selected)
+            b.run();
+    }
+}
@@ -5,39 +5,95 @@
 #ifndef box_h
 #define box_h
 
-#include "aarect.h"
-#include "hittable_list.h"
+#include "hittable.h"
 #include "material.h"
 
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+// Axis-aligned box intersected with one slab test: the ray enters at the largest
+// near distance over the three axes and leaves at the smallest far distance. The
+// face is the slab that set the distance, so a box is two corners and a material
+// rather than six rects. Hits the same faces, at the same t, as the six xy/xz/yz
+// rects of its corners, which stay available in aarect.h.
 class box : public hittable  {
     public:
         box() {}
-        box(const point3& p0, const point3& p1, shared_ptr<material> ptr);
+        box(const point3& p0, const point3& p1, uint32_t mat_id)
+            : box_min(p0), box_max(p1), mat_id(mat_id) {}
 
         virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
 
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override {
+            output_box = aabb(box_min, box_max);
+            return true;
+        }
+
     public:
         point3 box_min;
         point3 box_max;
-        hittable_list sides;
+        uint32_t mat_id;
 };
 
-box::box(const point3& p0, const point3& p1, shared_ptr<material> ptr) {
-    box_min = p0;
-    box_max = p1;
+bool box::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+    real t_enter = -std::numeric_limits<real>::infinity();
+    real t_exit = std::numeric_limits<real>::infinity();
+    int enter_axis = 0, exit_axis = 0;
 
-    sides.add(make_shared<xy_rect>(p0.x(), p1.x(), p0.y(), p1.y(), p1.z(), ptr));
-    sides.add(make_shared<xy_rect>(p0.x(), p1.x(), p0.y(), p1.y(), p0.z(), ptr));
+    for (int a = 0; a < 3; a++) {
+        real origin = r.origin()[a];
+        real direction = r.direction()[a];
+        if (direction == 0) {
+            // Parallel to this slab: inside it everywhere or nowhere.
+            if (origin < box_min[a] || origin > box_max[a])
+                return false;
+            continue;
+        }
 
-    sides.add(make_shared<xz_rect>(p0.x(), p1.x(), p0.z(), p1.z(), p1.y(), ptr));
-    sides.add(make_shared<xz_rect>(p0.x(), p1.x(), p0.z(), p1.z(), p0.y(), ptr));
+        // Divided like the rects, so t comes out bit for bit the same.
+        real t0 = (box_min[a] - origin) / direction;
+        real t1 = (box_max[a] - origin) / direction;
+        if (t0 > t1)
+            std::swap(t0, t1);
+        if (t0 > t_enter) { t_enter = t0; enter_axis = a; }
+        if (t1 < t_exit) { t_exit = t1; exit_axis = a; }
+    }
+    if (t_enter > t_exit)
+        return false;
 
-    sides.add(make_shared<yz_rect>(p0.y(), p1.y(), p0.z(), p1.z(), p1.x(), ptr));
-    sides.add(make_shared<yz_rect>(p0.y(), p1.y(), p0.z(), p1.z(), p0.x(), ptr));
-}
+    // From inside the box, or with the entry before t_min, the exit face is hit.
+    real t;
+    int axis;
+    bool entering;
+    if (t_enter >= t_min && t_enter <= t_max) {
+        t = t_enter; axis = enter_axis; entering = true;
+    } else if (t_exit >= t_min && t_exit <= t_max) {
+        t = t_exit; axis = exit_axis; entering = false;
+    } else {
+        return false;
+    }
 
-bool box::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
-    return sides.hit(r, t_min, t_max, rec);
+    // A ray enters through the face looking against its direction.
+    vec3 outward_normal(0, 0, 0);
+    outward_normal[axis] = (r.direction()[axis] > 0) == entering ? -1 : 1;
+
+    // On the face exactly, whatever the rounding of t.
+    rec.t = t;
+    rec.p = r.at(t);
+    rec.p[axis] = outward_normal[axis] > 0 ? box_max[axis] : box_min[axis];
+    rec.error = 0;
+
+    // u and v run along the other two axes in x, y, z order, as on the rects.
+    int u_axis = axis == 0 ? 1 : 0;
+    int v_axis = axis == 2 ? 1 : 2;
+    rec.u = (rec.p[u_axis] - box_min[u_axis]) / (box_max[u_axis] - box_min[u_axis]);
+    rec.v = (rec.p[v_axis] - box_min[v_axis]) / (box_max[v_axis] - box_min[v_axis]);
+
+    rec.set_face_normal(r, outward_normal);
+    rec.mat_id = mat_id;
+
+    return true;
 }
 
 #endif /* box_h */
@@ -7,28 +7,60 @@
 
 #include "hittable.h"
 #include "hittable_list.h"
-#include <random>
 #include "aabb.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <vector>
 
 
+// What the builder reports about the tree it made.
+struct bvh_build_stats {
+    double build_seconds = 0;
+    size_t node_count = 0;
+    size_t leaf_count = 0;
+    double sah_cost = 0;   // expected cost of a random ray, relative to the root box
+    size_t primitive_count = 0;
+};
+
+inline std::ostream& operator<<(std::ostream &out, const bvh_build_stats &s) {
+    out << "BVH: " << s.node_count << " nodes, " << s.leaf_count << " leaves, SAH cost "
+        << s.sah_cost << ", built in " << s.build_seconds * 1000 << " ms";
+    if (s.primitive_count)
+        out << " (" << s.build_seconds * 1000 / (s.primitive_count / 1e6) << " ms per million primitives)";
+    return out;
+}
+
+
+// One scene object as seen by the builder: its box is computed once up front.
+// Callers that store their primitives themselves, like triangle_mesh, leave object
+// empty and find theirs again by index.
+struct bvh_primitive {
+    shared_ptr<hittable> object;
+    aabb box;
+    point3 centroid;
+    uint32_t index;     // position in the builder's input
+};
+
 
 class bvh_node : public hittable  {
     public:
-        bvh_node();
+        bvh_node() {}
 
-        bvh_node(const hittable_list& list, double time0, double time1)
-            : bvh_node(list.objects, 0, list.objects.size(), time0, time1)
-        {}
+        bvh_node(const hittable_list& list, double time0, double time1,
+                 bvh_build_stats* stats = nullptr);
 
-        bvh_node(
-            const std::vector<shared_ptr<hittable>>& src_objects,
-            size_t start, size_t end, double time0, double time1);
+        bvh_node(std::vector<bvh_primitive>& primitives, size_t start, size_t end,
+                 bvh_build_stats& stats);
 
         virtual bool hit(
             const ray& r, double t_min, double t_max, hit_record& rec) const override;
 
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
+
     public:
         shared_ptr<hittable> left;
         shared_ptr<hittable> right;
@@ -36,6 +68,217 @@ class bvh_node : public hittable  {
 };
 
 
+// Surface area heuristic costs, relative to one primitive intersection.
+const double bvh_traversal_cost = 1.0;
+const double bvh_intersection_cost = 1.0;
+const int bvh_bin_count = 12;
+
+
+std::vector<bvh_primitive> bvh_primitives(const hittable_list& list, double time0, double time1) {
+    std::vector<bvh_primitive> primitives;
+    primitives.reserve(list.objects.size());
+    for (const auto& object : list.objects) {
+        bvh_primitive p;
+        p.object = object;
+        if (!object->bounding_box(time0, time1, p.box))
+            std::cerr << "No bounding box in BVH builder.\n";
+        p.centroid = 0.5 * (p.box.min() + p.box.max());
+        p.index = static_cast<uint32_t>(primitives.size());
+        primitives.push_back(p);
+    }
+    return primitives;
+}
+
+
+struct sah_split_result {
+    size_t mid;     // first index of the right half
+    int axis;       // split axis, or -1 when all centroids coincide
+    double cost;    // sum of count*area over both halves
+};
+
+// Which of the bins along axis a centroid falls in.
+inline int sah_bin(const point3& centroid, int axis, double lo, double extent) {
+    return std::min(bvh_bin_count - 1, static_cast<int>(bvh_bin_count * (centroid[axis] - lo) / extent));
+}
+
+// Box and count of the primitives in every bin along each axis. Axes along which
+// all centroids coincide are left empty. The bins of the parts of a range merge
+// into exactly the bins of the whole range, so they can be filled in parallel.
+struct sah_bins {
+    double lo[3], extent[3];
+    aabb box[3][bvh_bin_count];
+    size_t size[3][bvh_bin_count] = {};
+
+    explicit sah_bins(const aabb& centroid_bounds) {
+        for (int axis = 0; axis < 3; axis++) {
+            lo[axis] = centroid_bounds.min()[axis];
+            extent[axis] = centroid_bounds.max()[axis] - lo[axis];
+        }
+    }
+
+    void add(const bvh_primitive& p) {
+        for (int axis = 0; axis < 3; axis++) {
+            if (extent[axis] <= 0)
+                continue;
+            int b = sah_bin(p.centroid, axis, lo[axis], extent[axis]);
+            if (size[axis][b])
+                box[axis][b].expand(p.box);
+            else
+                box[axis][b] = p.box;
+            size[axis][b]++;
+        }
+    }
+
+    void merge(const sah_bins& other) {
+        for (int axis = 0; axis < 3; axis++)
+            for (int b = 0; b < bvh_bin_count; b++) {
+                if (!other.size[axis][b])
+                    continue;
+                if (size[axis][b])
+                    box[axis][b].expand(other.box[axis][b]);
+                else
+                    box[axis][b] = other.box[axis][b];
+                size[axis][b] += other.size[axis][b];
+            }
+    }
+};
+
+// The cheapest plane between two bins by the surface area heuristic.
+struct sah_plane {
+    int axis = -1;      // -1 when all centroids coincide
+    int bin = 0;        // last bin on the left
+    double cost = std::numeric_limits<double>::infinity();
+};
+
+sah_plane cheapest_plane(const sah_bins& bins) {
+    sah_plane best;
+    for (int axis = 0; axis < 3; axis++) {
+        if (bins.extent[axis] <= 0)
+            continue;
+        const aabb* bin_box = bins.box[axis];
+        const size_t* bin_size = bins.size[axis];
+
+        // Sweep from the right to get the area and count of every right-hand side.
+        double right_area[bvh_bin_count];
+        size_t right_size[bvh_bin_count];
+        aabb acc;
+        size_t count = 0;
+        for (int b = bvh_bin_count - 1; b > 0; b--) {
+            if (bin_size[b] && count)
+                acc.expand(bin_box[b]);
+            else if (bin_size[b])
+                acc = bin_box[b];
+            count += bin_size[b];
+            right_area[b] = count ? acc.area() : 0;
+            right_size[b] = count;
+        }
+
+        count = 0;
+        for (int b = 0; b < bvh_bin_count - 1; b++) {
+            if (bin_size[b] && count)
+                acc.expand(bin_box[b]);
+            else if (bin_size[b])
+                acc = bin_box[b];
+            count += bin_size[b];
+            if (count == 0 || right_size[b+1] == 0)
+                continue;
+
+            double cost = count * acc.area() + right_size[b+1] * right_area[b+1];
+            if (cost < best.cost) {
+                best.cost = cost;
+                best.axis = axis;
+                best.bin = b;
+            }
+        }
+    }
+    return best;
+}
+
+// Partitions the range around plane, or halves it when there is none.
+sah_split_result split_at(std::vector<bvh_primitive>& primitives, size_t start, size_t end,
+                          const sah_bins& bins, const sah_plane& plane) {
+    if (plane.axis < 0) {
+        // All centroids coincide: any split is as good as another.
+        auto mid = start + (end - start) / 2;
+        aabb left_box = primitives[start].box, right_box = primitives[mid].box;
+        for (size_t i = start; i < mid; i++) left_box.expand(primitives[i].box);
+        for (size_t i = mid; i < end; i++) right_box.expand(primitives[i].box);
+        return {mid, -1, (mid - start) * left_box.area() + (end - mid) * right_box.area()};
+    }
+
+    double lo = bins.lo[plane.axis], extent = bins.extent[plane.axis];
+    auto split = std::partition(primitives.begin() + start, primitives.begin() + end,
+        [&](const bvh_primitive& p) { return sah_bin(p.centroid, plane.axis, lo, extent) <= plane.bin; });
+
+    return {static_cast<size_t>(split - primitives.begin()), plane.axis, plane.cost};
+}
+
+// Bins the centroids along each axis, picks the cheapest plane by the surface area
+// heuristic and partitions the range around it.
+sah_split_result sah_split(std::vector<bvh_primitive>& primitives, size_t start, size_t end) {
+    aabb centroid_bounds(primitives[start].centroid, primitives[start].centroid);
+    for (size_t i = start + 1; i < end; i++)
+        centroid_bounds.expand(primitives[i].centroid);
+
+    sah_bins bins(centroid_bounds);
+    for (size_t i = start; i < end; i++)
+        bins.add(primitives[i]);
+    return split_at(primitives, start, end, bins, cheapest_plane(bins));
+}
+
+
+bvh_node::bvh_node(const hittable_list& list, double time0, double time1, bvh_build_stats* stats) {
+    auto start_time = std::chrono::steady_clock::now();
+
+    auto primitives = bvh_primitives(list, time0, time1);
+
+    bvh_build_stats local_stats;
+    *this = bvh_node(primitives, 0, primitives.size(), local_stats);
+    local_stats.primitive_count = primitives.size();
+
+    // The per-node costs were accumulated as absolute areas; normalize by the root.
+    local_stats.sah_cost /= box.area();
+    local_stats.build_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    if (stats)
+        *stats = local_stats;
+}
+
+
+bvh_node::bvh_node(std::vector<bvh_primitive>& primitives, size_t start, size_t end,
+                   bvh_build_stats& stats) {
+    size_t object_span = end - start;
+    stats.node_count++;
+
+    if (object_span == 1) {
+        left = right = primitives[start].object;
+        box = primitives[start].box;
+        stats.leaf_count++;
+        stats.sah_cost += box.area() * bvh_intersection_cost;
+        return;
+    }
+
+    if (object_span == 2) {
+        left = primitives[start].object;
+        right = primitives[start+1].object;
+        box = surrounding_box(primitives[start].box, primitives[start+1].box);
+        stats.leaf_count++;
+        stats.sah_cost += box.area() * 2 * bvh_intersection_cost;
+        return;
+    }
+
+    auto mid = sah_split(primitives, start, end).mid;
+    left = make_shared<bvh_node>(primitives, start, mid, stats);
+    right = make_shared<bvh_node>(primitives, mid, end, stats);
+
+    aabb box_left, box_right;
+    left->bounding_box(0, 0, box_left);
+    right->bounding_box(0, 0, box_right);
+    box = surrounding_box(box_left, box_right);
+    stats.sah_cost += box.area() * bvh_traversal_cost;
+}
+
+
 bool bvh_node::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
     if (!box.hit(r, t_min, t_max))
         return false;
@@ -47,7 +290,9 @@ bool bvh_node::hit(const ray& r, double t_min, double t_max, hit_record& rec) co
 }
 
 
-
+bool bvh_node::bounding_box(double time0, double time1, aabb& output_box) const {
+    output_box = box;
+    return true;
+}
 
 #endif /* bvh_h */
-
@@ -0,0 +1,341 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef bvh_builder_h
+#define bvh_builder_h
+
+#include "bvh.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// How linear_bvh, and the trees made from it, are built. Binned SAH makes the
+// trees that trace fastest. LBVH sorts the primitives along a Morton curve and
+// splits the ranges where their codes do, which builds several times faster
+// and traces somewhat slower: for previews of huge scenes.
+enum bvh_build_mode { sah_build, lbvh_build };
+
+inline const char* bvh_build_name(bvh_build_mode mode) {
+    static const char* names[] = { "sah", "lbvh" };
+    return names[mode];
+}
+
+inline bool parse_bvh_build(const std::string& name, bvh_build_mode& mode) {
+    for (int k = sah_build; k <= lbvh_build; k++)
+        if (name == bvh_build_name(static_cast<bvh_build_mode>(k))) {
+            mode = static_cast<bvh_build_mode>(k);
+            return true;
+        }
+    return false;
+}
+
+// With a pool, both modes build on its threads; the SAH tree comes out the same
+// with and without one.
+struct bvh_build_options {
+    bvh_build_mode mode = sah_build;
+    thread_pool* pool = nullptr;
+};
+
+
+// Ranges smaller than this are built on one thread, and passes over a range are
+// split into parts of parallel_chunk primitives.
+const size_t parallel_grain = 4096;
+const size_t parallel_chunk = 16384;
+
+// Calls body(k, first, last) for the parts k of [start, end), on the pool when
+// there is one and the range is worth splitting. Returns the number of parts.
+template <class Body>
+size_t for_parts(thread_pool* pool, size_t start, size_t end, const Body& body) {
+    size_t parts = pool && end - start >= 2 * parallel_chunk ? (end - start) / parallel_chunk : 1;
+    auto run = [&](size_t k) { body(k, start + k * (end - start) / parts, start + (k + 1) * (end - start) / parts); };
+    if (parts == 1)
+        run(0);
+    else
+        pool->parallel_for(parts, run);
+    return parts;
+}
+
+// bvh_primitives on the threads of pool.
+std::vector<bvh_primitive> bvh_primitives(const hittable_list& list, double time0, double time1,
+                                          thread_pool* pool) {
+    std::vector<bvh_primitive> primitives(list.objects.size());
+    for_parts(pool, 0, primitives.size(), [&](size_t, size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            bvh_primitive& p = primitives[i];
+            p.object = list.objects[i];
+            if (!p.object->bounding_box(time0, time1, p.box))
+                std::cerr << "No bounding box in BVH builder.\n";
+            p.centroid = 0.5 * (p.box.min() + p.box.max());
+            p.index = static_cast<uint32_t>(i);
+        }
+    });
+    return primitives;
+}
+
+
+// Spreads the low ten bits of v out to every third bit.
+inline uint32_t spread_bits(uint32_t v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+// 30-bit Morton code of p on a 1024^3 grid over bounds, x in the highest bit of
+// every three.
+inline uint32_t morton_code(const point3& p, const aabb& bounds) {
+    uint32_t cell[3];
+    for (int a = 0; a < 3; a++) {
+        double extent = bounds.max()[a] - bounds.min()[a];
+        double t = extent > 0 ? (p[a] - bounds.min()[a]) / extent : 0;
+        cell[a] = std::min(1023u, static_cast<uint32_t>(t * 1024));
+    }
+    return spread_bits(cell[0]) << 2 | spread_bits(cell[1]) << 1 | spread_bits(cell[2]);
+}
+
+// Sorts keys below 2^30, and values along with them, in three stable passes of
+// ten bits. Every part of the input counts its digits and then scatters its own
+// elements, so the parts run on the pool.
+void radix_sort(std::vector<uint32_t>& keys, std::vector<uint32_t>& values, thread_pool* pool) {
+    const int digit_bits = 10, digits = 1 << digit_bits;
+    const size_t n = keys.size();
+    std::vector<uint32_t> key_buffer(n), value_buffer(n);
+    std::vector<size_t> offsets;
+
+    for (int shift = 0; shift < 30; shift += digit_bits) {
+        auto digit = [&](uint32_t key) { return (key >> shift) & (digits - 1); };
+
+        // Counts per part, then turned into where each part's elements of each
+        // digit go: all smaller digits first, then the same digit of earlier parts.
+        offsets.assign(digits * std::max<size_t>(1, n / parallel_chunk), 0);
+        size_t parts = for_parts(pool, 0, n, [&](size_t k, size_t first, size_t last) {
+            size_t* count = &offsets[k * digits];
+            for (size_t i = first; i < last; i++)
+                count[digit(keys[i])]++;
+        });
+        size_t total = 0;
+        for (int d = 0; d < digits; d++)
+            for (size_t k = 0; k < parts; k++) {
+                size_t count = offsets[k * digits + d];
+                offsets[k * digits + d] = total;
+                total += count;
+            }
+
+        for_parts(pool, 0, n, [&](size_t k, size_t first, size_t last) {
+            size_t* next = &offsets[k * digits];
+            for (size_t i = first; i < last; i++) {
+                size_t to = next[digit(keys[i])]++;
+                key_buffer[to] = keys[i];
+                value_buffer[to] = values[i];
+            }
+        });
+        keys.swap(key_buffer);
+        values.swap(value_buffer);
+    }
+}
+
+
+// Node of a tree under construction. The two children of an interior node sit
+// next to each other; linear_bvh lays the tree out depth first afterwards.
+struct bvh_build_node {
+    aabb box;
+    uint32_t start = 0, end = 0;    // primitives of a leaf
+    uint32_t left = 0;              // first child of an interior node, 0 for a leaf
+    uint8_t axis = 0;               // split axis of an interior node
+};
+
+
+// Builds a binary tree over primitives, reordering them so every leaf holds a
+// range of them and the leaves come in depth-first order. Subtrees of at least
+// parallel_grain primitives are built as jobs on the pool, and the passes over
+// larger ranges are split into parts, which only leaves the partitions near the
+// root on one thread.
+class bvh_builder {
+    public:
+        bvh_builder(std::vector<bvh_primitive>& primitives, const bvh_build_options& options,
+                    int max_leaf_size, int max_depth)
+            : primitives(primitives), options(options), max_leaf_size(max_leaf_size), max_depth(max_depth) {
+            if (primitives.empty())
+                return;
+            nodes.resize(2 * primitives.size() - 1);
+            if (options.mode == lbvh_build)
+                build_lbvh();
+            else
+                build_sah(0, 0, primitives.size(), 0);
+            nodes.resize(next_node);
+        }
+
+    public:
+        std::vector<bvh_build_node> nodes;     // the root first
+
+    private:
+        struct range_bounds {
+            aabb box, centroids;
+
+            void add(const bvh_primitive& p) {
+                box.expand(p.box);
+                centroids.expand(p.centroid);
+            }
+            void merge(const range_bounds& other) {
+                box.expand(other.box);
+                centroids.expand(other.centroids);
+            }
+        };
+
+        // Adds the primitives of the range to empty, part by part on the pool for
+        // big ranges, and merges the parts in order.
+        template <class Part>
+        Part reduce(size_t start, size_t end, const Part& empty) const {
+            if (!options.pool || end - start < 2 * parallel_chunk) {
+                Part part = empty;
+                for (size_t i = start; i < end; i++)
+                    part.add(primitives[i]);
+                return part;
+            }
+            std::vector<Part> parts((end - start) / parallel_chunk, empty);
+            for_parts(options.pool, start, end, [&](size_t k, size_t first, size_t last) {
+                for (size_t i = first; i < last; i++)
+                    parts[k].add(primitives[i]);
+            });
+            for (size_t k = 1; k < parts.size(); k++)
+                parts[0].merge(parts[k]);
+            return parts[0];
+        }
+
+        // The boxes around the primitives and around their centroids.
+        range_bounds bounds_of(size_t start, size_t end) const {
+            const point3 lo(INFINITY, INFINITY, INFINITY), hi(-INFINITY, -INFINITY, -INFINITY);
+            return reduce(start, end, range_bounds{ aabb(lo, hi), aabb(lo, hi) });
+        }
+
+        uint32_t allocate_children() { return next_node.fetch_add(2); }
+
+        void make_leaf(bvh_build_node& node, size_t start, size_t end) {
+            node.start = static_cast<uint32_t>(start);
+            node.end = static_cast<uint32_t>(end);
+            node.left = 0;
+        }
+
+        // Runs both, the first as a job when the range is big enough to be worth one.
+        template <class First, class Second>
+        void fork(size_t span, const First& first, const Second& second) {
+            if (!options.pool || span < parallel_grain) {
+                first();
+                second();
+                return;
+            }
+            task_group group;
+            options.pool->submit(group, first);
+            second();
+            options.pool->wait(group);
+        }
+
+        // The binned SAH split of linear_bvh, with the leaf decision made the same
+        // way, so the tree does not depend on the pool.
+        void build_sah(uint32_t index, size_t start, size_t end, int depth) {
+            bvh_build_node& node = nodes[index];
+            range_bounds bounds = bounds_of(start, end);
+            node.box = bounds.box;
+
+            size_t span = end - start;
+            sah_split_result split = {start, -1, 0};
+            bool leaf = span == 1 || depth >= max_depth - 1;
+
+            if (!leaf) {
+                sah_bins bins = reduce(start, end, sah_bins(bounds.centroids));
+                split = split_at(primitives, start, end, bins, cheapest_plane(bins));
+                double leaf_cost = span * node.box.area() * bvh_intersection_cost;
+                double split_cost = node.box.area() * bvh_traversal_cost + split.cost * bvh_intersection_cost;
+                leaf = span <= static_cast<size_t>(max_leaf_size) && leaf_cost <= split_cost;
+            }
+
+            if (leaf) {
+                make_leaf(node, start, end);
+                return;
+            }
+
+            uint32_t left = allocate_children();
+            node.left = left;
+            node.axis = static_cast<uint8_t>(split.axis < 0 ? 0 : split.axis);
+            fork(span,
+                 [=] { build_sah(left, start, split.mid, depth + 1); },
+                 [=] { build_sah(left + 1, split.mid, end, depth + 1); });
+        }
+
+        // Sorts the primitives by the Morton codes of their centroids, then splits
+        // every range at its highest bit that differs.
+        void build_lbvh() {
+            const size_t n = primitives.size();
+            const aabb centroid_bounds = bounds_of(0, n).centroids;
+
+            std::vector<uint32_t> order(n);
+            codes.resize(n);
+            for_parts(options.pool, 0, n, [&](size_t, size_t first, size_t last) {
+                for (size_t i = first; i < last; i++) {
+                    codes[i] = morton_code(primitives[i].centroid, centroid_bounds);
+                    order[i] = static_cast<uint32_t>(i);
+                }
+            });
+            radix_sort(codes, order, options.pool);
+
+            std::vector<bvh_primitive> sorted(n);
+            for_parts(options.pool, 0, n, [&](size_t, size_t first, size_t last) {
+                for (size_t i = first; i < last; i++)
+                    sorted[i] = std::move(primitives[order[i]]);
+            });
+            primitives.swap(sorted);
+
+            build_morton(0, 0, n, 0);
+        }
+
+        void build_morton(uint32_t index, size_t start, size_t end, int depth) {
+            bvh_build_node& node = nodes[index];
+            size_t span = end - start;
+            if (span <= lbvh_leaf_size || depth >= max_depth - 1) {
+                node.box = primitives[start].box;
+                for (size_t i = start + 1; i < end; i++)
+                    node.box.expand(primitives[i].box);
+                make_leaf(node, start, end);
+                return;
+            }
+
+            // Primitives in the same cell are halved.
+            size_t mid = start + span / 2;
+            int axis = 0;
+            uint32_t first = codes[start], last = codes[end - 1];
+            if (first != last) {
+                int bit = 31 - __builtin_clz(first ^ last);
+                mid = std::partition_point(codes.begin() + start, codes.begin() + end,
+                    [bit](uint32_t code) { return !(code >> bit & 1); }) - codes.begin();
+                axis = 2 - bit % 3;
+            }
+
+            uint32_t left = allocate_children();
+            node.left = left;
+            node.axis = static_cast<uint8_t>(axis);
+            fork(span,
+                 [=] { build_morton(left, start, mid, depth + 1); },
+                 [=] { build_morton(left + 1, mid, end, depth + 1); });
+            node.box = surrounding_box(nodes[left].box, nodes[left + 1].box);
+        }
+
+    private:
+        std::vector<bvh_primitive>& primitives;
+        bvh_build_options options;
+        int max_leaf_size, max_depth;
+        std::atomic<uint32_t> next_node{1};
+        std::vector<uint32_t> codes;    // of the sorted primitives, for LBVH
+
+        // LBVH leaves are not chosen by cost, so they are kept small.
+        static const size_t lbvh_leaf_size = 2;
+};
+
+#endif /* bvh_builder_h */
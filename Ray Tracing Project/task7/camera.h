@@ -7,8 +7,6 @@
 
 #include "ray.h"
 
-const double PI = 3.1415926535897932385;
-
 inline double degrees_to_radians(double degrees) {
     return degrees * PI / 180.0;
 }
@@ -14,21 +14,38 @@ inline double clamp(double x, double min, double max) {
     return x;
 }
 
-void write_color(std::ostream &out, color pixel_color, int samples_per_pixel) {
-    auto r = pixel_color.x();
-    auto g = pixel_color.y();
-    auto b = pixel_color.z();
+// Relative luminance of a linear RGB color (Rec. 709 weights).
+inline double luminance(const color& c) {
+    return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+}
+
+// The 8-bit value of a component already averaged over the samples. In floats,
+// and with NaN going to 0, exactly like the SIMD conversion of whole images, so
+// every level writes the same bytes.
+inline unsigned char to_byte(float x) {
+    x = x > 0 ? x : 0;
+    x = x < 0.999f ? x : 0.999f;
+    return static_cast<unsigned char>(256 * x);
+}
 
+// The 8-bit value of every component, averaged over the samples.
+inline void color_bytes(color pixel_color, int samples_per_pixel, unsigned char out[3]) {
     // Divide the color by the number of samples.
-    auto scale = 1.0 / samples_per_pixel;
-    r *= scale;
-    g *= scale;
-    b *= scale;
-
-    // Write the translated [0,255] value of each color component.
-    out << static_cast<int>(256 * clamp(r, 0.0, 0.999)) << ' '
-        << static_cast<int>(256 * clamp(g, 0.0, 0.999)) << ' '
-        << static_cast<int>(256 * clamp(b, 0.0, 0.999)) << '\n';
+    float scale = 1.0f / samples_per_pixel;
+
+    // The translated [0,255] value of each color component.
+    out[0] = to_byte(static_cast<float>(pixel_color.x()) * scale);
+    out[1] = to_byte(static_cast<float>(pixel_color.y()) * scale);
+    out[2] = to_byte(static_cast<float>(pixel_color.z()) * scale);
+}
+
+// One ASCII P3 pixel. The renderers write whole images through image.h instead.
+void write_color(std::ostream &out, color pixel_color, int samples_per_pixel) {
+    unsigned char rgb[3];
+    color_bytes(pixel_color, samples_per_pixel, rgb);
+    out << static_cast<int>(rgb[0]) << ' '
+        << static_cast<int>(rgb[1]) << ' '
+        << static_cast<int>(rgb[2]) << '\n';
 }
 
 #endif /* color_h */
@@ -0,0 +1,162 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef counters_h
+#define counters_h
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Build with -DRT_COUNTERS=1 to count what the renderer spends its time on.
+// Otherwise RT_COUNT drops its statement and nothing is counted or stored.
+#ifndef RT_COUNTERS
+#define RT_COUNTERS 0
+#endif
+
+#if RT_COUNTERS
+#define RT_COUNT(statement) do { statement; } while (0)
+#else
+#define RT_COUNT(statement) do {} while (0)
+#endif
+
+
+// What the tracing of one thread, or of all of them summed, did.
+struct render_counters {
+    // The first kinds are those of primitive_ref, in its order.
+    enum primitive_type {
+        sphere_test, sphere_set_test, xy_rect_test, xz_rect_test, yz_rect_test, box_test, other_test,
+        triangle_test, primitive_types
+    };
+    enum material_type { lambertian_scatter, metal_scatter, dielectric_scatter, material_types };
+    static const int depths = 65;   // the last also counts deeper rays
+
+    uint64_t box_tests = 0;         // BVH boxes tested, once per ray tested
+    uint64_t primitive_tests[primitive_types] = {};
+    uint64_t scatters[material_types] = {};
+    uint64_t rays_at_depth[depths] = {};
+
+    // The work of finding hits, in box and primitive tests.
+    uint64_t traversal_cost() const {
+        uint64_t cost = box_tests;
+        for (uint64_t n : primitive_tests)
+            cost += n;
+        return cost;
+    }
+
+    render_counters& operator+=(const render_counters& c) {
+        box_tests += c.box_tests;
+        for (int k = 0; k < primitive_types; k++)
+            primitive_tests[k] += c.primitive_tests[k];
+        for (int k = 0; k < material_types; k++)
+            scatters[k] += c.scatters[k];
+        for (int k = 0; k < depths; k++)
+            rays_at_depth[k] += c.rays_at_depth[k];
+        return *this;
+    }
+};
+
+
+#if RT_COUNTERS
+// The counters of every thread that has counted anything. A thread only ever
+// writes its own, without atomics; they are summed once the tracing is done,
+// and those of threads that have exited are kept summed in retired.
+class counter_registry {
+    public:
+        static counter_registry& instance() {
+            static counter_registry registry;
+            return registry;
+        }
+
+        void add(const render_counters* c) {
+            std::lock_guard<std::mutex> guard(lock);
+            live.push_back(c);
+        }
+
+        void remove(const render_counters* c) {
+            std::lock_guard<std::mutex> guard(lock);
+            retired += *c;
+            live.erase(std::find(live.begin(), live.end(), c));
+        }
+
+        // Only meaningful while no thread is counting, e.g. after a render.
+        render_counters total() {
+            std::lock_guard<std::mutex> guard(lock);
+            render_counters sum = retired;
+            for (const render_counters* c : live)
+                sum += *c;
+            return sum;
+        }
+
+    private:
+        std::mutex lock;
+        std::vector<const render_counters*> live;
+        render_counters retired;
+};
+
+struct thread_counter_slot {
+    render_counters counters;
+    thread_counter_slot() { counter_registry::instance().add(&counters); }
+    ~thread_counter_slot() { counter_registry::instance().remove(&counters); }
+};
+
+// The counters of the calling thread.
+inline render_counters& thread_counters() {
+    thread_local thread_counter_slot slot;
+    return slot.counters;
+}
+#endif
+
+// The sum over all threads; all zero when counting is compiled out.
+inline render_counters merged_counters() {
+#if RT_COUNTERS
+    return counter_registry::instance().total();
+#else
+    return render_counters();
+#endif
+}
+
+
+inline std::ostream& operator<<(std::ostream& out, const render_counters& c) {
+    static const char* primitive_names[] = {
+        "sphere", "sphere_set", "xy_rect", "xz_rect", "yz_rect", "box", "other", "triangle"
+    };
+    static const char* material_names[] = { "lambertian", "metal", "dielectric" };
+
+    uint64_t rays = 0;
+    for (uint64_t n : c.rays_at_depth)
+        rays += n;
+    double per_ray = 1.0 / std::max<uint64_t>(rays, 1);
+
+    out << "Counters over " << rays << " rays:\n"
+        << "  box tests: " << c.box_tests << " (" << c.box_tests * per_ray << " per ray)\n"
+        << "  primitive tests:";
+    for (int k = 0; k < render_counters::primitive_types; k++)
+        if (c.primitive_tests[k])
+            out << ' ' << primitive_names[k] << ' ' << c.primitive_tests[k];
+    out << " (" << (c.traversal_cost() - c.box_tests) * per_ray << " per ray)\n"
+        << "  scatters:";
+    for (int k = 0; k < render_counters::material_types; k++)
+        if (c.scatters[k])
+            out << ' ' << material_names[k] << ' ' << c.scatters[k];
+
+    // Rays by depth, one row each for 0-4, then doubling ranges like path_histogram.
+    out << "\n  rays by depth:";
+    for (int lo = 0; lo < render_counters::depths; ) {
+        int hi = lo < 5 ? lo : std::min(2 * lo - 2, render_counters::depths - 1);
+        uint64_t n = 0;
+        for (int d = lo; d <= hi; d++)
+            n += c.rays_at_depth[d];
+        if (n)
+            out << ' ' << (lo == hi ? std::to_string(lo) : std::to_string(lo) + "-" + std::to_string(hi)) << ": " << n;
+        lo = hi + 1;
+    }
+    return out << '\n';
+}
+
+
+#endif /* counters_h */
@@ -6,11 +6,13 @@
 #define hittable_h
 
 #include "ray.h"
+#include "aabb.h"
 #include "material.h"
 
 class hittable {
     public:
         virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const = 0;
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const = 0;
 };
 
 #endif /* hittable_h */
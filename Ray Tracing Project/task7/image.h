@@ -0,0 +1,276 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef image_h
+#define image_h
+
+#include "color.h"
+#include "isa.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+// Linear RGB framebuffer in floats, three per pixel, stored row-major with row 0
+// at the bottom of the image. The writers divide the pixels by samples_per_pixel,
+// like write_color, so an image of averaged colors is written with 1.
+struct float_image {
+    int width = 0;
+    int height = 0;
+    std::vector<float> rgb;
+
+    float_image() {}
+    float_image(int w, int h) : width(w), height(h), rgb(static_cast<size_t>(w) * h * 3, 0.0f) {}
+
+    void set(int i, int j, const color& c) {
+        float* p = &rgb[(static_cast<size_t>(j) * width + i) * 3];
+        p[0] = static_cast<float>(c.x());
+        p[1] = static_cast<float>(c.y());
+        p[2] = static_cast<float>(c.z());
+    }
+
+    color get(int i, int j) const {
+        const float* p = &rgb[(static_cast<size_t>(j) * width + i) * 3];
+        return color(p[0], p[1], p[2]);
+    }
+};
+
+
+// Framebuffer values to 8-bit ones, n at a time: to_byte of value * scale for
+// each. The SIMD versions take 16 values per step and leave the rest to to_byte.
+inline void to_bytes(isa_tag<isa_scalar>, const float* in, size_t n, float scale, unsigned char* out) {
+    for (size_t k = 0; k < n; k++)
+        out[k] = to_byte(in[k] * scale);
+}
+
+#if RT_X86_SIMD
+// maxps and minps return their second operand for NaN, as to_byte's compares do.
+inline void to_bytes(isa_tag<isa_sse2>, const float* in, size_t n, float scale, unsigned char* out) {
+    const __m128 vscale = _mm_set1_ps(scale), zero = _mm_setzero_ps();
+    const __m128 top = _mm_set1_ps(0.999f), bytes = _mm_set1_ps(256);
+    size_t k = 0;
+    for (; k + 16 <= n; k += 16) {
+        __m128i v[4];
+        for (int q = 0; q < 4; q++) {
+            __m128 x = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + k + 4*q), vscale), zero), top);
+            v[q] = _mm_cvttps_epi32(_mm_mul_ps(x, bytes));
+        }
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(v[0], v[1]), _mm_packs_epi32(v[2], v[3]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k), packed);
+    }
+    to_bytes(isa_tag<isa_scalar>(), in + k, n - k, scale, out + k);
+}
+
+RT_TARGET_AVX2
+inline void to_bytes(isa_tag<isa_avx2>, const float* in, size_t n, float scale, unsigned char* out) {
+    const __m256 vscale = _mm256_set1_ps(scale), zero = _mm256_setzero_ps();
+    const __m256 top = _mm256_set1_ps(0.999f), bytes = _mm256_set1_ps(256);
+    size_t k = 0;
+    for (; k + 16 <= n; k += 16) {
+        __m256i v[2];
+        for (int q = 0; q < 2; q++) {
+            __m256 x = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(in + k + 8*q), vscale), zero), top);
+            v[q] = _mm256_cvttps_epi32(_mm256_mul_ps(x, bytes));
+        }
+        // packs works within 128-bit halves; the permute puts the 16 values back in order.
+        __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(v[0], v[1]), 0xd8);
+        __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k), packed);
+    }
+    to_bytes(isa_tag<isa_scalar>(), in + k, n - k, scale, out + k);
+}
+
+RT_TARGET_AVX512
+inline void to_bytes(isa_tag<isa_avx512>, const float* in, size_t n, float scale, unsigned char* out) {
+    const __m512 vscale = _mm512_set1_ps(scale), zero = _mm512_setzero_ps();
+    const __m512 top = _mm512_set1_ps(0.999f), bytes = _mm512_set1_ps(256);
+    size_t k = 0;
+    for (; k + 16 <= n; k += 16) {
+        __m512 x = _mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(_mm512_loadu_ps(in + k), vscale), zero), top);
+        __m128i packed = _mm512_cvtepi32_epi8(_mm512_cvttps_epi32(_mm512_mul_ps(x, bytes)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k), packed);
+    }
+    to_bytes(isa_tag<isa_scalar>(), in + k, n - k, scale, out + k);
+}
+#endif
+
+// The 8-bit image top row first, as PPM and PNG want it.
+inline std::vector<unsigned char> image_bytes(const float_image& image, int samples_per_pixel) {
+    std::vector<unsigned char> bytes(static_cast<size_t>(image.width) * image.height * 3);
+    const size_t row = static_cast<size_t>(image.width) * 3;
+    const float scale = 1.0f / samples_per_pixel;
+    dispatch_isa([&](auto isa) {
+        unsigned char* out = bytes.data();
+        for (int j = image.height-1; j >= 0; --j, out += row)
+            to_bytes(isa, image.rgb.data() + j * row, row, scale, out);
+    });
+    return bytes;
+}
+
+
+// Every writer builds the whole file in memory and hands it to one fwrite.
+inline bool write_file(const std::string& path, const std::vector<unsigned char>& data) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+inline void append(std::vector<unsigned char>& data, const std::string& text) {
+    data.insert(data.end(), text.begin(), text.end());
+}
+
+
+// Binary PPM (P6): same pixels as the P3 files, a third of the size.
+bool write_ppm(const std::string& path, const float_image& image, int samples_per_pixel) {
+    std::vector<unsigned char> data;
+    append(data, "P6\n" + std::to_string(image.width) + ' ' + std::to_string(image.height) + "\n255\n");
+    auto pixels = image_bytes(image, samples_per_pixel);
+    data.insert(data.end(), pixels.begin(), pixels.end());
+    return write_file(path, data);
+}
+
+
+// Portable float map: the linear averaged radiance, unclamped, for HDR tools.
+// PFM stores rows bottom to top, the framebuffer order; the negative scale marks
+// little-endian floats.
+bool write_pfm(const std::string& path, const float_image& image, int samples_per_pixel) {
+    std::vector<unsigned char> data;
+    append(data, "PF\n" + std::to_string(image.width) + ' ' + std::to_string(image.height) + "\n-1.0\n");
+
+    size_t header = data.size();
+    data.resize(header + image.rgb.size() * sizeof(float));
+    float scale = 1.0f / samples_per_pixel;
+    for (size_t k = 0; k < image.rgb.size(); k++) {
+        float value = image.rgb[k] * scale;
+        std::memcpy(&data[header + k * sizeof(float)], &value, sizeof(float));
+    }
+    return write_file(path, data);
+}
+
+
+// Root mean square difference of two images of the same size, over every channel.
+inline double rms_error(const float_image& a, const float_image& b) {
+    double sum = 0;
+    for (size_t k = 0; k < a.rgb.size(); k++)
+        sum += (a.rgb[k] - b.rgb[k]) * (a.rgb[k] - b.rgb[k]);
+    return std::sqrt(sum / a.rgb.size());
+}
+
+// Reads back a PFM as write_pfm writes it, little-endian RGB; other maps fail.
+bool read_pfm(const std::string& path, float_image& image) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    int width = 0, height = 0;
+    float scale = 0;
+    bool ok = std::fscanf(file, "PF %d %d %f", &width, &height, &scale) == 3 && width > 0 && height > 0
+              && scale < 0 && std::fgetc(file) == '\n';
+    if (ok) {
+        image = float_image(width, height);
+        ok = std::fread(image.rgb.data(), sizeof(float), image.rgb.size(), file) == image.rgb.size();
+    }
+    std::fclose(file);
+    return ok;
+}
+
+
+inline uint32_t png_crc(const unsigned char* data, size_t length, uint32_t crc = 0xffffffffu) {
+    static const auto table = [] {
+        std::array<uint32_t, 256> t;
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+    for (size_t k = 0; k < length; k++)
+        crc = table[(crc ^ data[k]) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+inline void append_u32(std::vector<unsigned char>& data, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8)
+        data.push_back(static_cast<unsigned char>(value >> shift));
+}
+
+inline void append_png_chunk(std::vector<unsigned char>& data, const char* type,
+                             const std::vector<unsigned char>& body) {
+    append_u32(data, static_cast<uint32_t>(body.size()));
+    size_t start = data.size();
+    data.insert(data.end(), type, type + 4);
+    data.insert(data.end(), body.begin(), body.end());
+    append_u32(data, png_crc(&data[start], data.size() - start) ^ 0xffffffffu);
+}
+
+// 8-bit RGB PNG. The zlib stream uses stored (uncompressed) deflate blocks, which
+// keeps the writer free of dependencies; the file is about the size of a P6.
+bool write_png(const std::string& path, const float_image& image, int samples_per_pixel) {
+    auto pixels = image_bytes(image, samples_per_pixel);
+    size_t row_size = static_cast<size_t>(image.width) * 3;
+
+    // Every scanline starts with filter type 0 (none).
+    std::vector<unsigned char> raw;
+    raw.reserve((row_size + 1) * image.height);
+    for (int row = 0; row < image.height; row++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), pixels.begin() + row * row_size, pixels.begin() + (row + 1) * row_size);
+    }
+
+    std::vector<unsigned char> zlib = { 0x78, 0x01 };
+    const size_t max_block = 65535;
+    for (size_t pos = 0; pos < raw.size() || pos == 0; pos += max_block) {
+        size_t length = std::min(max_block, raw.size() - pos);
+        zlib.push_back(pos + length == raw.size() ? 1 : 0);
+        zlib.push_back(static_cast<unsigned char>(length));
+        zlib.push_back(static_cast<unsigned char>(length >> 8));
+        zlib.push_back(static_cast<unsigned char>(~length));
+        zlib.push_back(static_cast<unsigned char>(~length >> 8));
+        zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + length);
+    }
+
+    uint32_t a = 1, b = 0;
+    for (unsigned char c : raw) {
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+    }
+    append_u32(zlib, (b << 16) | a);
+
+    std::vector<unsigned char> ihdr;
+    append_u32(ihdr, static_cast<uint32_t>(image.width));
+    append_u32(ihdr, static_cast<uint32_t>(image.height));
+    ihdr.insert(ihdr.end(), { 8, 2, 0, 0, 0 });   // 8 bits, RGB, deflate, no filter, no interlace
+
+    std::vector<unsigned char> data = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    append_png_chunk(data, "IHDR", ihdr);
+    append_png_chunk(data, "IDAT", zlib);
+    append_png_chunk(data, "IEND", {});
+    return write_file(path, data);
+}
+
+
+// Picks the format from the extension: .pfm, .png, anything else is P6.
+bool write_image(const std::string& path, const float_image& image, int samples_per_pixel) {
+    auto ends_with = [&](const char* suffix) {
+        std::string s(suffix);
+        return path.size() >= s.size() && path.compare(path.size() - s.size(), s.size(), s) == 0;
+    };
+
+    if (ends_with(".pfm"))
+        return write_pfm(path, image, samples_per_pixel);
+    if (ends_with(".png"))
+        return write_png(path, image, samples_per_pixel);
+    return write_ppm(path, image, samples_per_pixel);
+}
+
+#endif /* image_h */
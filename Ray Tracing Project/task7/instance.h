@@ -0,0 +1,243 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef instance_h
+#define instance_h
+
+#include "hittable_list.h"
+#include "wide_bvh.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+// Affine map p -> A p + b, stored as a 3x4 matrix: the rows of A with b in the
+// last column. Points take the translation, vectors do not.
+struct affine_transform {
+    double m[3][4];
+
+    static affine_transform identity() {
+        affine_transform t;
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 4; j++)
+                t.m[i][j] = i == j ? 1 : 0;
+        return t;
+    }
+
+    static affine_transform translation(const vec3& offset) {
+        auto t = identity();
+        for (int i = 0; i < 3; i++)
+            t.m[i][3] = offset[i];
+        return t;
+    }
+
+    static affine_transform scaling(const vec3& factors) {
+        auto t = identity();
+        for (int i = 0; i < 3; i++)
+            t.m[i][i] = factors[i];
+        return t;
+    }
+
+    // Counterclockwise about axis, looking down it, by Rodrigues' formula.
+    static affine_transform rotation(const vec3& axis, double degrees) {
+        vec3 k = unit_vector(axis);
+        double radians = degrees * 3.1415926535897932385 / 180;
+        double c = std::cos(radians), s = std::sin(radians), one_c = 1 - c;
+        auto t = identity();
+        t.m[0][0] = c + k.x()*k.x()*one_c;         t.m[0][1] = k.x()*k.y()*one_c - k.z()*s; t.m[0][2] = k.x()*k.z()*one_c + k.y()*s;
+        t.m[1][0] = k.y()*k.x()*one_c + k.z()*s;   t.m[1][1] = c + k.y()*k.y()*one_c;       t.m[1][2] = k.y()*k.z()*one_c - k.x()*s;
+        t.m[2][0] = k.z()*k.x()*one_c - k.y()*s;   t.m[2][1] = k.z()*k.y()*one_c + k.x()*s; t.m[2][2] = c + k.z()*k.z()*one_c;
+        return t;
+    }
+
+    point3 point(const point3& p) const {
+        return point3(m[0][0]*p.x() + m[0][1]*p.y() + m[0][2]*p.z() + m[0][3],
+                      m[1][0]*p.x() + m[1][1]*p.y() + m[1][2]*p.z() + m[1][3],
+                      m[2][0]*p.x() + m[2][1]*p.y() + m[2][2]*p.z() + m[2][3]);
+    }
+
+    vec3 vector(const vec3& v) const {
+        return vec3(m[0][0]*v.x() + m[0][1]*v.y() + m[0][2]*v.z(),
+                    m[1][0]*v.x() + m[1][1]*v.y() + m[1][2]*v.z(),
+                    m[2][0]*v.x() + m[2][1]*v.y() + m[2][2]*v.z());
+    }
+
+    // Multiplies by the transpose of the linear part. On the inverse map this
+    // carries normals from object to world space.
+    vec3 transposed_vector(const vec3& v) const {
+        return vec3(m[0][0]*v.x() + m[1][0]*v.y() + m[2][0]*v.z(),
+                    m[0][1]*v.x() + m[1][1]*v.y() + m[2][1]*v.z(),
+                    m[0][2]*v.x() + m[1][2]*v.y() + m[2][2]*v.z());
+    }
+
+    // Bound on the rounding error of any coordinate of point(p).
+    double point_error(const point3& p) const {
+        double bound = 0;
+        for (int i = 0; i < 3; i++)
+            bound = std::fmax(bound, std::fabs(m[i][0]*p.x()) + std::fabs(m[i][1]*p.y()) + std::fabs(m[i][2]*p.z())
+                                     + std::fabs(m[i][3]));
+        return rounding_error<real>(3) * bound;
+    }
+
+    // How much the map can stretch an error bounding each coordinate.
+    double error_scale() const {
+        double scale = 0;
+        for (int i = 0; i < 3; i++)
+            scale = std::fmax(scale, std::fabs(m[i][0]) + std::fabs(m[i][1]) + std::fabs(m[i][2]));
+        return scale;
+    }
+
+    affine_transform inverse() const;
+};
+
+// a * b applies b first.
+inline affine_transform operator*(const affine_transform& a, const affine_transform& b) {
+    affine_transform t;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 4; j++) {
+            t.m[i][j] = a.m[i][0]*b.m[0][j] + a.m[i][1]*b.m[1][j] + a.m[i][2]*b.m[2][j];
+            if (j == 3)
+                t.m[i][j] += a.m[i][3];
+        }
+    }
+    return t;
+}
+
+inline affine_transform affine_transform::inverse() const {
+    // Inverse of the linear part by cofactors, then b' = -A^-1 b.
+    const auto& a = m;
+    double c00 = a[1][1]*a[2][2] - a[1][2]*a[2][1];
+    double c01 = a[1][2]*a[2][0] - a[1][0]*a[2][2];
+    double c02 = a[1][0]*a[2][1] - a[1][1]*a[2][0];
+    double inv_det = 1 / (a[0][0]*c00 + a[0][1]*c01 + a[0][2]*c02);
+
+    affine_transform t;
+    t.m[0][0] = c00 * inv_det;
+    t.m[0][1] = (a[0][2]*a[2][1] - a[0][1]*a[2][2]) * inv_det;
+    t.m[0][2] = (a[0][1]*a[1][2] - a[0][2]*a[1][1]) * inv_det;
+    t.m[1][0] = c01 * inv_det;
+    t.m[1][1] = (a[0][0]*a[2][2] - a[0][2]*a[2][0]) * inv_det;
+    t.m[1][2] = (a[0][2]*a[1][0] - a[0][0]*a[1][2]) * inv_det;
+    t.m[2][0] = c02 * inv_det;
+    t.m[2][1] = (a[0][1]*a[2][0] - a[0][0]*a[2][1]) * inv_det;
+    t.m[2][2] = (a[0][0]*a[1][1] - a[0][1]*a[1][0]) * inv_det;
+    for (int i = 0; i < 3; i++)
+        t.m[i][3] = -(t.m[i][0]*a[0][3] + t.m[i][1]*a[1][3] + t.m[i][2]*a[2][3]);
+    return t;
+}
+
+
+// One placement of shared geometry. The ray is taken into object space and the
+// hit back out; the direction is not renormalized, so t means the same in both.
+// Only the transform, its inverse and the world box are per copy.
+class instance : public hittable {
+    public:
+        instance() {}
+        instance(shared_ptr<hittable> object, const affine_transform& to_world)
+            : object(object) { set_transform(to_world); }
+
+        void set_transform(const affine_transform& t);
+
+        virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
+
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override {
+            output_box = world_box;
+            return has_box;
+        }
+
+    public:
+        shared_ptr<hittable> object;
+        affine_transform to_world;
+        affine_transform to_object;     // cached inverse of to_world
+        aabb world_box;
+        bool has_box = false;
+};
+
+void instance::set_transform(const affine_transform& t) {
+    to_world = t;
+    to_object = t.inverse();
+
+    // The world box bounds the eight transformed corners of the object box.
+    aabb object_box;
+    has_box = object->bounding_box(0, 1, object_box);
+    if (!has_box)
+        return;
+    point3 lo(INFINITY, INFINITY, INFINITY), hi(-INFINITY, -INFINITY, -INFINITY);
+    for (int corner = 0; corner < 8; corner++) {
+        point3 p(corner & 1 ? object_box.max().x() : object_box.min().x(),
+                 corner & 2 ? object_box.max().y() : object_box.min().y(),
+                 corner & 4 ? object_box.max().z() : object_box.min().z());
+        p = to_world.point(p);
+        for (int a = 0; a < 3; a++) {
+            lo[a] = fmin(lo[a], p[a]);
+            hi[a] = fmax(hi[a], p[a]);
+        }
+    }
+    world_box = aabb(lo, hi);
+}
+
+bool instance::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+    ray local(to_object.point(r.origin()), to_object.vector(r.direction()));
+    if (!object->hit(local, t_min, t_max, rec))
+        return false;
+
+    // Normals go out through the inverse transpose, which keeps them facing the
+    // ray, so front_face carries over. The error of p grows by the rounding of the
+    // transform, and once more by that of taking a ray from p back into object
+    // space.
+    point3 p = to_world.point(rec.p);
+    rec.error = static_cast<real>(to_world.error_scale() * (rec.error + to_object.point_error(p))
+                                  + to_world.point_error(rec.p));
+    rec.p = p;
+    rec.normal = unit_vector(to_object.transposed_vector(rec.normal));
+    return true;
+}
+
+
+// Two-level acceleration structure. Every distinct piece of geometry gets its own
+// bottom-level wide BVH, built once; instances place it in the world, and a
+// top-level BVH is built over the instance boxes. Moving instances only needs
+// build_top().
+class instanced_scene : public hittable {
+    public:
+        // Builds the bottom-level tree of a piece of geometry and returns its id.
+        uint32_t add_geometry(const hittable_list& objects) {
+            geometries.push_back(make_shared<wide_bvh<4>>(objects, 0, 1));
+            return static_cast<uint32_t>(geometries.size() - 1);
+        }
+
+        uint32_t add_instance(uint32_t geometry, const affine_transform& to_world) {
+            instances.push_back(make_shared<instance>(geometries[geometry], to_world));
+            return static_cast<uint32_t>(instances.size() - 1);
+        }
+
+        void set_transform(uint32_t id, const affine_transform& to_world) {
+            instances[id]->set_transform(to_world);
+        }
+
+        // Rebuilds the top level over the current instance boxes. Call it after
+        // adding or moving instances; the bottom-level trees are left alone.
+        void build_top(bvh_build_stats* stats = nullptr) {
+            hittable_list list;
+            for (const auto& i : instances)
+                list.add(i);
+            top = wide_bvh<4>(list, 0, 1, stats);
+        }
+
+        virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override {
+            return top.hit(r, t_min, t_max, rec);
+        }
+
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override {
+            return top.bounding_box(time0, time1, output_box);
+        }
+
+    public:
+        std::vector<shared_ptr<wide_bvh<4>>> geometries;
+        std::vector<shared_ptr<instance>> instances;
+        wide_bvh<4> top;
+};
+
+#endif /* instance_h */
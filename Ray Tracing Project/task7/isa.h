@@ -0,0 +1,147 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef isa_h
+#define isa_h
+
+#include <string>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define RT_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define RT_X86_SIMD 0
+#endif
+
+
+// The instruction sets the hot kernels are built for, oldest first. One binary
+// carries a copy of the box, sphere and triangle tests and of the framebuffer
+// conversion for every level, and runs the best one the CPU has, so the same
+// build uses AVX-512 where it can and still runs on older nodes. Builds for
+// anything but x86-64 have the scalar level only.
+enum isa_level { isa_scalar, isa_sse2, isa_avx2, isa_avx512 };
+
+inline const char* isa_name(isa_level level) {
+    static const char* names[] = { "scalar", "sse2", "avx2", "avx512" };
+    return names[level];
+}
+
+inline bool parse_isa(const std::string& name, isa_level& level) {
+    for (int k = isa_scalar; k <= isa_avx512; k++)
+        if (name == isa_name(static_cast<isa_level>(k))) {
+            level = static_cast<isa_level>(k);
+            return true;
+        }
+    return false;
+}
+
+
+// The best level this CPU runs, from CPUID. __builtin_cpu_supports also checks
+// that the OS saves the AVX registers. avx512 is the x86-64-v4 set every AVX-512
+// CPU since Skylake-SP has: without VL the compiler's scalar code in the upper
+// sixteen registers runs at half speed.
+inline isa_level detect_isa() {
+#if RT_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")
+        && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq"))
+        return isa_avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return isa_avx2;
+    return isa_sse2;    // part of x86-64
+#else
+    return isa_scalar;
+#endif
+}
+
+struct isa_state {
+    isa_level detected = detect_isa();
+    isa_level active = detected;
+};
+
+inline isa_state& isa_settings() {
+    static isa_state state;
+    return state;
+}
+
+inline isa_level detected_isa() { return isa_settings().detected; }
+inline isa_level active_isa() { return isa_settings().active; }
+
+// Runs the kernels of level from now on, e.g. for --isa; fails when the CPU
+// cannot. Only to be called while nothing is being traced.
+inline bool select_isa(isa_level level) {
+    if (level > detected_isa())
+        return false;
+    isa_settings().active = level;
+    return true;
+}
+
+// For the startup log: the active level, and the detected one when they differ.
+inline std::string isa_description() {
+    std::string text = isa_name(active_isa());
+    if (active_isa() != detected_isa())
+        text += std::string(" (the CPU supports ") + isa_name(detected_isa()) + ")";
+    return text;
+}
+
+
+// The level a kernel is compiled for, as a type. Each tag converts to the tags
+// below it, so a kernel without a version of its own for a level is given the
+// next one down, the way iterator tags pick an algorithm.
+template <isa_level I> struct isa_tag : isa_tag<static_cast<isa_level>(I - 1)> {};
+template <> struct isa_tag<isa_scalar> {};
+
+
+#if RT_X86_SIMD
+// Functions compiled for a level past the x86-64 baseline. GCC turns on FMA with
+// AVX-512 and would then fuse multiplies and adds, which rounds differently: with
+// that off every level computes the same bits as the scalar code, so nodes of a
+// farm render identical images and the triangle test stays watertight. (Clang
+// does not know the attribute; build with -ffp-contract=off there.)
+#if defined(__clang__)
+#define RT_TARGET_AVX2 __attribute__((target("avx2")))
+#define RT_TARGET_AVX512 __attribute__((target("avx2,avx512f,avx512vl,avx512bw,avx512dq")))
+#else
+#define RT_TARGET_AVX2 __attribute__((target("avx2"), optimize("fp-contract=off")))
+#define RT_TARGET_AVX512 __attribute__((target("avx2,avx512f,avx512vl,avx512bw,avx512dq"), optimize("fp-contract=off")))
+#endif
+
+// The copies of a kernel loop for the levels that need a target of their own.
+// flatten inlines everything the loop calls into them, so the whole loop, not
+// only its intrinsics, is compiled for the level.
+template <class F>
+RT_TARGET_AVX2 __attribute__((flatten))
+auto run_avx2(const F& f) -> decltype(f(isa_tag<isa_avx2>())) {
+    return f(isa_tag<isa_avx2>());
+}
+
+// GCC 12 takes the placeholder operand of the AVX-512 intrinsics, which is never
+// read, for an uninitialized variable once they are inlined here.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+template <class F>
+RT_TARGET_AVX512 __attribute__((flatten))
+auto run_avx512(const F& f) -> decltype(f(isa_tag<isa_avx512>())) {
+    return f(isa_tag<isa_avx512>());
+}
+#pragma GCC diagnostic pop
+#endif
+
+// Calls f(isa_tag<level>()) with the active level. f is a generic lambda around
+// a kernel loop, which hands the tag on to the kernels it calls. Dispatching
+// once per loop, e.g. per ray traced through a BVH, keeps the switch out of the
+// box tests.
+template <class F>
+inline auto dispatch_isa(const F& f) -> decltype(f(isa_tag<isa_scalar>())) {
+    switch (active_isa()) {
+#if RT_X86_SIMD
+        case isa_avx512: return run_avx512(f);
+        case isa_avx2:   return run_avx2(f);
+        case isa_sse2:   return f(isa_tag<isa_sse2>());
+#endif
+        default:         return f(isa_tag<isa_scalar>());
+    }
+}
+
+#endif /* isa_h */
@@ -0,0 +1,209 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef linear_bvh_h
+#define linear_bvh_h
+
+#include "bvh.h"
+#include "bvh_builder.h"
+#include "counters.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+// 32-byte node of the flattened tree. Nodes are stored depth-first, so the first
+// child of an interior node always sits right after it and only the second child
+// needs an offset. Bounds are floats rounded outwards, so they stay conservative.
+struct linear_bvh_node {
+    float bounds_min[3];
+    float bounds_max[3];
+    uint32_t offset;    // leaf: first primitive, interior: index of the second child
+    uint16_t count;     // primitives in a leaf, 0 for an interior node
+    uint8_t axis;       // split axis of an interior node
+    uint8_t pad;
+};
+
+static_assert(sizeof(linear_bvh_node) == 32, "linear_bvh_node must stay 32 bytes");
+
+
+// Binned SAH or LBVH tree, as bvh_builder makes it, compacted into one array and
+// traversed with an explicit stack.
+class linear_bvh : public hittable {
+    public:
+        linear_bvh() {}
+        linear_bvh(const hittable_list& list, double time0, double time1,
+                   bvh_build_stats* stats = nullptr, const bvh_build_options& build = bvh_build_options());
+        // Builds over primitives prepared by the caller, reordering them.
+        explicit linear_bvh(std::vector<bvh_primitive>& primitives,
+                            bvh_build_stats* stats = nullptr, const bvh_build_options& build = bvh_build_options());
+
+        virtual bool hit(
+            const ray& r, double t_min, double t_max, hit_record& rec) const override;
+
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
+
+    public:
+        std::vector<linear_bvh_node> nodes;
+        std::vector<shared_ptr<hittable>> objects;  // in leaf order, keeps them alive
+        std::vector<const hittable*> leaf_objects;  // same order, what traversal reads
+        std::vector<uint32_t> leaf_indices;         // same order, the primitives' bvh_primitive::index
+
+        static const int max_leaf_size = 4;
+        static const int max_depth = 64;
+
+    private:
+        void build_all(std::vector<bvh_primitive>& primitives, const bvh_build_options& build,
+                       std::chrono::steady_clock::time_point start_time, bvh_build_stats* stats);
+        uint32_t lay_out(const bvh_builder& tree, uint32_t index, bvh_build_stats& stats);
+};
+
+
+inline void set_node_bounds(linear_bvh_node& node, const aabb& box) {
+    for (int a = 0; a < 3; a++) {
+        node.bounds_min[a] = std::nextafter(static_cast<float>(box.min()[a]), -INFINITY);
+        node.bounds_max[a] = std::nextafter(static_cast<float>(box.max()[a]), INFINITY);
+    }
+}
+
+
+linear_bvh::linear_bvh(const hittable_list& list, double time0, double time1, bvh_build_stats* stats,
+                       const bvh_build_options& build) {
+    auto start_time = std::chrono::steady_clock::now();
+    auto primitives = bvh_primitives(list, time0, time1, build.pool);
+    build_all(primitives, build, start_time, stats);
+}
+
+linear_bvh::linear_bvh(std::vector<bvh_primitive>& primitives, bvh_build_stats* stats,
+                       const bvh_build_options& build) {
+    build_all(primitives, build, std::chrono::steady_clock::now(), stats);
+}
+
+
+void linear_bvh::build_all(std::vector<bvh_primitive>& primitives, const bvh_build_options& build,
+                           std::chrono::steady_clock::time_point start_time, bvh_build_stats* stats) {
+    bvh_build_stats local_stats;
+    local_stats.primitive_count = primitives.size();
+    if (!primitives.empty()) {
+        bvh_builder tree(primitives, build, max_leaf_size, max_depth);
+        nodes.reserve(tree.nodes.size());
+        lay_out(tree, 0, local_stats);
+    }
+
+    // The builder leaves the primitives in leaf order.
+    leaf_indices.reserve(primitives.size());
+    for (const auto& p : primitives) {
+        leaf_indices.push_back(p.index);
+        if (p.object)
+            objects.push_back(p.object);
+    }
+    for (const auto& object : objects)
+        leaf_objects.push_back(object.get());
+
+    aabb root;
+    if (bounding_box(0, 0, root))
+        local_stats.sah_cost /= root.area();
+    local_stats.build_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    if (stats)
+        *stats = local_stats;
+}
+
+
+// Copies the subtree at index depth first, the first child right after its parent.
+uint32_t linear_bvh::lay_out(const bvh_builder& tree, uint32_t index, bvh_build_stats& stats) {
+    const bvh_build_node& built = tree.nodes[index];
+    auto at = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+    stats.node_count++;
+    set_node_bounds(nodes[at], built.box);
+
+    if (!built.left) {
+        size_t span = built.end - built.start;
+        nodes[at].offset = built.start;
+        nodes[at].count = static_cast<uint16_t>(span);
+        stats.leaf_count++;
+        stats.sah_cost += span * built.box.area() * bvh_intersection_cost;
+        return at;
+    }
+
+    stats.sah_cost += built.box.area() * bvh_traversal_cost;
+    lay_out(tree, built.left, stats);
+    uint32_t second = lay_out(tree, built.left + 1, stats);
+
+    nodes[at].offset = second;
+    nodes[at].count = 0;
+    nodes[at].axis = built.axis;
+    return at;
+}
+
+
+bool linear_bvh::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+    if (nodes.empty())
+        return false;
+
+    const point3 origin = r.origin();
+    const vec3 inv_dir(1 / r.direction().x(), 1 / r.direction().y(), 1 / r.direction().z());
+    const bool dir_is_neg[3] = { inv_dir.x() < 0, inv_dir.y() < 0, inv_dir.z() < 0 };
+
+    uint32_t stack[max_depth];
+    int stack_size = 0;
+    uint32_t current = 0;
+    bool hit_anything = false;
+
+    while (true) {
+        const linear_bvh_node& node = nodes[current];
+
+        // Slab test against the node box, using the closest hit found so far.
+        RT_COUNT(thread_counters().box_tests++);
+        double t0 = t_min, t1 = t_max;
+        for (int a = 0; a < 3 && t0 <= t1; a++) {
+            double near = ((dir_is_neg[a] ? node.bounds_max[a] : node.bounds_min[a]) - origin[a]) * inv_dir[a];
+            double far  = ((dir_is_neg[a] ? node.bounds_min[a] : node.bounds_max[a]) - origin[a]) * inv_dir[a];
+            t0 = near > t0 ? near : t0;
+            t1 = far < t1 ? far : t1;
+        }
+
+        if (t0 <= t1) {
+            if (node.count > 0) {
+                for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                    if (leaf_objects[i]->hit(r, t_min, t_max, rec)) {
+                        hit_anything = true;
+                        t_max = rec.t;
+                    }
+                }
+            } else {
+                // Visit the child on the near side of the split plane first.
+                if (dir_is_neg[node.axis]) {
+                    stack[stack_size++] = current + 1;
+                    current = node.offset;
+                } else {
+                    stack[stack_size++] = node.offset;
+                    current = current + 1;
+                }
+                continue;
+            }
+        }
+
+        if (stack_size == 0)
+            break;
+        current = stack[--stack_size];
+    }
+
+    return hit_anything;
+}
+
+
+bool linear_bvh::bounding_box(double time0, double time1, aabb& output_box) const {
+    if (nodes.empty())
+        return false;
+
+    const auto& root = nodes[0];
+    output_box = aabb(point3(root.bounds_min[0], root.bounds_min[1], root.bounds_min[2]),
+                      point3(root.bounds_max[0], root.bounds_max[1], root.bounds_max[2]));
+    return true;
+}
+
+#endif /* linear_bvh_h */
@@ -2,7 +2,7 @@
 //  Copyright © 2020 melihkurtaran. All rights reserved.
 
 #include <iostream>
-#include <fstream>
+#include <chrono>
 #include "ray.h"
 #include "vec3.h"
 #include "color.h"
@@ -12,100 +12,120 @@
 #include "camera.h"
 #include <cstdlib>
 #include <random>
+#include <limits>
 #include "box.h"
+#include "compiled_scene.h"
+#include "scene_cache.h"
+#include "scene_file.h"
+#include "scenes.h"
+#include "path_tracer.h"
 
 using namespace std;
 
-// Constants
-
-const double INF = numeric_limits<double>::infinity();
-
-color ray_color(const ray& r, const hittable& world, int depth) {
-    hit_record rec;
-    
-
-    // If we've exceeded the ray bounce limit, no more light is gathered.
-    if (depth <= 0)
-        return color(0,0,0);
-
-    if (world.hit(r, 0.001, INF, rec)) {
-        ray scattered;
-        color attenuation;
-        if (rec.mat_ptr->scatter(r, rec, attenuation, scattered))
-            return attenuation * ray_color(scattered, world, depth-1);
-        return color(0,0,0);
-    }
-
-    vec3 unit_direction = unit_vector(r.direction());
-    auto t = 0.5*(unit_direction.y() + 1.0);
-    return (1.0-t)*color(1.0, 1.0, 1.0) + t*color(0.5, 0.7, 1.0);
+// path in single quotes for the shell, each ' in it closed, escaped and reopened.
+std::string shell_quoted(const std::string& path) {
+    std::string quoted = "'";
+    for (char c : path)
+        quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+    return quoted + "'";
 }
 
-hittable_list pyramid() {
-    hittable_list world;
-    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-    world.add(make_shared<box>(point3(-15,-3,-15),point3(15,0,15),ground_material));
+int main(int argc, char* argv[]) {
     
-    for(double k=0.2;k<3;k+=0.4)
-    {
-        for(double i=-3+k;i<3-k;i+=0.4)
-        {
-            for(double j=-3+k;j<3-k;)
-            {
-                j+=0.4;
-                point3 center(i,k,j);
-                auto randomColor = color::random() * color::random();
-                shared_ptr<material> material = make_shared<lambertian>(randomColor);
-                world.add(make_shared<box>(point3(center.x()-0.2,center.y()-0.2,center.z()-0.2),point3(center.x()+0.2,center.y()+0.2,center.z()+0.2),material));
-            }
-        }
+    render_options options = parse_render_options(argc, argv);
+    if (!select_isa(options.isa)) {
+        std::cerr << "This CPU cannot run the " << isa_name(options.isa) << " kernels, only up to "
+                  << isa_name(detected_isa()) << '\n';
+        return 1;
     }
-    
-    
-    return world;
-    
-}
-
-int main() {
-    
-    ofstream img("image.ppm");
+    std::cerr << "Kernels: " << isa_description() << '\n';
 
     // Image
     const auto aspect_ratio = 16.0 / 9.0;
     const int image_width = 400;
     const int image_height = static_cast<int>(image_width / aspect_ratio);
-    const int samples_per_pixel = 100;
     const int max_depth = 50;
     
+    // The pool builds the BVH too, so it comes first.
+    thread_pool pool(options.threads);
+    bvh_build_options build;
+    build.mode = options.bvh;
+    build.pool = &pool;
+
     // World
-    hittable_list world = pyramid();
+    scene sc;
+    camera_settings view;
+    compiled_scene<4> world;
+    auto load_start = std::chrono::steady_clock::now();
+    auto is_cache = [](const std::string& path) {
+        return path.size() > 5 && path.compare(path.size() - 5, 5, ".rtsc") == 0;
+    };
+
+    if (is_cache(options.scene)) {
+        // Already compiled: nothing to parse or build.
+        if (!load_scene_cache(options.scene, view, sc.materials, world))
+            return 1;
+        std::cerr << "Loaded " << options.scene << " in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start).count()
+                  << " ms\n";
+    } else {
+        if (!options.scene.empty()) {
+            if (!load_scene_file(options.scene, sc, view, build))
+                return 1;
+        } else {
+            sc = options.mesh.empty() ? pyramid() : mesh_scene(options.mesh, build);
+        }
+        bvh_build_stats bvh_stats;
+        world = compiled_scene<4>(sc.objects, 0, 1, &bvh_stats, build);
+        std::cerr << bvh_build_name(build.mode) << ' ' << bvh_stats << '\n';
+        if (!options.write_cache.empty() && !write_scene_cache(options.write_cache, view, sc.materials, world))
+            return 1;
+    }
     
     // Camera
-    point3 lookfrom(6,10,12);
-    point3 lookat(0,0,0);
-    vec3 vup(0,1,0);
-
-    camera cam(lookfrom,lookat, vup, 20, aspect_ratio);
+    camera cam(view.lookfrom, view.lookat, view.vup, view.vfov, aspect_ratio);
     
     // Render
-    std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
-    img << "P3\n" << image_width << ' ' << image_height << "\n255\n";
-    
-    for (int j = image_height-1; j >= 0; --j) {
-        std::cerr << "\rScanlines remaining: " << j << ' ' << std::flush;
-        for (int i = 0; i < image_width; ++i) {
-            color pixel_color(0, 0, 0);
-            for (int s = 0; s < samples_per_pixel; ++s) {
-                auto u = (i + random_double()) / (image_width-1);
-                auto v = (j + random_double()) / (image_height-1);
-                ray r = cam.get_ray(u, v);
-                pixel_color += ray_color(r, world, max_depth);
-            }
-//            write_color(cout, pixel_color, samples_per_pixel);
-            write_color(img, pixel_color, samples_per_pixel);
+    std::cerr << "Rendering with " << pool.size() << " threads, "
+              << options.tile_size << "x" << options.tile_size << " tiles, "
+              << sequence_name(options.sampling.sequence) << " samples, "
+              << (RT_FLOAT ? "float" : "double") << " precision\n";
 
-        }
+    std::vector<pixel_statistics> pixels;
+    path_histogram path_lengths;
+
+    auto framebuffer = render_scene(pool, world, sc.materials, cam, image_width, image_height, max_depth,
+                                    options, pixels, path_lengths);
+
+    std::cerr << "\n";
+    long total_samples = 0;
+    for (const auto& stats : pixels)
+        total_samples += stats.count;
+    std::cerr << "Average " << double(total_samples) / pixels.size() << " samples per pixel\n";
+    std::cerr << path_lengths;
+    if (RT_COUNTERS)
+        std::cerr << merged_counters();
+
+    auto write_start = std::chrono::steady_clock::now();
+    if (!write_image(options.output, framebuffer, 1)) {
+        std::cerr << "Could not write " << options.output << '\n';
+        return 1;
+    }
+    std::cerr << "Wrote " << options.output << " in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - write_start).count()
+              << " ms\n";
+    if (!options.heatmap.empty() &&
+        !write_image(options.heatmap, sample_heatmap(pixels, image_width, image_height, options.sampling), 1))
+        std::cerr << "Could not write " << options.heatmap << '\n';
+    if (!options.cost_heatmap.empty()) {
+        if (!RT_COUNTERS)
+            std::cerr << "The cost heatmap needs a build with -DRT_COUNTERS=1\n";
+        else if (!write_image(options.cost_heatmap, cost_heatmap(pixels, image_width, image_height), 1))
+            std::cerr << "Could not write " << options.cost_heatmap << '\n';
     }
-    std::cerr << "\nDone.\n";
-    system("open image.ppm");
+    std::cerr << "Done.\n";
+#ifdef __APPLE__
+    if (options.open)
+        system(("open " + shell_quoted(options.output)).c_str());
+#endif
 }
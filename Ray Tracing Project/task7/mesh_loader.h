@@ -0,0 +1,593 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef mesh_loader_h
+#define mesh_loader_h
+
+#include "triangle_mesh.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+// A whole file mapped read-only into memory. The parsers below walk the mapping
+// with pointers, so nothing is copied or allocated per line.
+class mapped_file {
+    public:
+        explicit mapped_file(const std::string& path) {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return;
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size > 0) {
+                void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    data = static_cast<const char*>(p);
+                    size = static_cast<size_t>(st.st_size);
+                    // Parsing reads front to back.
+                    madvise(p, size, MADV_SEQUENTIAL);
+                }
+            }
+            close(fd);
+        }
+
+        ~mapped_file() {
+            if (data)
+                munmap(const_cast<char*>(data), size);
+        }
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        bool ok() const { return data != nullptr; }
+        const char* begin() const { return data; }
+        const char* end() const { return data + size; }
+
+    private:
+        const char* data = nullptr;
+        size_t size = 0;
+};
+
+
+// Text scanning over [p, end). Every function stops at end, since a mapping has
+// no terminating zero.
+inline void skip_blanks(const char*& p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+}
+
+inline void skip_line(const char*& p, const char* end) {
+    const void* newline = std::memchr(p, '\n', static_cast<size_t>(end - p));
+    p = newline ? static_cast<const char*>(newline) + 1 : end;
+}
+
+inline bool parse_long(const char*& p, const char* end, long& out) {
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+        p++;
+    if (p == end || *p < '0' || *p > '9')
+        return false;
+    long value = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        value = 10 * value + (*p++ - '0');
+    out = negative ? -value : value;
+    return true;
+}
+
+// Decimal with optional fraction and exponent. The digits are gathered as an
+// integer and scaled once: correctly rounded up to 15 significant digits, and
+// within an ulp of a double beyond, which is exact to float precision for
+// anything a mesh file holds.
+inline bool parse_double(const char*& p, const char* end, double& out) {
+    skip_blanks(p, end);
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+        p++;
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (mantissa < 100000000000000000ull) mantissa = 10 * mantissa + (*p - '0');
+        else exponent++;
+        p++; digits++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (mantissa < 100000000000000000ull) { mantissa = 10 * mantissa + (*p - '0'); exponent--; }
+            p++; digits++;
+        }
+    }
+    if (digits == 0)
+        return false;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        long e;
+        if (parse_long(q, end, e)) {
+            exponent += static_cast<int>(e);
+            p = q;
+        }
+    }
+
+    static const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    double value = static_cast<double>(mantissa);
+    if (exponent >= -22 && exponent <= 22)
+        value = exponent < 0 ? value / powers[-exponent] : value * powers[exponent];
+    else
+        value *= std::pow(10.0, exponent);
+    out = negative ? -value : value;
+    return true;
+}
+
+inline bool parse_float(const char*& p, const char* end, float& out) {
+    double value;
+    if (!parse_double(p, end, value))
+        return false;
+    out = static_cast<float>(value);
+    return true;
+}
+
+
+// Wavefront OBJ: v, vt and vn lines and polygonal f lines, fanned into triangles.
+// Faces may index v, v/vt, v//vn or v/vt/vn, counting from 1 or, when negative,
+// back from the last vertex read. A mesh has one index per corner, so normals
+// and uvs are kept only when each vertex gets the same one from every face that
+// uses it; otherwise the mesh falls back to face normals and barycentric uvs.
+bool load_obj(const std::string& path, mesh_data& out) {
+    mapped_file file(path);
+    if (!file.ok()) {
+        std::cerr << "Could not read " << path << '\n';
+        return false;
+    }
+
+    mesh_data mesh;
+    std::vector<float> uvs, normals;
+    std::vector<int32_t> vertex_uv, vertex_normal;     // per vertex, -1 until a face names one
+    bool uvs_per_vertex = true, normals_per_vertex = true;
+    bool any_uv = false, any_normal = false;
+
+    // Resolves an OBJ index, 1-based or relative, against count entries.
+    auto resolve = [](long index, size_t count) -> long {
+        return index < 0 ? static_cast<long>(count) + index : index - 1;
+    };
+
+    auto assign = [](std::vector<int32_t>& per_vertex, uint32_t vertex, long attribute, bool& consistent) {
+        if (per_vertex.size() <= vertex)
+            per_vertex.resize(vertex + 1, -1);
+        if (per_vertex[vertex] < 0)
+            per_vertex[vertex] = static_cast<int32_t>(attribute);
+        else if (per_vertex[vertex] != attribute)
+            consistent = false;
+    };
+
+    const char* p = file.begin();
+    const char* end = file.end();
+    long line = 0;
+    uint32_t corners[3];
+
+    while (p < end) {
+        line++;
+        skip_blanks(p, end);
+        if (p + 1 < end && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            p += 2;
+            float x, y, z;
+            if (!parse_float(p, end, x) || !parse_float(p, end, y) || !parse_float(p, end, z)) {
+                std::cerr << path << ":" << line << ": bad vertex\n";
+                return false;
+            }
+            mesh.positions.push_back(x);
+            mesh.positions.push_back(y);
+            mesh.positions.push_back(z);
+        } else if (p + 2 < end && p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t')) {
+            p += 3;
+            float u, v = 0;
+            if (!parse_float(p, end, u)) {
+                std::cerr << path << ":" << line << ": bad texture coordinate\n";
+                return false;
+            }
+            parse_float(p, end, v);
+            uvs.push_back(u);
+            uvs.push_back(v);
+        } else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+            p += 3;
+            float x, y, z;
+            if (!parse_float(p, end, x) || !parse_float(p, end, y) || !parse_float(p, end, z)) {
+                std::cerr << path << ":" << line << ": bad normal\n";
+                return false;
+            }
+            normals.push_back(x);
+            normals.push_back(y);
+            normals.push_back(z);
+        } else if (p + 1 < end && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            p += 2;
+            int corner = 0;
+            while (true) {
+                skip_blanks(p, end);
+                if (p == end || *p == '\n' || *p == '#')
+                    break;
+
+                long v, vt = 0, vn = 0;
+                bool has_vt = false, has_vn = false;
+                if (!parse_long(p, end, v)) {
+                    std::cerr << path << ":" << line << ": bad face\n";
+                    return false;
+                }
+                if (p < end && *p == '/') {
+                    p++;
+                    has_vt = parse_long(p, end, vt);
+                    if (p < end && *p == '/') {
+                        p++;
+                        has_vn = parse_long(p, end, vn);
+                    }
+                }
+
+                long vertex = resolve(v, mesh.vertex_count());
+                if (vertex < 0 || vertex >= static_cast<long>(mesh.vertex_count())) {
+                    std::cerr << path << ":" << line << ": vertex index out of range\n";
+                    return false;
+                }
+                auto index = static_cast<uint32_t>(vertex);
+
+                if (has_vt) {
+                    any_uv = true;
+                    long uv = resolve(vt, uvs.size() / 2);
+                    if (uv < 0 || uv >= static_cast<long>(uvs.size() / 2))
+                        uvs_per_vertex = false;
+                    else
+                        assign(vertex_uv, index, uv, uvs_per_vertex);
+                } else {
+                    uvs_per_vertex = false;
+                }
+                if (has_vn) {
+                    any_normal = true;
+                    long n = resolve(vn, normals.size() / 3);
+                    if (n < 0 || n >= static_cast<long>(normals.size() / 3))
+                        normals_per_vertex = false;
+                    else
+                        assign(vertex_normal, index, n, normals_per_vertex);
+                } else {
+                    normals_per_vertex = false;
+                }
+
+                // Fan: the first corner, the previous one and this one.
+                if (corner < 2) {
+                    corners[corner] = index;
+                } else {
+                    mesh.indices.push_back(corners[0]);
+                    mesh.indices.push_back(corners[1]);
+                    mesh.indices.push_back(index);
+                    corners[1] = index;
+                }
+                corner++;
+            }
+        }
+        skip_line(p, end);
+    }
+
+    // Attributes moved to the vertices that use them.
+    size_t vertex_count = mesh.vertex_count();
+    if (any_normal && normals_per_vertex) {
+        mesh.normals.assign(3 * vertex_count, 0.0f);
+        for (size_t i = 0; i < vertex_count && i < vertex_normal.size(); i++)
+            if (vertex_normal[i] >= 0)
+                std::memcpy(&mesh.normals[3*i], &normals[3 * vertex_normal[i]], 3 * sizeof(float));
+    }
+    if (any_uv && uvs_per_vertex) {
+        mesh.uvs.assign(2 * vertex_count, 0.0f);
+        for (size_t i = 0; i < vertex_count && i < vertex_uv.size(); i++)
+            if (vertex_uv[i] >= 0)
+                std::memcpy(&mesh.uvs[2*i], &uvs[2 * vertex_uv[i]], 2 * sizeof(float));
+    }
+
+    out = std::move(mesh);
+    return true;
+}
+
+
+// Stanford PLY, binary in either byte order. The vertex element supplies x, y, z
+// and, when present, nx, ny, nz and u, v (or s, t); the face element a list of
+// vertex indices, fanned into triangles. Other elements and properties are
+// skipped.
+namespace ply {
+
+enum scalar_type { int8, uint8, int16, uint16, int32, uint32, float32, float64, unknown };
+
+inline scalar_type type_from_name(const char* name, size_t length) {
+    std::string s(name, length);
+    if (s == "char" || s == "int8") return int8;
+    if (s == "uchar" || s == "uint8") return uint8;
+    if (s == "short" || s == "int16") return int16;
+    if (s == "ushort" || s == "uint16") return uint16;
+    if (s == "int" || s == "int32") return int32;
+    if (s == "uint" || s == "uint32") return uint32;
+    if (s == "float" || s == "float32") return float32;
+    if (s == "double" || s == "float64") return float64;
+    return unknown;
+}
+
+inline int type_size(scalar_type t) {
+    static const int sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8, 0 };
+    return sizes[t];
+}
+
+// Reads one value and converts it to double, swapping bytes for the other order.
+inline double read_scalar(const char* p, scalar_type t, bool swap) {
+    unsigned char bytes[8];
+    int n = type_size(t);
+    for (int i = 0; i < n; i++)
+        bytes[i] = static_cast<unsigned char>(p[swap ? n - 1 - i : i]);
+    switch (t) {
+        case int8:    { int8_t v;   std::memcpy(&v, bytes, 1); return v; }
+        case uint8:   { uint8_t v;  std::memcpy(&v, bytes, 1); return v; }
+        case int16:   { int16_t v;  std::memcpy(&v, bytes, 2); return v; }
+        case uint16:  { uint16_t v; std::memcpy(&v, bytes, 2); return v; }
+        case int32:   { int32_t v;  std::memcpy(&v, bytes, 4); return v; }
+        case uint32:  { uint32_t v; std::memcpy(&v, bytes, 4); return v; }
+        case float32: { float v;    std::memcpy(&v, bytes, 4); return v; }
+        case float64: { double v;   std::memcpy(&v, bytes, 8); return v; }
+        default:      return 0;
+    }
+}
+
+struct property {
+    std::string name;
+    scalar_type type = unknown;         // of the value, or of the list entries
+    scalar_type count_type = unknown;   // of the list length, unknown for a scalar
+};
+
+struct element {
+    std::string name;
+    size_t count = 0;
+    std::vector<property> properties;
+};
+
+// Reads the length of the list property prop at p and steps over it. Returns
+// false, with p left alone, when the length or the list would run past end.
+// Every check compares sizes, so no pointer past end is ever formed.
+inline bool read_list_length(const char*& p, const char* end, const property& prop, bool swap, size_t& n) {
+    int count_size = type_size(prop.count_type);
+    if (end - p < count_size)
+        return false;
+    double length = read_scalar(p, prop.count_type, swap);
+    auto left = static_cast<double>(end - p - count_size);
+    if (!(length >= 0) || length * type_size(prop.type) > left)
+        return false;
+    n = static_cast<size_t>(length);
+    p += count_size;
+    return true;
+}
+
+// Skips one instance of an element, returning false when it runs past end.
+inline bool skip_element(const char*& p, const char* end, const element& e, bool swap) {
+    for (const auto& prop : e.properties) {
+        if (prop.count_type == unknown) {
+            if (end - p < type_size(prop.type))
+                return false;
+            p += type_size(prop.type);
+        } else {
+            size_t n;
+            if (!read_list_length(p, end, prop, swap, n))
+                return false;
+            p += n * type_size(prop.type);
+        }
+    }
+    return true;
+}
+
+} // namespace ply
+
+
+bool load_ply(const std::string& path, mesh_data& out) {
+    mapped_file file(path);
+    if (!file.ok()) {
+        std::cerr << "Could not read " << path << '\n';
+        return false;
+    }
+
+    const char* p = file.begin();
+    const char* end = file.end();
+    if (end - p < 4 || std::memcmp(p, "ply", 3) != 0) {
+        std::cerr << path << ": not a PLY file\n";
+        return false;
+    }
+
+    // The header is text, one keyword per line, up to end_header.
+    std::vector<ply::element> elements;
+    bool swap = false;
+    bool header_done = false;
+    skip_line(p, end);
+    while (p < end && !header_done) {
+        const char* line_end = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (!line_end)
+            line_end = end;
+
+        // Splits the line into at most five words.
+        const char* words[5];
+        size_t lengths[5];
+        int word_count = 0;
+        for (const char* q = p; q < line_end && word_count < 5; ) {
+            while (q < line_end && (*q == ' ' || *q == '\t' || *q == '\r'))
+                q++;
+            const char* start = q;
+            while (q < line_end && *q != ' ' && *q != '\t' && *q != '\r')
+                q++;
+            if (q > start) {
+                words[word_count] = start;
+                lengths[word_count++] = static_cast<size_t>(q - start);
+            }
+        }
+        auto word_is = [&](int i, const char* s) {
+            return i < word_count && lengths[i] == std::strlen(s) && std::memcmp(words[i], s, lengths[i]) == 0;
+        };
+
+        if (word_is(0, "format")) {
+            // The host is taken to be little-endian, so big-endian files are swapped.
+            if (word_is(1, "binary_little_endian")) {
+                swap = false;
+            } else if (word_is(1, "binary_big_endian")) {
+                swap = true;
+            } else {
+                std::cerr << path << ": only binary PLY files are supported\n";
+                return false;
+            }
+        } else if (word_is(0, "element") && word_count >= 3) {
+            ply::element e;
+            e.name.assign(words[1], lengths[1]);
+            e.count = std::strtoul(std::string(words[2], lengths[2]).c_str(), nullptr, 10);
+            elements.push_back(e);
+        } else if (word_is(0, "property") && !elements.empty()) {
+            ply::property prop;
+            if (word_is(1, "list") && word_count >= 5) {
+                prop.count_type = ply::type_from_name(words[2], lengths[2]);
+                prop.type = ply::type_from_name(words[3], lengths[3]);
+                prop.name.assign(words[4], lengths[4]);
+            } else if (word_count >= 3) {
+                prop.type = ply::type_from_name(words[1], lengths[1]);
+                prop.name.assign(words[2], lengths[2]);
+            }
+            if (prop.type == ply::unknown || (word_is(1, "list") && prop.count_type == ply::unknown)) {
+                std::cerr << path << ": unknown property type\n";
+                return false;
+            }
+            elements.back().properties.push_back(prop);
+        } else if (word_is(0, "end_header")) {
+            header_done = true;
+        }
+        p = line_end < end ? line_end + 1 : end;
+    }
+    if (!header_done) {
+        std::cerr << path << ": PLY header has no end_header\n";
+        return false;
+    }
+
+    mesh_data mesh;
+    for (const auto& e : elements) {
+        if (e.name == "vertex") {
+            // Offsets of the wanted properties within a vertex; all are scalars here.
+            int offset[8];
+            ply::scalar_type type[8];
+            const char* names[8][2] = {
+                {"x", "x"}, {"y", "y"}, {"z", "z"}, {"nx", "nx"}, {"ny", "ny"}, {"nz", "nz"}, {"u", "s"}, {"v", "t"}
+            };
+            for (int k = 0; k < 8; k++) offset[k] = -1;
+
+            int stride = 0;
+            bool fixed_size = true;
+            for (const auto& prop : e.properties) {
+                if (prop.count_type != ply::unknown) {
+                    fixed_size = false;
+                    break;
+                }
+                for (int k = 0; k < 8; k++) {
+                    if (prop.name == names[k][0] || prop.name == names[k][1]) {
+                        offset[k] = stride;
+                        type[k] = prop.type;
+                    }
+                }
+                stride += ply::type_size(prop.type);
+            }
+            if (!fixed_size || offset[0] < 0 || offset[1] < 0 || offset[2] < 0) {
+                std::cerr << path << ": vertices need scalar x, y and z\n";
+                return false;
+            }
+            if (e.count > static_cast<size_t>(end - p) / stride) {
+                std::cerr << path << ": file ends inside the vertices\n";
+                return false;
+            }
+
+            bool has_normals = offset[3] >= 0 && offset[4] >= 0 && offset[5] >= 0;
+            bool has_uvs = offset[6] >= 0 && offset[7] >= 0;
+            mesh.positions.resize(3 * e.count);
+            if (has_normals) mesh.normals.resize(3 * e.count);
+            if (has_uvs) mesh.uvs.resize(2 * e.count);
+
+            // Plain little-endian floats, the common case, are copied straight.
+            bool float_positions = !swap && type[0] == ply::float32 && type[1] == ply::float32 && type[2] == ply::float32;
+            for (size_t i = 0; i < e.count; i++, p += stride) {
+                for (int k = 0; k < 3; k++) {
+                    if (float_positions)
+                        std::memcpy(&mesh.positions[3*i + k], p + offset[k], sizeof(float));
+                    else
+                        mesh.positions[3*i + k] = static_cast<float>(ply::read_scalar(p + offset[k], type[k], swap));
+                }
+                if (has_normals)
+                    for (int k = 0; k < 3; k++)
+                        mesh.normals[3*i + k] = static_cast<float>(ply::read_scalar(p + offset[3+k], type[3+k], swap));
+                if (has_uvs)
+                    for (int k = 0; k < 2; k++)
+                        mesh.uvs[2*i + k] = static_cast<float>(ply::read_scalar(p + offset[6+k], type[6+k], swap));
+            }
+        } else if (e.name == "face") {
+            mesh.indices.reserve(mesh.indices.size() + 3 * e.count);
+            for (size_t f = 0; f < e.count; f++) {
+                for (const auto& prop : e.properties) {
+                    if (prop.count_type == ply::unknown) {
+                        if (end - p < ply::type_size(prop.type)) {
+                            std::cerr << path << ": file ends inside the faces\n";
+                            return false;
+                        }
+                        p += ply::type_size(prop.type);
+                        continue;
+                    }
+                    size_t n;
+                    if (!ply::read_list_length(p, end, prop, swap, n)) {
+                        std::cerr << path << ": file ends inside the faces\n";
+                        return false;
+                    }
+                    int size = ply::type_size(prop.type);
+                    if (prop.name == "vertex_indices" || prop.name == "vertex_index") {
+                        for (size_t k = 2; k < n; k++) {
+                            mesh.indices.push_back(static_cast<uint32_t>(ply::read_scalar(p, prop.type, swap)));
+                            mesh.indices.push_back(static_cast<uint32_t>(ply::read_scalar(p + (k-1) * size, prop.type, swap)));
+                            mesh.indices.push_back(static_cast<uint32_t>(ply::read_scalar(p + k * size, prop.type, swap)));
+                        }
+                    }
+                    p += n * size;
+                }
+            }
+        } else {
+            for (size_t i = 0; i < e.count; i++) {
+                if (!ply::skip_element(p, end, e, swap)) {
+                    std::cerr << path << ": file ends inside element " << e.name << '\n';
+                    return false;
+                }
+            }
+        }
+    }
+
+    out = std::move(mesh);
+    return true;
+}
+
+
+// Loads an .obj or .ply file, by extension.
+bool load_mesh(const std::string& path, mesh_data& out) {
+    auto dot = path.find_last_of('.');
+    std::string extension = dot == std::string::npos ? "" : path.substr(dot + 1);
+    for (auto& c : extension)
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+
+    if (extension == "obj")
+        return load_obj(path, out);
+    if (extension == "ply")
+        return load_ply(path, out);
+    std::cerr << path << ": unknown mesh format, expected .obj or .ply\n";
+    return false;
+}
+
+#endif /* mesh_loader_h */
@@ -0,0 +1,39 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef onb_h
+#define onb_h
+
+#include "vec3.h"
+
+#include <cmath>
+
+
+// Orthonormal basis around a unit vector w, for drawing directions in a frame
+// where w is up. Built without branches or normalizing (Duff et al. 2017).
+class onb {
+    public:
+        explicit onb(const vec3& n) {
+            double sign = std::copysign(1.0, n.z());
+            double a = -1 / (sign + n.z());
+            double b = n.x() * n.y() * a;
+            axis[0] = vec3(1 + sign * n.x() * n.x() * a, sign * b, -sign * n.x());
+            axis[1] = vec3(b, sign + n.y() * n.y() * a, -n.y());
+            axis[2] = n;
+        }
+
+        const vec3& u() const { return axis[0]; }
+        const vec3& v() const { return axis[1]; }
+        const vec3& w() const { return axis[2]; }
+
+        // From local coordinates to world ones, and back.
+        vec3 local(double a, double b, double c) const { return a*u() + b*v() + c*w(); }
+        vec3 local(const vec3& a) const { return local(a.x(), a.y(), a.z()); }
+        vec3 to_local(const vec3& a) const { return vec3(dot(a, u()), dot(a, v()), dot(a, w())); }
+
+    private:
+        vec3 axis[3];
+};
+
+#endif /* onb_h */
@@ -0,0 +1,132 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef path_tracer_h
+#define path_tracer_h
+
+#include "camera.h"
+#include "compiled_scene.h"
+#include "counters.h"
+#include "hittable.h"
+#include "integrator.h"
+#include "material.h"
+#include "render.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+
+// Follows one path iteratively from a ray whose first hit is already known, e.g.
+// from a packet trace. throughput is the product of the sample weights picked up so
+// far; from roulette_depth bounces on, Russian roulette ends paths that can no
+// longer carry much light. The bounce and ray counts go to lengths.
+color shade_hit(ray r, bool hit, hit_record rec, const hittable& world, const material_table& materials,
+                int max_depth, const render_options& options, sampler& rng, path_histogram& lengths) {
+    const double infinity = std::numeric_limits<double>::infinity();
+    color radiance(0,0,0);
+    color throughput(1,1,1);
+    int bounces = 0;
+    int rays = 0;
+
+    // Each iteration shades one ray; the path ends after max_depth rays.
+    for (int depth = 0; depth < max_depth; depth++) {
+        rays++;
+        RT_COUNT(thread_counters().rays_at_depth[std::min(depth, render_counters::depths - 1)]++);
+        if (depth > 0)
+            hit = world.hit(r, 0, infinity, rec);
+
+        if (!hit) {
+            vec3 unit_direction = unit_vector(r.direction());
+            auto t = 0.5*(unit_direction.y() + 1.0);
+            radiance += throughput * ((1.0-t)*color(1.0, 1.0, 1.0) + t*color(0.5, 0.7, 1.0));
+            break;
+        }
+
+        scatter_sample sample;
+        rng.start_dimension(bounce_dimension(depth, bsdf_dimension), 2);
+        if (!materials[rec.mat_id].sample(r, rec, rng, sample))
+            break;
+
+        throughput = throughput * sample.weight;
+        r = rec.spawn_ray(sample.direction);
+        bounces++;
+
+        rng.start_dimension(bounce_dimension(depth, roulette_dimension), 1);
+        if (options.roulette && bounces >= options.roulette_depth && !survives_roulette(throughput, rng))
+            break;
+    }
+
+    lengths.add(bounces, rays);
+    return radiance;
+}
+
+color ray_color(const ray& r, const hittable& world, const material_table& materials,
+                int max_depth, const render_options& options, sampler& rng, path_histogram& lengths) {
+    hit_record rec;
+    bool hit = max_depth > 0 && world.hit(r, 0, std::numeric_limits<double>::infinity(), rec);
+    return shade_hit(r, hit, rec, world, materials, max_depth, options, rng, lengths);
+}
+
+
+// Renders world as seen by cam with the sampling, tiling and packet settings of
+// options; main and the render benchmark both come through here. The statistics
+// of every pixel are left in pixels, with its traversal cost under RT_COUNTERS,
+// and the paths counted in lengths.
+template <int N>
+float_image render_scene(thread_pool& pool, const compiled_scene<N>& world, const material_table& materials,
+                         const camera& cam, int image_width, int image_height, int max_depth,
+                         const render_options& options, std::vector<pixel_statistics>& pixels,
+                         path_histogram& lengths) {
+    std::vector<path_histogram> worker_lengths(pool.size());
+
+    auto trace_samples = [&](int i, int j, int first, int count, pixel_statistics& stats) {
+        path_histogram& own_lengths = worker_lengths[pool.worker_index()];
+        if (!options.packets) {
+            for (int s = first; s < first + count; ++s) {
+                sampler rng = sampler::for_pixel(options.sampling.sequence, i, j, image_width, s,
+                                                 options.sampling.max_spp);
+                auto u = (i + rng.random_double()) / (image_width-1);
+                auto v = (j + rng.random_double()) / (image_height-1);
+                ray r = cam.get_ray(u, v);
+                stats.add(ray_color(r, world, materials, max_depth, options, rng, own_lengths));
+            }
+            return;
+        }
+
+        // The samples of one pixel are nearly identical rays: trace their first
+        // hit as a packet, then follow each bounce on its own.
+        for (int s0 = first; s0 < first + count; s0 += packet_size) {
+            int n = std::min(packet_size, first + count - s0);
+            sampler rngs[packet_size];
+            ray rays[packet_size];
+            hit_record recs[packet_size];
+            for (int k = 0; k < n; ++k) {
+                rngs[k] = sampler::for_pixel(options.sampling.sequence, i, j, image_width, s0 + k,
+                                             options.sampling.max_spp);
+                auto u = (i + rngs[k].random_double()) / (image_width-1);
+                auto v = (j + rngs[k].random_double()) / (image_height-1);
+                rays[k] = cam.get_ray(u, v);
+            }
+            unsigned hits = world.hit_packet(rays, n, 0, std::numeric_limits<double>::infinity(), recs);
+            for (int k = 0; k < n; ++k)
+                stats.add(shade_hit(rays[k], hits & (1u << k), recs[k], world, materials, max_depth, options,
+                                    rngs[k], own_lengths));
+        }
+    };
+
+    auto image = render_adaptive(pool, image_width, image_height, options.tile_size, options.sampling, pixels,
+        [&](int i, int j, int first, int count, pixel_statistics& stats) {
+            // The thread's counters only grow while it shades this pixel.
+            RT_COUNT(stats.cost -= thread_counters().traversal_cost());
+            trace_samples(i, j, first, count, stats);
+            RT_COUNT(stats.cost += thread_counters().traversal_cost());
+        });
+
+    for (const auto& worker : worker_lengths)
+        lengths += worker;
+    return image;
+}
+
+#endif /* path_tracer_h */
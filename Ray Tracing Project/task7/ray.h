@@ -6,23 +6,55 @@
 #define ray_h
 #include "vec3.h"
 
-class ray {
+#include <cmath>
+#include <limits>
+
+template <class T>
+class ray_t {
     public:
-        ray() {}
-        ray(const point3& origin, const vec3& direction)
+        ray_t() {}
+        ray_t(const vec3_t<T>& origin, const vec3_t<T>& direction)
             : orig(origin), dir(direction)
         {}
 
-        point3 origin() const  { return orig; }
-        vec3 direction() const { return dir; }
+        vec3_t<T> origin() const  { return orig; }
+        vec3_t<T> direction() const { return dir; }
 
-        point3 at(double t) const {
+        vec3_t<T> at(double t) const {
             return orig + t*dir;
         }
 
     public:
-        point3 orig;
-        vec3 dir;
+        vec3_t<T> orig;
+        vec3_t<T> dir;
 };
 
+using ray = ray_t<real>;
+
+
+// Bound on the relative error of n rounded operations in T, the gamma(n) of
+// Higham and of Physically Based Rendering (3rd ed., 3.9).
+template <class T>
+constexpr T rounding_error(int n) {
+    return n * (std::numeric_limits<T>::epsilon() / 2) / (1 - n * (std::numeric_limits<T>::epsilon() / 2));
+}
+
+template <class T>
+inline T max_abs_component(const vec3_t<T>& v) {
+    return std::fmax(std::fmax(std::fabs(v.x()), std::fabs(v.y())), std::fabs(v.z()));
+}
+
+// Moves p, a point of a surface whose coordinates may each be off by up to error,
+// out along the normal n to the side direction w leaves on. From there no rounding
+// can put the surface in front of a ray towards w, so rays leaving a surface are
+// traced from t = 0 instead of past an arbitrary small t (after PBR 3rd ed.,
+// 3.9.5). The rounding of the sum itself is covered by two more units in the last
+// place of p, which also move points known exactly (error 0) off their surface.
+template <class T>
+vec3_t<T> offset_ray_origin(const vec3_t<T>& p, T error, const vec3_t<T>& n, const vec3_t<T>& w) {
+    const T eps = std::numeric_limits<T>::epsilon();
+    T d = error * (std::fabs(n.x()) + std::fabs(n.y()) + std::fabs(n.z())) + 2 * eps * max_abs_component(p);
+    return p + (dot(n, w) < 0 ? -d : d) * n;
+}
+
 #endif /* ray_h */
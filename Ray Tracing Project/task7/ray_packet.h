@@ -0,0 +1,127 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef ray_packet_h
+#define ray_packet_h
+
+#include "isa.h"
+#include "ray.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+
+const int packet_size = 8;
+
+// std::nextafter(x, INFINITY), inline. Traversal calls this after every closer
+// hit; the libm version is built for plain SSE and stalls when the compiler has
+// left AVX state dirty before the call.
+inline float next_float_up(float x) {
+    if (std::isnan(x) || x == INFINITY)
+        return x;
+    if (x == 0)
+        return std::numeric_limits<float>::denorm_min();
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    bits = x > 0 ? bits + 1 : bits - 1;
+    std::memcpy(&x, &bits, sizeof(bits));
+    return x;
+}
+
+// Up to packet_size coherent rays in structure-of-arrays form, one SIMD lane per ray.
+// Lanes past count are inactive. t_max shrinks per lane as closer hits are found.
+struct alignas(32) ray_packet {
+    float ox[packet_size], oy[packet_size], oz[packet_size];
+    float ix[packet_size], iy[packet_size], iz[packet_size];
+    float t_min[packet_size], t_max[packet_size];
+    int count;
+
+    ray_packet(const ray* rays, int n, double tmin, double tmax) : count(n) {
+        for (int k = 0; k < packet_size; k++) {
+            const ray& r = rays[k < n ? k : 0];
+            ox[k] = static_cast<float>(r.origin().x());
+            oy[k] = static_cast<float>(r.origin().y());
+            oz[k] = static_cast<float>(r.origin().z());
+            ix[k] = reciprocal(r.direction().x());
+            iy[k] = reciprocal(r.direction().y());
+            iz[k] = reciprocal(r.direction().z());
+            t_min[k] = static_cast<float>(tmin);
+            t_max[k] = next_float_up(static_cast<float>(tmax));
+        }
+    }
+
+    unsigned active_mask() const { return (1u << count) - 1; }
+
+    static float reciprocal(double d) {
+        // Axis-parallel rays get a huge finite reciprocal, so 0 * inf never makes a NaN.
+        return std::fabs(d) > 1e-30 ? static_cast<float>(1 / d) : std::copysign(1e30f, static_cast<float>(d));
+    }
+};
+
+
+// Tests every lane of the packet against one box; returns the mask of lanes that hit
+// and writes the entry distance of every lane to t_near. One version per level;
+// AVX-512 gets the AVX2 one, which already covers the eight lanes.
+inline unsigned packet_hits_box(isa_tag<isa_scalar>, const ray_packet& p, const float bmin[3], const float bmax[3],
+                                float* t_near) {
+    unsigned mask = 0;
+    for (int k = 0; k < packet_size; k++) {
+        float tx0 = (bmin[0] - p.ox[k]) * p.ix[k], tx1 = (bmax[0] - p.ox[k]) * p.ix[k];
+        float ty0 = (bmin[1] - p.oy[k]) * p.iy[k], ty1 = (bmax[1] - p.oy[k]) * p.iy[k];
+        float tz0 = (bmin[2] - p.oz[k]) * p.iz[k], tz1 = (bmax[2] - p.oz[k]) * p.iz[k];
+        float t0 = fmaxf(fmaxf(fminf(tx0, tx1), fminf(ty0, ty1)), fmaxf(fminf(tz0, tz1), p.t_min[k]));
+        float t1 = fminf(fminf(fmaxf(tx0, tx1), fmaxf(ty0, ty1)), fminf(fmaxf(tz0, tz1), p.t_max[k]));
+        t_near[k] = t0;
+        if (t0 <= t1)
+            mask |= 1u << k;
+    }
+    return mask;
+}
+
+#if RT_X86_SIMD
+inline unsigned packet_hits_box(isa_tag<isa_sse2>, const ray_packet& p, const float bmin[3], const float bmax[3],
+                                float* t_near) {
+    unsigned mask = 0;
+    for (int h = 0; h < packet_size; h += 4) {
+        const __m128 ix = _mm_load_ps(p.ix + h), iy = _mm_load_ps(p.iy + h), iz = _mm_load_ps(p.iz + h);
+        __m128 tx0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bmin[0]), _mm_load_ps(p.ox + h)), ix);
+        __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bmax[0]), _mm_load_ps(p.ox + h)), ix);
+        __m128 ty0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bmin[1]), _mm_load_ps(p.oy + h)), iy);
+        __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bmax[1]), _mm_load_ps(p.oy + h)), iy);
+        __m128 tz0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bmin[2]), _mm_load_ps(p.oz + h)), iz);
+        __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bmax[2]), _mm_load_ps(p.oz + h)), iz);
+
+        __m128 t0 = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx0, tx1), _mm_min_ps(ty0, ty1)),
+                               _mm_max_ps(_mm_min_ps(tz0, tz1), _mm_load_ps(p.t_min + h)));
+        __m128 t1 = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx0, tx1), _mm_max_ps(ty0, ty1)),
+                               _mm_min_ps(_mm_max_ps(tz0, tz1), _mm_load_ps(p.t_max + h)));
+        _mm_storeu_ps(t_near + h, t0);
+        mask |= static_cast<unsigned>(_mm_movemask_ps(_mm_cmple_ps(t0, t1))) << h;
+    }
+    return mask;
+}
+
+RT_TARGET_AVX2
+inline unsigned packet_hits_box(isa_tag<isa_avx2>, const ray_packet& p, const float bmin[3], const float bmax[3],
+                                float* t_near) {
+    const __m256 ix = _mm256_load_ps(p.ix), iy = _mm256_load_ps(p.iy), iz = _mm256_load_ps(p.iz);
+    __m256 tx0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bmin[0]), _mm256_load_ps(p.ox)), ix);
+    __m256 tx1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bmax[0]), _mm256_load_ps(p.ox)), ix);
+    __m256 ty0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bmin[1]), _mm256_load_ps(p.oy)), iy);
+    __m256 ty1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bmax[1]), _mm256_load_ps(p.oy)), iy);
+    __m256 tz0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bmin[2]), _mm256_load_ps(p.oz)), iz);
+    __m256 tz1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bmax[2]), _mm256_load_ps(p.oz)), iz);
+
+    __m256 t0 = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(tx0, tx1), _mm256_min_ps(ty0, ty1)),
+                              _mm256_max_ps(_mm256_min_ps(tz0, tz1), _mm256_load_ps(p.t_min)));
+    __m256 t1 = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(tx0, tx1), _mm256_max_ps(ty0, ty1)),
+                              _mm256_min_ps(_mm256_max_ps(tz0, tz1), _mm256_load_ps(p.t_max)));
+    _mm256_storeu_ps(t_near, t0);
+    return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(t0, t1, _CMP_LE_OQ)));
+}
+#endif
+
+#endif /* ray_packet_h */
@@ -0,0 +1,420 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+
+// Renders a fixed set of scenes at fixed seeds, the way main does, and reports
+// their throughput as JSON. Given a baseline report, fails when a scene has got
+// slower than the baseline by more than the tolerance.
+// Usage: render_bench [--threads N] [--spp N] [--packets] [--json FILE]
+//                     [--baseline FILE] [--tolerance X] [--images DIR]
+//                     [--reference DIR] [--isa LEVEL] [--bvh sah|lbvh] [scene ...]
+// With no scene names every scene is rendered. The exit status is 1 after a
+// regression, 2 on bad arguments or an unreadable baseline.
+// --images writes every scene's image to DIR/<scene>.pfm; --reference reports
+// the RMS error of every image against the ones found there. A float build run
+// against the images of a double build, or of a high spp run, measures what the
+// precision costs. --isa runs the kernels of a lower level than the CPU's; every
+// level renders the same images, so only the throughput should change. Scenes
+// build their BVH on the render threads; --bvh lbvh swaps the SAH build for the
+// faster, lower quality one, which changes the images.
+// render_bench_baseline.json is a report of the default run on the reference
+// machine; regenerate it with --json when the machine or a deliberate tradeoff
+// changes.
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "camera.h"
+#include "compiled_scene.h"
+#include "scene_file.h"
+#include "scenes.h"
+#include "path_tracer.h"
+
+using namespace std;
+
+struct bench_scene {
+    const char* name;
+    scene (*make)();
+    camera_settings view;
+};
+
+camera_settings view_of(point3 lookfrom, point3 lookat, double vfov) {
+    camera_settings view;
+    view.lookfrom = lookfrom;
+    view.lookat = lookat;
+    view.vfov = vfov;
+    return view;
+}
+
+// Smallest first, so the peak memory of each scene is mostly its own.
+vector<bench_scene> bench_scenes() {
+    return {
+        {"task1_spheres", task1_spheres, view_of(point3(-0.4, 0, -2.5), point3(-0.4, 0, -1.5), 90)},
+        {"task5_dielectrics", dielectric_spheres, view_of(point3(0, 0, 0), point3(0, 0, -1), 90)},
+        {"task6_random_spheres", random_spheres, view_of(point3(13, 2, 3), point3(0, 0, 0), 20)},
+        {"task7_pyramid", pyramid, camera_settings()},
+        {"grid_1k", [] { return sphere_grid(32); }, view_of(point3(0, 1.5, 2.2), point3(0, 0, 0), 40)},
+        {"grid_16k", [] { return sphere_grid(128); }, view_of(point3(0, 1.5, 2.2), point3(0, 0, 0), 40)},
+        {"grid_256k", [] { return sphere_grid(512); }, view_of(point3(0, 1.5, 2.2), point3(0, 0, 0), 40)},
+        {"grid_1m", [] { return sphere_grid(1024); }, view_of(point3(0, 1.5, 2.2), point3(0, 0, 0), 40)},
+    };
+}
+
+
+struct bench_options {
+    render_options render;
+    string json;            // where the report goes; standard output when empty
+    string baseline;        // report to compare against, when set
+    double tolerance = 0.1; // allowed slowdown against the baseline, as a fraction
+    string images;          // directory to write the images to, when set
+    string reference;       // directory of images to measure the error against, when set
+    vector<string> scenes;  // names to render; all when empty
+};
+
+void print_bench_usage(const char* program) {
+    cerr << "Usage: " << program << " [--threads N] [--spp N] [--packets] [--json FILE]\n"
+         << "       [--baseline FILE] [--tolerance X] [--images DIR]\n"
+         << "       [--reference DIR] [--isa scalar|sse2|avx2|avx512] [--bvh sah|lbvh]\n"
+         << "       [scene ...]\n"
+         << "Scenes:";
+    for (const auto& s : bench_scenes())
+        cerr << ' ' << s.name;
+    cerr << '\n';
+}
+
+// Accepts both "--threads 8" and "--threads=8".
+bench_options parse_bench_options(int argc, char* argv[]) {
+    bench_options options;
+    options.render.sampling.min_spp = options.render.sampling.max_spp = 4;
+
+    for (int a = 1; a < argc; a++) {
+        string arg = argv[a];
+        string value;
+
+        if (arg == "--packets") {
+            options.render.packets = true;
+            continue;
+        }
+        if (arg.compare(0, 2, "--") != 0) {
+            options.scenes.push_back(arg);
+            continue;
+        }
+
+        auto eq = arg.find('=');
+        if (eq != string::npos) {
+            value = arg.substr(eq + 1);
+            arg = arg.substr(0, eq);
+        } else if (a + 1 < argc) {
+            value = argv[++a];
+        }
+
+        int number = atoi(value.c_str());
+        if (arg == "--threads" && number > 0) {
+            options.render.threads = static_cast<unsigned>(number);
+        } else if (arg == "--spp" && number > 0) {
+            options.render.sampling.min_spp = options.render.sampling.max_spp = number;
+        } else if (arg == "--json" && !value.empty()) {
+            options.json = value;
+        } else if (arg == "--baseline" && !value.empty()) {
+            options.baseline = value;
+        } else if (arg == "--tolerance" && !value.empty() && atof(value.c_str()) >= 0) {
+            options.tolerance = atof(value.c_str());
+        } else if (arg == "--images" && !value.empty()) {
+            options.images = value;
+        } else if (arg == "--reference" && !value.empty()) {
+            options.reference = value;
+        } else if (arg == "--isa" && parse_isa(value, options.render.isa)) {
+            // parse_isa has stored it; main checks the CPU can run it.
+        } else if (arg == "--bvh" && parse_bvh_build(value, options.render.bvh)) {
+            // parse_bvh_build has stored it.
+        } else {
+            print_bench_usage(argv[0]);
+            exit(2);
+        }
+    }
+    return options;
+}
+
+
+// Peak resident memory of the whole process so far, in KiB.
+long peak_rss_kib() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;  // bytes on macOS
+#else
+    return usage.ru_maxrss;         // KiB on Linux
+#endif
+}
+
+// FNV-1a over the 8-bit image, to tell whether a change altered the picture.
+string image_hash(const float_image& image) {
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char b : image_bytes(image, 1)) {
+        h ^= b;
+        h *= 1099511628211ull;
+    }
+    char text[17];
+    snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(h));
+    return text;
+}
+
+
+// What one scene measured. Every sample starts with one camera ray, so primary
+// rays per second equal samples per second; total rays add every bounce.
+struct scene_result {
+    string name;
+    size_t primitives = 0;
+    double build_ms = 0;
+    double render_seconds = 0;
+    long samples = 0;
+    long rays = 0;
+    long peak_rss_kib = 0;
+    string image_hash;
+    double reference_error = -1;    // RMS error against the reference image; -1 without one
+};
+
+scene_result run_scene(const bench_scene& bs, thread_pool& pool, const bench_options& bench) {
+    const render_options& options = bench.render;
+    const auto aspect_ratio = 16.0 / 9.0;
+    const int image_width = 400;
+    const int image_height = static_cast<int>(image_width / aspect_ratio);
+    const int max_depth = 50;
+
+    scene_result result;
+    result.name = bs.name;
+    scene sc = bs.make();
+    result.primitives = sc.objects.objects.size();
+
+    bvh_build_options build;
+    build.mode = options.bvh;
+    build.pool = &pool;
+    auto start = chrono::steady_clock::now();
+    compiled_scene<4> world(sc.objects, 0, 1, nullptr, build);
+    result.build_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    camera cam(bs.view.lookfrom, bs.view.lookat, bs.view.vup, bs.view.vfov, aspect_ratio);
+    vector<pixel_statistics> pixels;
+    path_histogram lengths;
+    start = chrono::steady_clock::now();
+    auto framebuffer = render_scene(pool, world, sc.materials, cam, image_width, image_height, max_depth,
+                                    options, pixels, lengths);
+    result.render_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << '\n';
+
+    for (const auto& stats : pixels)
+        result.samples += stats.count;
+    result.rays = lengths.rays;
+    result.peak_rss_kib = peak_rss_kib();
+    result.image_hash = image_hash(framebuffer);
+
+    if (!bench.images.empty() && !write_image(bench.images + "/" + bs.name + ".pfm", framebuffer, 1))
+        cerr << "Could not write " << bench.images << '/' << bs.name << ".pfm\n";
+    if (!bench.reference.empty()) {
+        float_image reference;
+        string path = bench.reference + "/" + bs.name + ".pfm";
+        if (!read_pfm(path, reference) || reference.width != framebuffer.width
+            || reference.height != framebuffer.height)
+            cerr << "No reference image " << path << '\n';
+        else
+            result.reference_error = rms_error(framebuffer, reference);
+        cerr << "RMS error against the reference: " << result.reference_error << '\n';
+    }
+    return result;
+}
+
+
+void write_report(ostream& out, const bench_options& options, unsigned threads, const vector<scene_result>& results) {
+    out << "{\n"
+        << "  \"threads\": " << threads << ",\n"
+        << "  \"samples_per_pixel\": " << options.render.sampling.max_spp << ",\n"
+        << "  \"packets\": " << (options.render.packets ? "true" : "false") << ",\n"
+        << "  \"precision\": \"" << (RT_FLOAT ? "float" : "double") << "\",\n"
+        << "  \"isa\": \"" << isa_name(active_isa()) << "\",\n"
+        << "  \"bvh\": \"" << bvh_build_name(options.render.bvh) << "\",\n"
+        << "  \"scenes\": [\n";
+    for (size_t k = 0; k < results.size(); k++) {
+        const auto& r = results[k];
+        char line[1024];
+        snprintf(line, sizeof(line),
+                 "    {\"name\": \"%s\", \"primitives\": %zu, \"build_ms\": %.3f, \"render_seconds\": %.4f, "
+                 "\"samples\": %ld, \"rays\": %ld, \"samples_per_second\": %.0f, \"primary_rays_per_second\": %.0f, "
+                 "\"total_rays_per_second\": %.0f, \"peak_rss_kib\": %ld, \"image_hash\": \"%s\"",
+                 r.name.c_str(), r.primitives, r.build_ms, r.render_seconds, r.samples, r.rays,
+                 r.samples / r.render_seconds, r.samples / r.render_seconds, r.rays / r.render_seconds,
+                 r.peak_rss_kib, r.image_hash.c_str());
+        out << line;
+        if (r.reference_error >= 0) {
+            snprintf(line, sizeof(line), ", \"reference_rms_error\": %.6g", r.reference_error);
+            out << line;
+        }
+        out << '}' << (k + 1 < results.size() ? "," : "") << '\n';
+    }
+    out << "  ]\n}\n";
+}
+
+
+// The fields of one object of a report, values as written (strings unquoted).
+typedef map<string, string> report_fields;
+
+// Reads back the scenes of a report written by write_report, by name, along
+// with the top-level settings. Not a general JSON reader: objects do not nest
+// inside the scene list, and strings hold no escapes.
+bool read_report(const string& path, report_fields& settings, map<string, report_fields>& scenes) {
+    ifstream in(path);
+    if (!in)
+        return false;
+    stringstream buffer;
+    buffer << in.rdbuf();
+    const string text = buffer.str();
+
+    // Reads "key": value pairs from pos until the object closes or the scene list opens.
+    auto read_fields = [&](size_t& pos, report_fields& fields) {
+        while (pos < text.size() && text[pos] != '}' && text[pos] != '[') {
+            if (text[pos] != '"') {
+                pos++;
+                continue;
+            }
+            size_t key_end = text.find('"', pos + 1);
+            size_t colon = text.find(':', key_end);
+            if (key_end == string::npos || colon == string::npos)
+                return false;
+            string key = text.substr(pos + 1, key_end - pos - 1);
+            pos = text.find_first_not_of(" \t\r\n", colon + 1);
+            if (pos == string::npos)
+                return false;
+            if (text[pos] == '[')
+                return true;
+            size_t value_end;
+            if (text[pos] == '"') {
+                value_end = text.find('"', pos + 1);
+                if (value_end == string::npos)
+                    return false;
+                fields[key] = text.substr(pos + 1, value_end - pos - 1);
+                pos = value_end + 1;
+            } else {
+                value_end = text.find_first_of(",}\n", pos);
+                fields[key] = text.substr(pos, value_end - pos);
+                pos = value_end;
+            }
+        }
+        return true;
+    };
+
+    size_t pos = text.find('{');
+    if (pos == string::npos || !read_fields(++pos, settings) || pos >= text.size() || text[pos] != '[')
+        return false;
+    while ((pos = text.find_first_of("{]", pos)) != string::npos && text[pos] == '{') {
+        report_fields fields;
+        if (!read_fields(++pos, fields) || !fields.count("name"))
+            return false;
+        scenes[fields["name"]] = fields;
+    }
+    return true;
+}
+
+// Compares the results against the baseline report, printing one line per
+// measure, and returns how many got worse by more than the tolerance. Build
+// times under 10 ms are too noisy to judge and are only printed.
+int compare_to_baseline(const bench_options& options, unsigned threads, const vector<scene_result>& results) {
+    report_fields settings;
+    map<string, report_fields> baseline;
+    if (!read_report(options.baseline, settings, baseline)) {
+        cerr << "Could not read the baseline " << options.baseline << '\n';
+        exit(2);
+    }
+    if (atoi(settings["threads"].c_str()) != static_cast<int>(threads)
+        || atoi(settings["samples_per_pixel"].c_str()) != options.render.sampling.max_spp
+        || settings["packets"] != (options.render.packets ? "true" : "false")
+        || settings["precision"] != (RT_FLOAT ? "float" : "double")
+        || settings["isa"] != isa_name(active_isa())
+        || settings["bvh"] != bvh_build_name(options.render.bvh))
+        cerr << "Warning: the baseline was run with other settings (" << settings["threads"] << " threads, "
+             << settings["samples_per_pixel"] << " spp, packets " << settings["packets"] << ", "
+             << settings["precision"] << " precision, " << settings["isa"] << " kernels, "
+             << settings["bvh"] << " BVH)\n";
+
+    int regressions = 0;
+    auto check = [&](const string& scene, const char* measure, double now, double before, bool higher_is_better,
+                     bool judged) {
+        double change = before > 0 ? now / before - 1 : 0;
+        bool worse = judged && (higher_is_better ? change < -options.tolerance : change > options.tolerance);
+        regressions += worse;
+        char line[256];
+        snprintf(line, sizeof(line), "  %-22s %-22s %14.1f vs %14.1f  %+6.1f%%%s\n", scene.c_str(), measure,
+                 now, before, 100 * change, worse ? "  REGRESSION" : "");
+        cerr << line;
+    };
+
+    cerr << "Against " << options.baseline << " (tolerance " << 100 * options.tolerance << "%):\n";
+    for (const auto& r : results) {
+        auto found = baseline.find(r.name);
+        if (found == baseline.end()) {
+            cerr << "  " << r.name << ": not in the baseline\n";
+            continue;
+        }
+        report_fields& b = found->second;
+        double build_before = atof(b["build_ms"].c_str());
+        check(r.name, "samples_per_second", r.samples / r.render_seconds, atof(b["samples_per_second"].c_str()), true, true);
+        check(r.name, "total_rays_per_second", r.rays / r.render_seconds, atof(b["total_rays_per_second"].c_str()), true, true);
+        check(r.name, "build_ms", r.build_ms, build_before, false, build_before >= 10);
+        if (b["image_hash"] != r.image_hash)
+            cerr << "  " << r.name << ": the image differs from the baseline's\n";
+    }
+    cerr << (regressions ? to_string(regressions) + " regressions\n" : string("No regressions\n"));
+    return regressions;
+}
+
+
+int main(int argc, char* argv[]) {
+    bench_options options = parse_bench_options(argc, argv);
+
+    vector<bench_scene> selected;
+    for (const auto& s : bench_scenes()) {
+        bool wanted = options.scenes.empty();
+        for (const auto& name : options.scenes)
+            wanted = wanted || name == s.name;
+        if (wanted)
+            selected.push_back(s);
+    }
+    if (selected.empty()) {
+        print_bench_usage(argv[0]);
+        return 2;
+    }
+    if (!select_isa(options.render.isa)) {
+        cerr << "This CPU cannot run the " << isa_name(options.render.isa) << " kernels, only up to "
+             << isa_name(detected_isa()) << '\n';
+        return 2;
+    }
+    cerr << "Kernels: " << isa_description() << '\n';
+
+    thread_pool pool(options.render.threads);
+    vector<scene_result> results;
+    for (const auto& s : selected) {
+        cerr << s.name << '\n';
+        results.push_back(run_scene(s, pool, options));
+    }
+
+    if (options.json.empty()) {
+        write_report(cout, options, pool.size(), results);
+    } else {
+        ofstream out(options.json);
+        write_report(out, options, pool.size(), results);
+        if (!out) {
+            cerr << "Could not write " << options.json << '\n';
+            return 2;
+        }
+    }
+
+    if (!options.baseline.empty() && compare_to_baseline(options, pool.size(), results) > 0)
+        return 1;
+}
@@ -0,0 +1,371 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef sampler_h
+#define sampler_h
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// splitmix64 finalizer, used to turn (pixel, sample, frame) into a seed.
+inline uint64_t mix_bits(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+
+// The sequences the samples of a pixel can draw from. Independent samples are
+// plain PCG32 numbers; the others spread the samples of a pixel evenly over each
+// pair of dimensions, and converge faster while a path's integrand is smooth.
+enum sample_sequence { independent_samples, stratified_samples, sobol_samples, blue_noise_samples };
+
+inline const char* sequence_name(sample_sequence sequence) {
+    static const char* names[] = { "independent", "stratified", "sobol", "blue-noise" };
+    return names[sequence];
+}
+
+inline bool parse_sequence(const std::string& name, sample_sequence& sequence) {
+    for (int k = independent_samples; k <= blue_noise_samples; k++)
+        if (name == sequence_name(static_cast<sample_sequence>(k))) {
+            sequence = static_cast<sample_sequence>(k);
+            return true;
+        }
+    return false;
+}
+
+
+// Where each use of random numbers starts among the dimensions of one camera
+// sample, and how many it takes. Each use draws from its own dimensions, however
+// many numbers the others took, so no two are correlated. Each bounce gets a
+// block of bounce_dimensions from bounce_dimension on. The sequences stratify
+// dimensions in pairs, 2k and 2k+1, so the 2D uses start on even dimensions.
+enum sample_dimension {
+    pixel_dimension = 0,        // 2: jitter within the pixel
+    lens_dimension = 2,         // 2: point on the lens
+    time_dimension = 4,         // 1: shutter time
+    camera_dimensions = 6,      // one left over, to keep the bounces on pairs
+    bsdf_dimension = 0,         // 2: the material's sample
+    light_dimension = 2,        // 2: a direction towards the light
+    light_pick_dimension = 4,   // 1: the light picked
+    roulette_dimension = 5,     // 1: Russian roulette
+    bounce_dimensions = 6,
+    sequence_dimensions = camera_dimensions + 4 * bounce_dimensions   // the first four bounces
+};
+
+inline uint32_t bounce_dimension(int depth, sample_dimension use) {
+    return camera_dimensions + static_cast<uint32_t>(depth) * bounce_dimensions + use;
+}
+
+
+inline uint32_t reverse_bits(uint32_t x) {
+    x = __builtin_bswap32(x);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+    x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+    return x;
+}
+
+// Laine and Karras' hash, in which each bit only depends on those below it. On
+// bit-reversed values that is an Owen scramble (Burley 2020): each bit flipped or
+// not by a hash of the bits above it, which keeps a Sobol sequence stratified.
+inline uint32_t laine_karras_permutation(uint32_t x, uint32_t seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+// The first two dimensions of the Sobol sequence, a (0,2)-sequence: any power of
+// two samples from the start put one in each cell of every such 2D grid. The
+// result is bit-reversed, the form the scrambling works on: the first dimension
+// is then the index itself, and the second the XOR of a reversed direction
+// number per set bit of index, looked up a byte at a time.
+inline uint32_t reversed_sobol_bits(uint32_t index, int dimension) {
+    if (dimension == 0)
+        return index;
+
+    struct byte_tables {
+        uint32_t xors[4][256];
+        byte_tables() {
+            uint32_t directions[32];
+            uint32_t v = 1u << 31;
+            for (int k = 0; k < 32; k++, v ^= v >> 1)
+                directions[k] = reverse_bits(v);
+            for (int b = 0; b < 4; b++)
+                for (int byte = 0; byte < 256; byte++) {
+                    xors[b][byte] = 0;
+                    for (int j = 0; j < 8; j++)
+                        if (byte & (1 << j))
+                            xors[b][byte] ^= directions[8*b + j];
+                }
+        }
+    };
+    static const byte_tables tables;
+    return tables.xors[0][index & 0xff] ^ tables.xors[1][(index >> 8) & 0xff]
+         ^ tables.xors[2][(index >> 16) & 0xff] ^ tables.xors[3][index >> 24];
+}
+
+// A permutation of 0 .. count-1 chosen by seed (Kensler 2013), walking the
+// cycles of a permutation of the next power of two.
+inline uint32_t permute_index(uint32_t i, uint32_t count, uint32_t seed) {
+    uint32_t w = count - 1;
+    w |= w >> 1; w |= w >> 2; w |= w >> 4; w |= w >> 8; w |= w >> 16;
+    do {
+        i ^= seed; i *= 0xe170893d; i ^= seed >> 16;
+        i ^= (i & w) >> 4; i ^= seed >> 8; i *= 0x0929eb3f; i ^= seed >> 23;
+        i ^= (i & w) >> 1; i *= 1 | seed >> 27; i *= 0x6935fa69;
+        i ^= (i & w) >> 11; i *= 0x74dcb303; i ^= (i & w) >> 2; i *= 0x9e501cc3;
+        i ^= (i & w) >> 2; i *= 0xc860a3df; i &= w; i ^= i >> 5;
+    } while (i >= count);
+    return (i + seed) % count;
+}
+
+inline double to_unit(uint32_t bits) {
+    return bits * (1.0 / 4294967296.0);
+}
+
+
+// A 64x64 tile of blue noise: values in [0,1) whose ranks are spread so that
+// similar values never clump, by void-and-cluster (Ulichney 1993). Shifting the
+// samples of every pixel by it leaves their error as blue noise, which reads as
+// finer grain than white noise of the same size. Built once, on first use.
+class blue_noise_mask {
+    public:
+        static const int size = 64;
+
+        static const blue_noise_mask& instance() {
+            static blue_noise_mask mask;
+            return mask;
+        }
+
+        double at(uint32_t x, uint32_t y) const {
+            return values[(y % size) * size + (x % size)];
+        }
+
+    private:
+        blue_noise_mask() : values(size * size), energy(size * size, 0.0), filled(size * size, 0) {
+            // Gaussian energy by toroidal offset, so every update is a table walk.
+            const double sigma = 1.5;
+            kernel.resize(size * size);
+            for (int dy = 0; dy < size; dy++)
+                for (int dx = 0; dx < size; dx++) {
+                    int wx = std::min(dx, size - dx), wy = std::min(dy, size - dy);
+                    kernel[dy * size + dx] = std::exp(-(wx*wx + wy*wy) / (2 * sigma * sigma));
+                }
+
+            // An initial tenth of the pixels, spread until the tightest cluster is
+            // also the largest void.
+            const int cells = size * size;
+            const int initial = cells / 10;
+            uint64_t state = 0x5eed;
+            for (int placed = 0; placed < initial; ) {
+                state = mix_bits(state);
+                int p = static_cast<int>(state % cells);
+                if (!filled[p]) {
+                    toggle(p);
+                    placed++;
+                }
+            }
+            for (int moves = 0; moves < cells; moves++) {
+                int cluster = extreme(true);
+                toggle(cluster);
+                int void_ = extreme(false);
+                if (void_ == cluster) {
+                    toggle(cluster);
+                    break;
+                }
+                toggle(void_);
+            }
+
+            // Ranks: the initial points from the tightest cluster down, then the
+            // rest by filling the largest void. Past half full, the largest void of
+            // the ones is also the tightest cluster of the zeros, so one rule does.
+            std::vector<char> initial_pattern = filled;
+            std::vector<double> initial_energy = energy;
+            for (int rank = initial - 1; rank >= 0; rank--) {
+                int p = extreme(true);
+                toggle(p);
+                values[p] = rank;
+            }
+            filled = initial_pattern;
+            energy = initial_energy;
+            for (int rank = initial; rank < cells; rank++) {
+                int p = extreme(false);
+                toggle(p);
+                values[p] = rank;
+            }
+            for (double& v : values)
+                v = (v + 0.5) / cells;
+        }
+
+        void toggle(int p) {
+            double sign = filled[p] ? -1 : 1;
+            filled[p] = !filled[p];
+            int px = p % size, py = p / size;
+            for (int y = 0; y < size; y++) {
+                const double* row = &kernel[((y - py + size) % size) * size];
+                for (int x = 0; x < size; x++)
+                    energy[y * size + x] += sign * row[(x - px + size) % size];
+            }
+        }
+
+        // The set pixel with the most energy (tightest cluster), or the unset one
+        // with the least (largest void).
+        int extreme(bool cluster) const {
+            int best = -1;
+            for (int p = 0; p < size * size; p++) {
+                if (filled[p] != cluster)
+                    continue;
+                if (best < 0 || (cluster ? energy[p] > energy[best] : energy[p] < energy[best]))
+                    best = p;
+            }
+            return best;
+        }
+
+        std::vector<double> values;
+        std::vector<double> kernel;
+        std::vector<double> energy;
+        std::vector<char> filled;
+};
+
+
+// Small PCG32 generator (O'Neill, XSH-RR). It is a value type, so every thread
+// or path owns its own copy and nothing is shared between tiles.
+// A sampler made by for_pixel draws the dimensions started by start_dimension
+// from its pixel's sequence instead, and falls back to PCG32 past them.
+class sampler {
+    public:
+        sampler() : sampler(0) {}
+        explicit sampler(uint64_t seed, uint64_t stream = 1) {
+            state = 0;
+            inc = (stream << 1u) | 1u;
+            next_uint();
+            state += seed;
+            next_uint();
+        }
+
+        // Independent stream for one camera sample of one pixel.
+        static sampler for_sample(uint64_t pixel, uint64_t sample_index, uint64_t frame = 0) {
+            return sampler(mix_bits(mix_bits(mix_bits(frame) ^ pixel) ^ sample_index));
+        }
+
+        // Sample sample_index of sample_count for pixel (x, y) of an image width
+        // pixels wide, drawing from sequence; its first dimensions are the pixel
+        // jitter. Independent samples are those of for_sample.
+        static sampler for_pixel(sample_sequence sequence, uint32_t x, uint32_t y, uint32_t width,
+                                 uint32_t sample_index, uint32_t sample_count, uint64_t frame = 0) {
+            uint64_t pixel = static_cast<uint64_t>(y) * width + x;
+            sampler s = for_sample(pixel, sample_index, frame);
+            s.sequence = sequence;
+            s.x = x;
+            s.y = y;
+            // Blue noise shifts one sequence shared by all pixels; the others
+            // scramble a sequence of their own for each.
+            s.seed = sequence == blue_noise_samples ? mix_bits(frame) : mix_bits(mix_bits(frame) ^ pixel);
+            s.sample_index = sample_index;
+            s.reversed_sample_index = reverse_bits(sample_index);
+            if (sequence == stratified_samples)
+                s.grid_side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(std::max(sample_count, 1u)))));
+            s.start_dimension(pixel_dimension, 2);
+            return s;
+        }
+
+        // The next count numbers come from dimensions first .. first+count-1.
+        // Past sequence_dimensions they are independent: deep bounces add little
+        // to the error, and the sequences cost several times what PCG32 does.
+        void start_dimension(uint32_t first, uint32_t count) {
+            dimension = first;
+            dimension_end = std::min(first + count, static_cast<uint32_t>(sequence_dimensions));
+        }
+
+        uint32_t next_uint() {
+            uint64_t old = state;
+            state = old * 6364136223846793005ULL + inc;
+            uint32_t xorshifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+            uint32_t rot = static_cast<uint32_t>(old >> 59u);
+            return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+        }
+
+        double random_double() {
+            // Returns a random real in [0,1).
+            if (sequence != independent_samples && dimension < dimension_end)
+                return sequence_value(dimension++);
+            return next_uint() * (1.0 / 4294967296.0);
+        }
+
+        double random_double(double min, double max) {
+            // Returns a random real in [min,max).
+            return min + (max-min)*random_double();
+        }
+
+        int random_int(int min, int max) {
+            // Returns a random integer in [min,max].
+            return static_cast<int>(random_double(min, max+1));
+        }
+
+    private:
+        // Dimensions go in pairs, each with its own scrambling, so that the
+        // samples of a pixel are spread over every pair and no two pairs agree.
+        // What both dimensions of a pair share is worked out once.
+        double sequence_value(uint32_t d) {
+            uint32_t pair = d >> 1, axis = d & 1;
+            if (pair != cached_pair) {
+                cached_pair = pair;
+                pair_seed = mix_bits(seed ^ (0x9e3779b97f4a7c15ULL * (pair + 1)));
+                if (sequence == stratified_samples)
+                    pair_index = sample_index < grid_side * grid_side
+                        ? permute_index(sample_index, grid_side * grid_side, static_cast<uint32_t>(pair_seed)) : ~0u;
+                else
+                    pair_index = reverse_bits(laine_karras_permutation(reversed_sample_index,
+                                                                       static_cast<uint32_t>(pair_seed)));
+
+                // Blue noise shifts the shared sequence by the mask, toroidally,
+                // read from a different place in it for every dimension.
+                if (sequence == blue_noise_samples)
+                    for (uint32_t a = 0; a < 2; a++) {
+                        uint64_t offset = mix_bits(pair_seed + a);
+                        pair_shift[a] = blue_noise_mask::instance().at(x + static_cast<uint32_t>(offset),
+                                                                       y + static_cast<uint32_t>(offset >> 32));
+                    }
+            }
+
+            if (sequence == stratified_samples) {
+                // One sample in each cell of a grid_side^2 grid, cells in random order.
+                if (pair_index == ~0u)
+                    return next_uint() * (1.0 / 4294967296.0);
+                uint32_t jitter = static_cast<uint32_t>(mix_bits(pair_seed ^ (sample_index * 2ULL + axis)) >> 32);
+                return ((axis ? pair_index / grid_side : pair_index % grid_side) + to_unit(jitter)) / grid_side;
+            }
+
+            uint32_t bits = reverse_bits(laine_karras_permutation(reversed_sobol_bits(pair_index, axis),
+                                                                  static_cast<uint32_t>(pair_seed >> 32) ^ axis));
+            if (sequence == sobol_samples)
+                return to_unit(bits);
+
+            double u = to_unit(bits) + pair_shift[axis];
+            return u < 1 ? u : u - 1;
+        }
+
+        uint64_t state;
+        uint64_t inc;
+
+        sample_sequence sequence = independent_samples;
+        uint32_t x = 0, y = 0;
+        uint64_t seed = 0;
+        uint32_t sample_index = 0, reversed_sample_index = 0, grid_side = 1;
+        uint32_t dimension = 0, dimension_end = 0;
+        uint32_t cached_pair = ~0u, pair_index = 0;
+        uint64_t pair_seed = 0;
+        double pair_shift[2] = {0, 0};
+};
+
+#endif /* sampler_h */
@@ -0,0 +1,470 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef scene_cache_h
+#define scene_cache_h
+
+#include "compiled_scene.h"
+#include "instance.h"
+#include "mesh_loader.h"
+#include "scene_file.h"
+#include "triangle_mesh.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+
+// A compiled_scene as it sits in memory after the build: the BVH nodes, the leaf
+// references and the typed primitive arrays, already in leaf order, plus the
+// materials, the camera and every mesh with its own tree. Each array is a count
+// followed by its raw bytes, so loading is one mapping and a copy per array, with
+// nothing parsed and nothing built. The bytes are those of this machine and this
+// build; the header rejects a file from a different layout.
+//
+// Only what the scene format can make is cached: spheres, sphere_sets, rects,
+// boxes, and meshes placed directly or through an instance.
+
+namespace scene_cache {
+
+const char magic[8] = { 'R', 'T', 'S', 'C', 'A', 'C', 'H', 'E' };
+const uint32_t version = 2;
+
+struct header {
+    char magic[8];
+    uint32_t version;
+    uint32_t node_size;     // sizeof(wide_bvh_node<4>), to catch a different layout
+    uint32_t real_size;     // sizeof(real): sphere_sets are as wide as the build's SIMD reals
+};
+
+struct material_record {
+    uint32_t type;          // 0 lambertian, 1 metal, 2 dielectric
+    double values[4];       // albedo and fuzz, or the index of refraction
+};
+
+struct sphere_record {
+    double center[3];
+    double radius;
+    uint32_t mat_id;
+};
+
+struct rect_record {
+    double a0, a1, b0, b1, k;
+    uint32_t mat_id;
+};
+
+struct box_record {
+    double min[3], max[3];
+    uint32_t mat_id;
+};
+
+struct other_record {
+    uint32_t mesh;          // index into the cached meshes
+    uint32_t instanced;     // placed through an instance with to_world
+    double to_world[3][4];
+};
+
+
+class writer {
+    public:
+        explicit writer(const std::string& path) : out(path, std::ios::binary) {}
+
+        bool ok() const { return static_cast<bool>(out); }
+
+        template <class T>
+        void pod(const T& value) { out.write(reinterpret_cast<const char*>(&value), sizeof(T)); }
+
+        template <class T>
+        void array(const std::vector<T>& values) {
+            pod(static_cast<uint64_t>(values.size()));
+            out.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+        }
+
+        void bounds(const aabb& box) {
+            for (int a = 0; a < 3; a++) pod(box.min()[a]);
+            for (int a = 0; a < 3; a++) pod(box.max()[a]);
+        }
+
+    private:
+        std::ofstream out;
+};
+
+// Reads the mapping front to back; any read past the end fails this and every
+// later read.
+class reader {
+    public:
+        reader(const char* begin, const char* end) : p(begin), end(end) {}
+
+        bool ok() const { return good; }
+
+        template <class T>
+        bool pod(T& value) {
+            if (!good || static_cast<size_t>(end - p) < sizeof(T))
+                return good = false;
+            std::memcpy(&value, p, sizeof(T));
+            p += sizeof(T);
+            return true;
+        }
+
+        template <class T>
+        bool array(std::vector<T>& values) {
+            uint64_t count;
+            if (!pod(count) || count > static_cast<uint64_t>(end - p) / sizeof(T))
+                return good = false;
+            values.resize(count);
+            if (count > 0)
+                std::memcpy(values.data(), p, count * sizeof(T));
+            p += count * sizeof(T);
+            return true;
+        }
+
+        bool bounds(aabb& box) {
+            point3 lo, hi;
+            for (int a = 0; a < 3; a++) pod(lo[a]);
+            for (int a = 0; a < 3; a++) pod(hi[a]);
+            box = aabb(lo, hi);
+            return good;
+        }
+
+    private:
+        const char* p;
+        const char* end;
+        bool good = true;
+};
+
+template <class Rect>
+std::vector<rect_record> rect_records(const std::vector<Rect>& rects, real Rect::*a0, real Rect::*a1,
+                                      real Rect::*b0, real Rect::*b1) {
+    std::vector<rect_record> records;
+    records.reserve(rects.size());
+    for (const auto& r : rects)
+        records.push_back({r.*a0, r.*a1, r.*b0, r.*b1, r.k, r.mat_id});
+    return records;
+}
+
+// Whether traversal of nodes stays in bounds and ends: every interior child a
+// later node, no deeper than the traversal stack allows, and every leaf a run
+// of the primitive_count leaf primitives.
+template <int N>
+bool valid_nodes(const std::vector<wide_bvh_node<N>>& nodes, size_t primitive_count) {
+    const int max_depth = wide_bvh<N>::max_stack / N;
+    std::vector<int> depth(nodes.size(), 0);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        const auto& node = nodes[i];
+        if (node.num_children > N)
+            return false;
+        for (int k = 0; k < node.num_children; k++) {
+            int64_t child = node.child[k];
+            if (node.count[k] > 0) {
+                if (child < 0 || static_cast<uint64_t>(child) + node.count[k] > primitive_count)
+                    return false;
+            } else {
+                if (child <= static_cast<int64_t>(i) || static_cast<uint64_t>(child) >= nodes.size()
+                    || depth[i] + 1 >= max_depth)
+                    return false;
+                depth[child] = depth[i] + 1;
+            }
+        }
+    }
+    return true;
+}
+
+// Whether every triangle of mesh names vertices it has, and its normals and uvs
+// are either absent or one per vertex.
+inline bool valid_mesh(const mesh_data& mesh) {
+    const size_t vertex_count = mesh.vertex_count();
+    if (mesh.positions.size() % 3 != 0 || mesh.indices.size() % 3 != 0
+        || (!mesh.normals.empty() && mesh.normals.size() != mesh.positions.size())
+        || (!mesh.uvs.empty() && mesh.uvs.size() != 2 * vertex_count))
+        return false;
+    for (uint32_t index : mesh.indices)
+        if (index >= vertex_count)
+            return false;
+    return true;
+}
+
+// Whether every record names one of the material_count materials.
+template <class Record>
+bool valid_materials(const std::vector<Record>& records, size_t material_count) {
+    for (const auto& r : records)
+        if (r.mat_id >= material_count)
+            return false;
+    return true;
+}
+
+} // namespace scene_cache
+
+
+// Writes the compiled form of a scene. Returns false, having said why, when the
+// scene holds something the cache cannot store or the file cannot be written.
+bool write_scene_cache(const std::string& path, const camera_settings& view,
+                       const material_table& materials, const compiled_scene<4>& world) {
+    using namespace scene_cache;
+
+    std::vector<material_record> material_records;
+    for (const auto& m : materials.materials) {
+        material_record record = {};
+        if (auto l = dynamic_cast<const lambertian*>(m.get())) {
+            record = {0, {l->albedo.x(), l->albedo.y(), l->albedo.z(), 0}};
+        } else if (auto mt = dynamic_cast<const metal*>(m.get())) {
+            record = {1, {mt->albedo.x(), mt->albedo.y(), mt->albedo.z(), mt->fuzz}};
+        } else if (auto d = dynamic_cast<const dielectric*>(m.get())) {
+            record = {2, {d->ir, 0, 0, 0}};
+        } else {
+            std::cerr << path << ": cannot cache material " << typeid(*m).name() << '\n';
+            return false;
+        }
+        material_records.push_back(record);
+    }
+
+    std::vector<const triangle_mesh*> meshes;
+    std::unordered_map<const triangle_mesh*, uint32_t> mesh_ids;
+    std::vector<other_record> others;
+    for (const auto& object : world.others) {
+        other_record record = {};
+        const hittable* geometry = object.get();
+        if (auto i = dynamic_cast<const instance*>(geometry)) {
+            record.instanced = 1;
+            std::memcpy(record.to_world, i->to_world.m, sizeof(record.to_world));
+            geometry = i->object.get();
+        }
+        auto mesh = dynamic_cast<const triangle_mesh*>(geometry);
+        if (!mesh) {
+            std::cerr << path << ": cannot cache " << typeid(*geometry).name() << '\n';
+            return false;
+        }
+        auto found = mesh_ids.find(mesh);
+        if (found == mesh_ids.end()) {
+            found = mesh_ids.emplace(mesh, static_cast<uint32_t>(meshes.size())).first;
+            meshes.push_back(mesh);
+        }
+        record.mesh = found->second;
+        others.push_back(record);
+    }
+
+    std::vector<sphere_record> spheres;
+    spheres.reserve(world.spheres.size());
+    for (const auto& s : world.spheres)
+        spheres.push_back({{s.center.x(), s.center.y(), s.center.z()}, s.radius, s.mat_id});
+
+    std::vector<sphere_record> set_spheres;
+    std::vector<uint32_t> set_sizes;
+    for (const auto& set : world.sphere_sets) {
+        set_sizes.push_back(static_cast<uint32_t>(set.size()));
+        for (size_t i = 0; i < set.size(); i++)
+            set_spheres.push_back({{set.center_x[i], set.center_y[i], set.center_z[i]}, set.radius[i], set.mat_ids[i]});
+    }
+
+    std::vector<box_record> boxes;
+    boxes.reserve(world.boxes.size());
+    for (const auto& b : world.boxes)
+        boxes.push_back({{b.box_min.x(), b.box_min.y(), b.box_min.z()}, {b.box_max.x(), b.box_max.y(), b.box_max.z()}, b.mat_id});
+
+    writer out(path);
+    if (!out.ok()) {
+        std::cerr << "Could not write " << path << '\n';
+        return false;
+    }
+
+    header h;
+    std::memcpy(h.magic, magic, sizeof(magic));
+    h.version = version;
+    h.node_size = sizeof(wide_bvh_node<4>);
+    h.real_size = sizeof(real);
+    out.pod(h);
+
+    double camera[10] = { view.lookfrom.x(), view.lookfrom.y(), view.lookfrom.z(),
+                          view.lookat.x(), view.lookat.y(), view.lookat.z(),
+                          view.vup.x(), view.vup.y(), view.vup.z(), view.vfov };
+    out.pod(camera);
+    out.array(material_records);
+
+    out.pod(static_cast<uint64_t>(meshes.size()));
+    for (const auto* mesh : meshes) {
+        out.pod(mesh->mat_id);
+        out.bounds(mesh->bvh.bounds);
+        out.array(mesh->mesh.positions);
+        out.array(mesh->mesh.normals);
+        out.array(mesh->mesh.uvs);
+        out.array(mesh->mesh.indices);
+        out.array(mesh->bvh.nodes);
+    }
+
+    out.bounds(world.bvh.bounds);
+    out.array(world.bvh.nodes);
+    out.array(world.leaf_refs);
+    out.array(spheres);
+    out.array(set_sizes);
+    out.array(set_spheres);
+    out.array(rect_records(world.xy_rects, &xy_rect::x0, &xy_rect::x1, &xy_rect::y0, &xy_rect::y1));
+    out.array(rect_records(world.xz_rects, &xz_rect::x0, &xz_rect::x1, &xz_rect::z0, &xz_rect::z1));
+    out.array(rect_records(world.yz_rects, &yz_rect::y0, &yz_rect::y1, &yz_rect::z0, &yz_rect::z1));
+    out.array(boxes);
+    out.array(others);
+
+    if (!out.ok()) {
+        std::cerr << "Could not write " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+
+// Replaces view, materials and world by the contents of a cache file.
+bool load_scene_cache(const std::string& path, camera_settings& view,
+                      material_table& materials, compiled_scene<4>& world) {
+    using namespace scene_cache;
+
+    mapped_file file(path);
+    if (!file.ok()) {
+        std::cerr << "Could not read " << path << '\n';
+        return false;
+    }
+    reader in(file.begin(), file.end());
+
+    header h;
+    if (!in.pod(h) || std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.version != version
+        || h.node_size != sizeof(wide_bvh_node<4>) || h.real_size != sizeof(real)) {
+        std::cerr << path << ": not a scene cache written by this build\n";
+        return false;
+    }
+
+    double camera[10];
+    in.pod(camera);
+    view.lookfrom = point3(camera[0], camera[1], camera[2]);
+    view.lookat = point3(camera[3], camera[4], camera[5]);
+    view.vup = vec3(camera[6], camera[7], camera[8]);
+    view.vfov = camera[9];
+
+    std::vector<material_record> material_records;
+    in.array(material_records);
+    materials = material_table();
+    for (const auto& m : material_records) {
+        color albedo(m.values[0], m.values[1], m.values[2]);
+        if (m.type == 0)
+            materials.add(make_shared<lambertian>(albedo));
+        else if (m.type == 1)
+            materials.add(make_shared<metal>(albedo, m.values[3]));
+        else if (m.type == 2)
+            materials.add(make_shared<dielectric>(m.values[0]));
+        else {
+            std::cerr << path << ": bad material in scene cache\n";
+            return false;
+        }
+    }
+
+    uint64_t mesh_count = 0;
+    in.pod(mesh_count);
+    std::vector<shared_ptr<triangle_mesh>> meshes;
+    for (uint64_t i = 0; i < mesh_count && in.ok(); i++) {
+        auto mesh = make_shared<triangle_mesh>();
+        in.pod(mesh->mat_id);
+        in.bounds(mesh->bvh.bounds);
+        in.array(mesh->mesh.positions);
+        in.array(mesh->mesh.normals);
+        in.array(mesh->mesh.uvs);
+        in.array(mesh->mesh.indices);
+        in.array(mesh->bvh.nodes);
+        if (in.ok() && (mesh->mat_id >= materials.size() || !valid_mesh(mesh->mesh)
+                        || !valid_nodes(mesh->bvh.nodes, mesh->triangle_count()))) {
+            std::cerr << path << ": bad mesh in scene cache\n";
+            return false;
+        }
+        meshes.push_back(mesh);
+    }
+
+    world = compiled_scene<4>();
+    in.bounds(world.bvh.bounds);
+    in.array(world.bvh.nodes);
+    in.array(world.leaf_refs);
+
+    std::vector<sphere_record> spheres, set_spheres;
+    std::vector<uint32_t> set_sizes;
+    std::vector<rect_record> xy, xz, yz;
+    std::vector<box_record> boxes;
+    std::vector<other_record> others;
+    in.array(spheres);
+    in.array(set_sizes);
+    in.array(set_spheres);
+    in.array(xy);
+    in.array(xz);
+    in.array(yz);
+    in.array(boxes);
+    in.array(others);
+    if (!in.ok()) {
+        std::cerr << path << ": truncated scene cache\n";
+        return false;
+    }
+
+    // Every leaf must name an element of its array.
+    size_t sizes[] = { spheres.size(), set_sizes.size(), xy.size(), xz.size(), yz.size(), boxes.size(), others.size() };
+    for (const auto& ref : world.leaf_refs) {
+        if (ref.kind > primitive_ref::other_kind || ref.index >= sizes[ref.kind]) {
+            std::cerr << path << ": bad leaf reference in scene cache\n";
+            return false;
+        }
+    }
+    if (!valid_nodes(world.bvh.nodes, world.leaf_refs.size())) {
+        std::cerr << path << ": bad BVH node in scene cache\n";
+        return false;
+    }
+
+    // Every primitive must name a material, and the sets must share out exactly
+    // the spheres stored for them.
+    uint64_t set_total = 0;
+    for (uint32_t size : set_sizes)
+        set_total += size;
+    if (set_total != set_spheres.size()) {
+        std::cerr << path << ": bad sphere_set sizes in scene cache\n";
+        return false;
+    }
+    if (!valid_materials(spheres, materials.size()) || !valid_materials(set_spheres, materials.size())
+        || !valid_materials(xy, materials.size()) || !valid_materials(xz, materials.size())
+        || !valid_materials(yz, materials.size()) || !valid_materials(boxes, materials.size())) {
+        std::cerr << path << ": bad material reference in scene cache\n";
+        return false;
+    }
+
+    world.spheres.reserve(spheres.size());
+    for (const auto& s : spheres)
+        world.spheres.emplace_back(point3(s.center[0], s.center[1], s.center[2]), s.radius, s.mat_id);
+
+    size_t next = 0;
+    for (uint32_t size : set_sizes) {
+        sphere_set set;
+        for (uint32_t i = 0; i < size; i++, next++) {
+            const auto& s = set_spheres[next];
+            set.add(point3(s.center[0], s.center[1], s.center[2]), s.radius, s.mat_id);
+        }
+        world.sphere_sets.push_back(std::move(set));
+    }
+
+    for (const auto& r : xy) world.xy_rects.emplace_back(r.a0, r.a1, r.b0, r.b1, r.k, r.mat_id);
+    for (const auto& r : xz) world.xz_rects.emplace_back(r.a0, r.a1, r.b0, r.b1, r.k, r.mat_id);
+    for (const auto& r : yz) world.yz_rects.emplace_back(r.a0, r.a1, r.b0, r.b1, r.k, r.mat_id);
+    for (const auto& b : boxes)
+        world.boxes.emplace_back(point3(b.min[0], b.min[1], b.min[2]), point3(b.max[0], b.max[1], b.max[2]), b.mat_id);
+
+    for (const auto& o : others) {
+        if (o.mesh >= meshes.size()) {
+            std::cerr << path << ": bad mesh reference in scene cache\n";
+            return false;
+        }
+        if (o.instanced) {
+            affine_transform to_world;
+            std::memcpy(to_world.m, o.to_world, sizeof(to_world.m));
+            world.others.push_back(make_shared<instance>(meshes[o.mesh], to_world));
+        } else {
+            world.others.push_back(meshes[o.mesh]);
+        }
+    }
+    return true;
+}
+
+#endif /* scene_cache_h */
@@ -0,0 +1,271 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef scene_file_h
+#define scene_file_h
+
+#include "aarect.h"
+#include "box.h"
+#include "hittable_list.h"
+#include "instance.h"
+#include "material.h"
+#include "mesh_loader.h"
+#include "sphere.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// Where the camera stands; main adds the aspect ratio of the image.
+struct camera_settings {
+    point3 lookfrom = point3(6, 10, 12);
+    point3 lookat = point3(0, 0, 0);
+    vec3 vup = vec3(0, 1, 0);
+    double vfov = 20;
+};
+
+
+// Text scenes, one statement per line, # to the end of a line is a comment:
+//
+//   camera lookfrom 6 10 12 lookat 0 0 0 vup 0 1 0 vfov 20
+//   material ground lambertian 0.5 0.5 0.5
+//   material mirror metal 0.7 0.6 0.5 0.1          (albedo, fuzz)
+//   material glass dielectric 1.5                 (index of refraction)
+//   sphere 0 1 0 1 glass                          (center, radius, material)
+//   box -1 0 -1 1 2 1 mirror                      (two corners, material)
+//   xy_rect 0 1 0 1 -2 ground                     (x0 x1 y0 y1 k; xz_rect, yz_rect alike)
+//   mesh bunny bunny.ply ground                   (a name for the geometry, .obj or .ply)
+//   instance bunny scale 2 2 2 rotate 0 1 0 45 translate 1 0 0
+//
+// Materials are named before use. A mesh is only geometry until instances place
+// it; their transforms apply in the order written. Mesh paths are relative to the
+// scene file. The file is mapped and scanned in place, like the mesh loaders.
+class scene_parser {
+    public:
+        scene_parser(const std::string& path, scene& out, camera_settings& view,
+                     const bvh_build_options& build)
+            : path(path), out(out), view(view), build(build) {}
+
+        bool parse();
+
+    private:
+        bool statement(const char* keyword, size_t length);
+        bool word(std::string& out_word);
+        bool number(double& value);
+        bool point(point3& p);
+        bool material_ref(uint32_t& id);
+        bool fail(const char* message);
+
+        const std::string& path;
+        scene& out;
+        camera_settings& view;
+        bvh_build_options build;
+        const char* p = nullptr;
+        const char* end = nullptr;
+        long line = 0;
+
+        std::unordered_map<std::string, uint32_t> materials;
+        std::unordered_map<std::string, shared_ptr<triangle_mesh>> meshes;
+};
+
+
+bool scene_parser::fail(const char* message) {
+    std::cerr << path << ":" << line << ": " << message << '\n';
+    return false;
+}
+
+bool scene_parser::word(std::string& out_word) {
+    skip_blanks(p, end);
+    const char* start = p;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n' && *p != '#')
+        p++;
+    out_word.assign(start, static_cast<size_t>(p - start));
+    return p > start;
+}
+
+bool scene_parser::number(double& value) {
+    return parse_double(p, end, value) || fail("expected a number");
+}
+
+bool scene_parser::point(point3& v) {
+    double x, y, z;
+    if (!(number(x) && number(y) && number(z)))
+        return false;
+    v = point3(x, y, z);
+    return true;
+}
+
+bool scene_parser::material_ref(uint32_t& id) {
+    std::string name;
+    if (!word(name))
+        return fail("expected a material name");
+    auto found = materials.find(name);
+    if (found == materials.end())
+        return fail(("unknown material " + name).c_str());
+    id = found->second;
+    return true;
+}
+
+
+bool scene_parser::parse() {
+    mapped_file file(path);
+    if (!file.ok()) {
+        std::cerr << "Could not read " << path << '\n';
+        return false;
+    }
+    p = file.begin();
+    end = file.end();
+
+    while (p < end) {
+        line++;
+        skip_blanks(p, end);
+        const char* keyword = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n' && *p != '#')
+            p++;
+        if (p > keyword && !statement(keyword, static_cast<size_t>(p - keyword)))
+            return false;
+
+        skip_blanks(p, end);
+        if (p < end && *p != '\n' && *p != '#')
+            return fail("unexpected text at the end of the line");
+        skip_line(p, end);
+    }
+    return true;
+}
+
+
+bool scene_parser::statement(const char* keyword, size_t length) {
+    auto is = [&](const char* s) { return length == std::strlen(s) && std::memcmp(keyword, s, length) == 0; };
+
+    if (is("camera")) {
+        std::string key;
+        while (word(key)) {
+            bool ok = key == "lookfrom" ? point(view.lookfrom)
+                    : key == "lookat" ? point(view.lookat)
+                    : key == "vup" ? point(view.vup)
+                    : key == "vfov" ? number(view.vfov)
+                    : fail(("unknown camera setting " + key).c_str());
+            if (!ok)
+                return false;
+        }
+        return true;
+    }
+
+    if (is("material")) {
+        std::string name, type;
+        if (!word(name) || !word(type))
+            return fail("expected a material name and type");
+        shared_ptr<material> m;
+        color albedo;
+        double value;
+        if (type == "lambertian") {
+            if (!point(albedo)) return false;
+            m = make_shared<lambertian>(albedo);
+        } else if (type == "metal") {
+            if (!point(albedo) || !number(value)) return false;
+            m = make_shared<metal>(albedo, value);
+        } else if (type == "dielectric") {
+            if (!number(value)) return false;
+            m = make_shared<dielectric>(value);
+        } else {
+            return fail(("unknown material type " + type).c_str());
+        }
+        materials[name] = out.materials.add(m);
+        return true;
+    }
+
+    if (is("sphere")) {
+        point3 center;
+        double radius;
+        uint32_t mat;
+        if (!point(center) || !number(radius) || !material_ref(mat))
+            return false;
+        out.objects.add(make_shared<sphere>(center, radius, mat));
+        return true;
+    }
+
+    if (is("box")) {
+        point3 p0, p1;
+        uint32_t mat;
+        if (!point(p0) || !point(p1) || !material_ref(mat))
+            return false;
+        out.objects.add(make_shared<box>(p0, p1, mat));
+        return true;
+    }
+
+    if (is("xy_rect") || is("xz_rect") || is("yz_rect")) {
+        double a0, a1, b0, b1, k;
+        uint32_t mat;
+        if (!number(a0) || !number(a1) || !number(b0) || !number(b1) || !number(k) || !material_ref(mat))
+            return false;
+        if (is("xy_rect"))
+            out.objects.add(make_shared<xy_rect>(a0, a1, b0, b1, k, mat));
+        else if (is("xz_rect"))
+            out.objects.add(make_shared<xz_rect>(a0, a1, b0, b1, k, mat));
+        else
+            out.objects.add(make_shared<yz_rect>(a0, a1, b0, b1, k, mat));
+        return true;
+    }
+
+    if (is("mesh")) {
+        std::string name, file;
+        uint32_t mat;
+        if (!word(name) || !word(file))
+            return fail("expected a mesh name and file");
+        if (!material_ref(mat))
+            return false;
+        if (file[0] != '/') {
+            auto slash = path.find_last_of('/');
+            if (slash != std::string::npos)
+                file = path.substr(0, slash + 1) + file;
+        }
+        mesh_data data;
+        if (!load_mesh(file, data))
+            return fail("could not load the mesh");
+        meshes[name] = make_shared<triangle_mesh>(std::move(data), mat, nullptr, build);
+        return true;
+    }
+
+    if (is("instance")) {
+        std::string name, op;
+        if (!word(name))
+            return fail("expected a mesh name");
+        auto found = meshes.find(name);
+        if (found == meshes.end())
+            return fail(("unknown mesh " + name).c_str());
+
+        auto to_world = affine_transform::identity();
+        while (word(op)) {
+            vec3 v;
+            double degrees;
+            if (op == "translate") {
+                if (!point(v)) return false;
+                to_world = affine_transform::translation(v) * to_world;
+            } else if (op == "scale") {
+                if (!point(v)) return false;
+                to_world = affine_transform::scaling(v) * to_world;
+            } else if (op == "rotate") {
+                if (!point(v) || !number(degrees)) return false;
+                to_world = affine_transform::rotation(v, degrees) * to_world;
+            } else {
+                return fail(("unknown transform " + op).c_str());
+            }
+        }
+        out.objects.add(make_shared<instance>(found->second, to_world));
+        return true;
+    }
+
+    return fail("unknown statement");
+}
+
+
+// Reads a scene file into out, with the camera it sets in view. Returns false,
+// having said why, on any error.
+bool load_scene_file(const std::string& path, scene& out, camera_settings& view,
+                     const bvh_build_options& build = bvh_build_options()) {
+    return scene_parser(path, out, view, build).parse();
+}
+
+#endif /* scene_file_h */
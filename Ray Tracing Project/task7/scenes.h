@@ -0,0 +1,195 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef scenes_h
+#define scenes_h
+
+#include "box.h"
+#include "hittable_list.h"
+#include "instance.h"
+#include "mesh_loader.h"
+#include "material.h"
+#include "sampler.h"
+#include "sphere.h"
+
+scene pyramid() {
+    scene world;
+    sampler rng(2020);
+    auto ground_material = world.materials.add(make_shared<lambertian>(color(0.5, 0.5, 0.5)));
+    world.objects.add(make_shared<box>(point3(-15,-3,-15),point3(15,0,15),ground_material));
+    
+    for(double k=0.2;k<3;k+=0.4)
+    {
+        for(double i=-3+k;i<3-k;i+=0.4)
+        {
+            for(double j=-3+k;j<3-k;)
+            {
+                j+=0.4;
+                point3 center(i,k,j);
+                auto randomColor = color::random(rng) * color::random(rng);
+                auto material = world.materials.add(make_shared<lambertian>(randomColor));
+                world.objects.add(make_shared<box>(point3(center.x()-0.2,center.y()-0.2,center.z()-0.2),point3(center.x()+0.2,center.y()+0.2,center.z()+0.2),material));
+            }
+        }
+    }
+    
+    
+    return world;
+    
+}
+
+// The three boxes of task3.
+scene three_boxes() {
+    scene world;
+    auto red   = world.materials.add(make_shared<lambertian>(color(0.7, 0.1, 0.1)));
+    auto green = world.materials.add(make_shared<lambertian>(color(0.1, 0.5, 0.15)));
+    auto blue = world.materials.add(make_shared<lambertian>(color(0.1, 0.5, 1)));
+    world.objects.add(make_shared<box>(point3(0,0,-1),point3(0.5,0.5,-0.5),red));
+    world.objects.add(make_shared<box>(point3(0.6,0,-1.6),point3(1.6,0.5,-1.1),green));
+    world.objects.add(make_shared<box>(point3(-0.6,0,-0.4),point3(-0.1,1,0.1),blue));
+
+    return world;
+}
+
+// The sphere field of task6, with lambertian spheres where task6 has lights since
+// this renderer has no emitters.
+scene random_spheres() {
+    scene world;
+    sampler rng(2020);
+
+    auto ground_material = world.materials.add(make_shared<lambertian>(color(0.7, 0.2, 0.3)));
+    world.objects.add(make_shared<sphere>(point3(0,-1000,0), 1000, ground_material));
+
+    for (int a = -11; a < 11; a++) {
+        for (int b = -11; b < 11; b++) {
+            auto choose_mat = rng.random_double();
+            point3 center(a + 0.9*rng.random_double(), 0.2, b + 0.9*rng.random_double());
+
+            if ((center - point3(4, 0.2, 0)).length() > 0.9) {
+                uint32_t sphere_material;
+
+                if (choose_mat < 0.8) {
+                    // diffuse
+                    auto albedo = color::random(rng) * color::random(rng);
+                    sphere_material = world.materials.add(make_shared<lambertian>(albedo));
+                    world.objects.add(make_shared<sphere>(center, 0.2, sphere_material));
+                } else if (choose_mat < 0.95) {
+                    // metal
+                    auto albedo = color::random(rng, 0.5, 1);
+                    auto fuzz = rng.random_double(0, 0.5);
+                    sphere_material = world.materials.add(make_shared<metal>(albedo, fuzz));
+                    world.objects.add(make_shared<sphere>(center, 0.2, sphere_material));
+                } else {
+                    // glass
+                    sphere_material = world.materials.add(make_shared<dielectric>(1.5));
+                    world.objects.add(make_shared<sphere>(center, 0.2, sphere_material));
+                }
+            }
+        }
+    }
+
+    auto material1 = world.materials.add(make_shared<lambertian>(color(0.2, 0.2, 0.7)));
+    world.objects.add(make_shared<sphere>(point3(-5, 1.5, 0), 1.5, material1));
+
+    auto material2 = world.materials.add(make_shared<metal>(color(0.7, 0.6, 0.5), 0.0));
+    world.objects.add(make_shared<sphere>(point3(-1, 1.5, 0), 1.5, material2));
+
+    auto material3 = world.materials.add(make_shared<dielectric>(0.9));
+    world.objects.add(make_shared<sphere>(point3(2, 1, 0), 1, material3));
+    auto material4 = world.materials.add(make_shared<dielectric>(1.1));
+    world.objects.add(make_shared<sphere>(point3(5, 1, 0), 1, material4));
+    auto material5 = world.materials.add(make_shared<dielectric>(2.5));
+    world.objects.add(make_shared<sphere>(point3(8, 1, 0), 1, material5));
+
+    return world;
+}
+
+// The nine spheres of task1, which had no materials, in a neutral grey.
+scene task1_spheres() {
+    scene world;
+    auto grey = world.materials.add(make_shared<lambertian>(color(0.5, 0.5, 0.5)));
+    const double spheres[9][4] = {
+        {0, 0.4, -1.4, 0.3}, {0, 0.1, -1, 0.2}, {0, 0, -0.6, 0.1},
+        {0.8, 0.4, -1.4, 0.3}, {0.8, 0.1, -1, 0.2}, {0.8, -0.2, -0.9, 0.1},
+        {-0.8, 0.4, -1.4, 0.3}, {-0.8, 0.1, -1, 0.2}, {-0.8, -0.2, -0.6, 0.1},
+    };
+    for (const auto& s : spheres)
+        world.objects.add(make_shared<sphere>(point3(s[0], s[1], s[2]), s[3], grey));
+    return world;
+}
+
+// The row of dielectric spheres of task5, on its diamond ground.
+scene dielectric_spheres() {
+    scene world;
+    auto yellow = world.materials.add(make_shared<lambertian>(color(0.8, 0.8, 0)));
+    auto purple = world.materials.add(make_shared<lambertian>(color(0.2, 0.1, 0.6)));
+    auto green_mirror = world.materials.add(make_shared<metal>(color(0.2, 0.6, 0.2), 0));
+    auto ice = world.materials.add(make_shared<dielectric>(1.31));
+    auto diamond = world.materials.add(make_shared<dielectric>(2.417));
+    auto air = world.materials.add(make_shared<dielectric>(1.01));
+    auto dense = world.materials.add(make_shared<dielectric>(10));
+
+    world.objects.add(make_shared<sphere>(point3(-3.0, 0, -3.0), 0.5, purple));
+    world.objects.add(make_shared<sphere>(point3(-2.0, 0, -3.0), 0.5, ice));
+    world.objects.add(make_shared<sphere>(point3(-1.0, 0, -3.0), 0.5, yellow));
+    world.objects.add(make_shared<sphere>(point3(0, 0, -3.0), 0.5, diamond));
+    world.objects.add(make_shared<sphere>(point3(1.0, 0, -3.0), 0.5, green_mirror));
+    world.objects.add(make_shared<sphere>(point3(2.0, 0, -3.0), 0.5, air));
+    world.objects.add(make_shared<sphere>(point3(3.0, 0, -3.0), 0.5, purple));
+    world.objects.add(make_shared<sphere>(point3(-1.0, 1.0, -3.0), 0.5, dense));
+    world.objects.add(make_shared<sphere>(point3(0, -100.5, -1), 100, diamond));
+    return world;
+}
+
+// side x side small spheres jittered on a grid in the unit square around the
+// origin, on a ground plane, with a few materials in turn: a scene whose size
+// alone can be dialled up.
+scene sphere_grid(int side) {
+    scene world;
+    sampler rng(2020);
+    auto ground = world.materials.add(make_shared<lambertian>(color(0.5, 0.5, 0.5)));
+    uint32_t materials[] = {
+        world.materials.add(make_shared<lambertian>(color(0.7, 0.2, 0.3))),
+        world.materials.add(make_shared<lambertian>(color(0.2, 0.3, 0.7))),
+        world.materials.add(make_shared<metal>(color(0.7, 0.6, 0.5), 0.1)),
+        world.materials.add(make_shared<dielectric>(1.5)),
+    };
+
+    world.objects.add(make_shared<box>(point3(-2, -1, -2), point3(2, 0, 2), ground));
+    const double spacing = 2.0 / side;
+    for (int i = 0; i < side; i++)
+        for (int k = 0; k < side; k++) {
+            point3 center(-1 + spacing * (i + 0.2 + 0.6 * rng.random_double()), 0.4 * spacing,
+                          -1 + spacing * (k + 0.2 + 0.6 * rng.random_double()));
+            world.objects.add(make_shared<sphere>(center, 0.4 * spacing, materials[(i + k) % 4]));
+        }
+    return world;
+}
+
+// A mesh file on the pyramid's ground, scaled to 4 units across and standing on
+// it. Only the ground is left when the file cannot be loaded.
+scene mesh_scene(const std::string& path, const bvh_build_options& build = bvh_build_options()) {
+    scene world;
+    auto ground_material = world.materials.add(make_shared<lambertian>(color(0.5, 0.5, 0.5)));
+    world.objects.add(make_shared<box>(point3(-15,-3,-15),point3(15,0,15),ground_material));
+
+    mesh_data data;
+    if (!load_mesh(path, data))
+        return world;
+
+    auto material = world.materials.add(make_shared<lambertian>(color(0.8, 0.3, 0.2)));
+    auto mesh = make_shared<triangle_mesh>(std::move(data), material, nullptr, build);
+    aabb bounds;
+    if (!mesh->bounding_box(0, 1, bounds))
+        return world;
+
+    vec3 extent = bounds.max() - bounds.min();
+    double scale = 4 / fmax(extent.x(), fmax(extent.y(), extent.z()));
+    point3 base(0.5 * (bounds.min().x() + bounds.max().x()), bounds.min().y(), 0.5 * (bounds.min().z() + bounds.max().z()));
+    world.objects.add(make_shared<instance>(mesh,
+        affine_transform::scaling(vec3(scale, scale, scale)) * affine_transform::translation(-base)));
+    return world;
+}
+
+#endif /* scenes_h */
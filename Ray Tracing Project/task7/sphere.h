@@ -4,50 +4,87 @@
 
 #ifndef sphere_h
 #define sphere_h
-#include "hittable.h"
+#include "hittable_list.h"
 #include "vec3.h"
 
+#include <utility>
+
 class sphere : public hittable {
     public:
         sphere() {}
-        sphere(point3 cen, double r) : center(cen), radius(r) {};
+        sphere(point3 cen, real r, uint32_t m)
+            : center(cen), radius(r), mat_id(m) {};
 
         virtual bool hit(
             const ray& r, double tmin, double tmax, hit_record& rec) const override;
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
 
     public:
         point3 center;
-        double radius;
+        real radius;
+        uint32_t mat_id;
 };
 
+
+// The roots of |o + t d - center|^2 = radius^2 for a ray o + t d, nearest first,
+// worked out so that single precision holds up (after Haines et al., Ray Tracing
+// Gems, ch. 7). half_b^2 - a*c cancels between two huge squares when the sphere
+// is large or far; its equal a*radius^2 - |l|^2 / a, with l a times the offset
+// from center to the closest point of the line, does not. A miss is told from
+// the sign of that times a, without dividing; each root is found without
+// subtracting nearly equal numbers. Returns false when the line misses.
+template <class T>
+inline bool sphere_roots(const vec3_t<T>& oc, const vec3_t<T>& dir, T a, T radius_squared, T& near, T& far) {
+    T half_b = dot(oc, dir);
+    vec3_t<T> l = a*oc - half_b*dir;
+    T scaled_discriminant = a*a*radius_squared - l.length_squared();
+    if (!(scaled_discriminant > 0))
+        return false;
+
+    T root = sqrt(scaled_discriminant / a);
+    T q = half_b > 0 ? -half_b - root : -half_b + root;
+    T c = oc.length_squared() - radius_squared;
+    near = q / a;
+    far = c / q;
+    if (near > far)
+        std::swap(near, far);
+    return true;
+}
+
+// Fills in rec for a hit at t, with p put back on the sphere: r.at(t) carries the
+// error of t, which grows with the distance travelled, while the error of the
+// projected point only depends on where the sphere is.
+template <class T>
+inline void sphere_hit_record(const ray_t<T>& r, const vec3_t<T>& center, T radius, uint32_t mat_id, double t,
+                              hit_record& rec) {
+    vec3_t<T> outward_normal = unit_vector(r.at(t) - center);
+    rec.t = t;
+    rec.p = center + radius * outward_normal;
+    rec.error = rounding_error<T>(6) * (max_abs_component(center) + radius);
+    rec.set_face_normal(r, outward_normal);
+    rec.mat_id = mat_id;
+}
+
 bool sphere::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
-    vec3 oc = r.origin() - center;
-    auto a = r.direction().length_squared();
-    auto half_b = dot(oc, r.direction());
-    auto c = oc.length_squared() - radius*radius;
-    auto discriminant = half_b*half_b - a*c;
-
-    if (discriminant > 0) {
-        auto root = sqrt(discriminant);
-
-        auto temp = (-half_b - root) / a;
-        if (temp < t_max && temp > t_min) {
-            rec.t = temp;
-            rec.p = r.at(rec.t);
-            rec.normal = (rec.p - center) / radius;
-            return true;
-        }
-
-        temp = (-half_b + root) / a;
-        if (temp < t_max && temp > t_min) {
-            rec.t = temp;
-            rec.p = r.at(rec.t);
-            rec.normal = (rec.p - center) / radius;
-            return true;
-        }
+    real near, far;
+    if (!sphere_roots(r.origin() - center, r.direction(), r.direction().length_squared(), radius*radius, near, far))
+        return false;
+
+    real t = near;
+    if (!(t < t_max && t > t_min)) {
+        t = far;
+        if (!(t < t_max && t > t_min))
+            return false;
     }
+    sphere_hit_record(r, center, radius, mat_id, t, rec);
+    return true;
+}
 
-    return false;
+bool sphere::bounding_box(double time0, double time1, aabb& output_box) const {
+    output_box = aabb(
+        center - vec3(radius, radius, radius),
+        center + vec3(radius, radius, radius));
+    return true;
 }
 
 #endif /* sphere_h */
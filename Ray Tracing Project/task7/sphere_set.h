@@ -0,0 +1,422 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef sphere_set_h
+#define sphere_set_h
+
+#include "bvh.h"
+#include "isa.h"
+#include "sphere.h"
+
+#include <cmath>
+#include <vector>
+
+
+#if RT_X86_SIMD
+// One SIMD register of reals and the operations sphere_set's kernel needs on it,
+// so the kernel is written once for every level and both precisions. mask is
+// what the comparisons give: the register itself up to AVX2, a bit mask on
+// AVX-512.
+template <class T> struct sse_reals;
+template <class T> struct avx_reals;
+template <class T> struct avx512_reals;
+
+template <> struct sse_reals<float> {
+    typedef __m128 type;
+    typedef __m128 mask;
+    static const int width = 4;
+    static type set1(float x) { return _mm_set1_ps(x); }
+    static type zero() { return _mm_setzero_ps(); }
+    static type load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, type x) { _mm_storeu_ps(p, x); }
+    static type add(type a, type b) { return _mm_add_ps(a, b); }
+    static type sub(type a, type b) { return _mm_sub_ps(a, b); }
+    static type mul(type a, type b) { return _mm_mul_ps(a, b); }
+    static type div(type a, type b) { return _mm_div_ps(a, b); }
+    static type sqrt(type a) { return _mm_sqrt_ps(a); }
+    static type min(type a, type b) { return _mm_min_ps(a, b); }
+    static type max(type a, type b) { return _mm_max_ps(a, b); }
+    static mask less(type a, type b) { return _mm_cmplt_ps(a, b); }
+    static mask greater(type a, type b) { return _mm_cmpgt_ps(a, b); }
+    static mask both(mask a, mask b) { return _mm_and_ps(a, b); }
+    static mask either(mask a, mask b) { return _mm_or_ps(a, b); }
+    static type select(mask m, type if_set, type if_clear) {
+        return _mm_or_ps(_mm_and_ps(m, if_set), _mm_andnot_ps(m, if_clear));
+    }
+    static int bits(mask m) { return _mm_movemask_ps(m); }
+};
+
+template <> struct sse_reals<double> {
+    typedef __m128d type;
+    typedef __m128d mask;
+    static const int width = 2;
+    static type set1(double x) { return _mm_set1_pd(x); }
+    static type zero() { return _mm_setzero_pd(); }
+    static type load(const double* p) { return _mm_loadu_pd(p); }
+    static void store(double* p, type x) { _mm_storeu_pd(p, x); }
+    static type add(type a, type b) { return _mm_add_pd(a, b); }
+    static type sub(type a, type b) { return _mm_sub_pd(a, b); }
+    static type mul(type a, type b) { return _mm_mul_pd(a, b); }
+    static type div(type a, type b) { return _mm_div_pd(a, b); }
+    static type sqrt(type a) { return _mm_sqrt_pd(a); }
+    static type min(type a, type b) { return _mm_min_pd(a, b); }
+    static type max(type a, type b) { return _mm_max_pd(a, b); }
+    static mask less(type a, type b) { return _mm_cmplt_pd(a, b); }
+    static mask greater(type a, type b) { return _mm_cmpgt_pd(a, b); }
+    static mask both(mask a, mask b) { return _mm_and_pd(a, b); }
+    static mask either(mask a, mask b) { return _mm_or_pd(a, b); }
+    static type select(mask m, type if_set, type if_clear) {
+        return _mm_or_pd(_mm_and_pd(m, if_set), _mm_andnot_pd(m, if_clear));
+    }
+    static int bits(mask m) { return _mm_movemask_pd(m); }
+};
+
+template <> struct avx_reals<float> {
+    typedef __m256 type;
+    typedef __m256 mask;
+    static const int width = 8;
+    RT_TARGET_AVX2 static type set1(float x) { return _mm256_set1_ps(x); }
+    RT_TARGET_AVX2 static type zero() { return _mm256_setzero_ps(); }
+    RT_TARGET_AVX2 static type load(const float* p) { return _mm256_loadu_ps(p); }
+    RT_TARGET_AVX2 static void store(float* p, type x) { _mm256_storeu_ps(p, x); }
+    RT_TARGET_AVX2 static type add(type a, type b) { return _mm256_add_ps(a, b); }
+    RT_TARGET_AVX2 static type sub(type a, type b) { return _mm256_sub_ps(a, b); }
+    RT_TARGET_AVX2 static type mul(type a, type b) { return _mm256_mul_ps(a, b); }
+    RT_TARGET_AVX2 static type div(type a, type b) { return _mm256_div_ps(a, b); }
+    RT_TARGET_AVX2 static type sqrt(type a) { return _mm256_sqrt_ps(a); }
+    RT_TARGET_AVX2 static type min(type a, type b) { return _mm256_min_ps(a, b); }
+    RT_TARGET_AVX2 static type max(type a, type b) { return _mm256_max_ps(a, b); }
+    RT_TARGET_AVX2 static mask less(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    RT_TARGET_AVX2 static mask greater(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    RT_TARGET_AVX2 static mask both(mask a, mask b) { return _mm256_and_ps(a, b); }
+    RT_TARGET_AVX2 static mask either(mask a, mask b) { return _mm256_or_ps(a, b); }
+    RT_TARGET_AVX2 static type select(mask m, type if_set, type if_clear) { return _mm256_blendv_ps(if_clear, if_set, m); }
+    RT_TARGET_AVX2 static int bits(mask m) { return _mm256_movemask_ps(m); }
+};
+
+template <> struct avx_reals<double> {
+    typedef __m256d type;
+    typedef __m256d mask;
+    static const int width = 4;
+    RT_TARGET_AVX2 static type set1(double x) { return _mm256_set1_pd(x); }
+    RT_TARGET_AVX2 static type zero() { return _mm256_setzero_pd(); }
+    RT_TARGET_AVX2 static type load(const double* p) { return _mm256_loadu_pd(p); }
+    RT_TARGET_AVX2 static void store(double* p, type x) { _mm256_storeu_pd(p, x); }
+    RT_TARGET_AVX2 static type add(type a, type b) { return _mm256_add_pd(a, b); }
+    RT_TARGET_AVX2 static type sub(type a, type b) { return _mm256_sub_pd(a, b); }
+    RT_TARGET_AVX2 static type mul(type a, type b) { return _mm256_mul_pd(a, b); }
+    RT_TARGET_AVX2 static type div(type a, type b) { return _mm256_div_pd(a, b); }
+    RT_TARGET_AVX2 static type sqrt(type a) { return _mm256_sqrt_pd(a); }
+    RT_TARGET_AVX2 static type min(type a, type b) { return _mm256_min_pd(a, b); }
+    RT_TARGET_AVX2 static type max(type a, type b) { return _mm256_max_pd(a, b); }
+    RT_TARGET_AVX2 static mask less(type a, type b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    RT_TARGET_AVX2 static mask greater(type a, type b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    RT_TARGET_AVX2 static mask both(mask a, mask b) { return _mm256_and_pd(a, b); }
+    RT_TARGET_AVX2 static mask either(mask a, mask b) { return _mm256_or_pd(a, b); }
+    RT_TARGET_AVX2 static type select(mask m, type if_set, type if_clear) { return _mm256_blendv_pd(if_clear, if_set, m); }
+    RT_TARGET_AVX2 static int bits(mask m) { return _mm256_movemask_pd(m); }
+};
+
+template <> struct avx512_reals<float> {
+    typedef __m512 type;
+    typedef __mmask16 mask;
+    static const int width = 16;
+    RT_TARGET_AVX512 static type set1(float x) { return _mm512_set1_ps(x); }
+    RT_TARGET_AVX512 static type zero() { return _mm512_setzero_ps(); }
+    RT_TARGET_AVX512 static type load(const float* p) { return _mm512_loadu_ps(p); }
+    RT_TARGET_AVX512 static void store(float* p, type x) { _mm512_storeu_ps(p, x); }
+    RT_TARGET_AVX512 static type add(type a, type b) { return _mm512_add_ps(a, b); }
+    RT_TARGET_AVX512 static type sub(type a, type b) { return _mm512_sub_ps(a, b); }
+    RT_TARGET_AVX512 static type mul(type a, type b) { return _mm512_mul_ps(a, b); }
+    RT_TARGET_AVX512 static type div(type a, type b) { return _mm512_div_ps(a, b); }
+    RT_TARGET_AVX512 static type sqrt(type a) { return _mm512_sqrt_ps(a); }
+    RT_TARGET_AVX512 static type min(type a, type b) { return _mm512_min_ps(a, b); }
+    RT_TARGET_AVX512 static type max(type a, type b) { return _mm512_max_ps(a, b); }
+    RT_TARGET_AVX512 static mask less(type a, type b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    RT_TARGET_AVX512 static mask greater(type a, type b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    RT_TARGET_AVX512 static mask both(mask a, mask b) { return a & b; }
+    RT_TARGET_AVX512 static mask either(mask a, mask b) { return a | b; }
+    RT_TARGET_AVX512 static type select(mask m, type if_set, type if_clear) { return _mm512_mask_blend_ps(m, if_clear, if_set); }
+    RT_TARGET_AVX512 static int bits(mask m) { return m; }
+};
+
+template <> struct avx512_reals<double> {
+    typedef __m512d type;
+    typedef __mmask8 mask;
+    static const int width = 8;
+    RT_TARGET_AVX512 static type set1(double x) { return _mm512_set1_pd(x); }
+    RT_TARGET_AVX512 static type zero() { return _mm512_setzero_pd(); }
+    RT_TARGET_AVX512 static type load(const double* p) { return _mm512_loadu_pd(p); }
+    RT_TARGET_AVX512 static void store(double* p, type x) { _mm512_storeu_pd(p, x); }
+    RT_TARGET_AVX512 static type add(type a, type b) { return _mm512_add_pd(a, b); }
+    RT_TARGET_AVX512 static type sub(type a, type b) { return _mm512_sub_pd(a, b); }
+    RT_TARGET_AVX512 static type mul(type a, type b) { return _mm512_mul_pd(a, b); }
+    RT_TARGET_AVX512 static type div(type a, type b) { return _mm512_div_pd(a, b); }
+    RT_TARGET_AVX512 static type sqrt(type a) { return _mm512_sqrt_pd(a); }
+    RT_TARGET_AVX512 static type min(type a, type b) { return _mm512_min_pd(a, b); }
+    RT_TARGET_AVX512 static type max(type a, type b) { return _mm512_max_pd(a, b); }
+    RT_TARGET_AVX512 static mask less(type a, type b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+    RT_TARGET_AVX512 static mask greater(type a, type b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+    RT_TARGET_AVX512 static mask both(mask a, mask b) { return a & b; }
+    RT_TARGET_AVX512 static mask either(mask a, mask b) { return a | b; }
+    RT_TARGET_AVX512 static type select(mask m, type if_set, type if_clear) { return _mm512_mask_blend_pd(m, if_clear, if_set); }
+    RT_TARGET_AVX512 static int bits(mask m) { return m; }
+};
+#endif
+
+
+// Spheres stored as structure-of-arrays, so one SIMD register holds the same
+// coordinate of as many spheres as it has lanes and a ray is tested against all
+// of them at once. The arrays are padded to a multiple of the widest level's
+// lanes with spheres no ray can hit, so a set built at one level can be traced
+// at any other. Works on its own as a list of spheres, or as a BVH leaf via
+// group_spheres().
+class sphere_set : public hittable {
+    public:
+        sphere_set() {}
+
+        void add(point3 center, real radius, uint32_t mat_id);
+        void add(const sphere& s) { add(s.center, s.radius, s.mat_id); }
+
+        size_t size() const { return mat_ids.size(); }
+
+        virtual bool hit(
+            const ray& r, double t_min, double t_max, hit_record& rec) const override {
+            return dispatch_isa([&](auto isa) { return hit(isa, r, t_min, t_max, rec); });
+        }
+
+        // The same with the kernel of the level of isa.
+        template <class Isa>
+        bool hit(Isa isa, const ray& r, double t_min, double t_max, hit_record& rec) const;
+
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
+
+        // How many spheres one register holds at a level: the set size that
+        // keeps its lanes full.
+        static int lanes(isa_level level) {
+            return (level == isa_avx512 ? 64 : level == isa_avx2 ? 32 : 16) / static_cast<int>(sizeof(real));
+        }
+
+    public:
+        // In the precision of the build; sphere_roots keeps the 1000-radius ground
+        // spheres exact enough in floats.
+        std::vector<real> center_x, center_y, center_z;
+        std::vector<real> radius;
+        std::vector<real> radius_squared;       // -1 in the padding, so the discriminant is negative
+        std::vector<uint32_t> mat_ids;
+
+        static const int padding = 64 / sizeof(real);
+
+    private:
+        // Index of the closest sphere the ray hits within (t_min, closest_so_far),
+        // or -1; closest_so_far becomes its distance.
+        long closest(isa_tag<isa_scalar>, const point3& origin, const vec3& dir, real a, real t_min,
+                     real& closest_so_far) const;
+#if RT_X86_SIMD
+        long closest(isa_tag<isa_sse2>, const point3& origin, const vec3& dir, real a, real t_min,
+                     real& closest_so_far) const {
+            return closest_in_lanes<sse_reals<real>>(origin, dir, a, t_min, closest_so_far);
+        }
+        RT_TARGET_AVX2
+        long closest(isa_tag<isa_avx2>, const point3& origin, const vec3& dir, real a, real t_min,
+                     real& closest_so_far) const {
+            return closest_in_lanes<avx_reals<real>>(origin, dir, a, t_min, closest_so_far);
+        }
+        RT_TARGET_AVX512
+        long closest(isa_tag<isa_avx512>, const point3& origin, const vec3& dir, real a, real t_min,
+                     real& closest_so_far) const {
+            return closest_in_lanes<avx512_reals<real>>(origin, dir, a, t_min, closest_so_far);
+        }
+
+        template <class V>
+        long closest_in_lanes(const point3& origin, const vec3& dir, real a, real t_min,
+                              real& closest_so_far) const;
+#endif
+};
+
+
+void sphere_set::add(point3 center, real radius_, uint32_t mat_id) {
+    size_t index = mat_ids.size();
+    mat_ids.push_back(mat_id);
+
+    if (index == center_x.size()) {
+        for (int k = 0; k < padding; k++) {
+            center_x.push_back(0);
+            center_y.push_back(0);
+            center_z.push_back(0);
+            radius.push_back(0);
+            radius_squared.push_back(-1);
+        }
+    }
+
+    center_x[index] = center.x();
+    center_y[index] = center.y();
+    center_z[index] = center.z();
+    radius[index] = radius_;
+    radius_squared[index] = radius_*radius_;
+}
+
+
+template <class Isa>
+bool sphere_set::hit(Isa isa, const ray& r, double t_min, double t_max, hit_record& rec) const {
+    const point3 origin = r.origin();
+    const vec3 dir = r.direction();
+    real closest_so_far = static_cast<real>(t_max);
+    long found = closest(isa, origin, dir, dir.length_squared(), static_cast<real>(t_min), closest_so_far);
+    if (found < 0)
+        return false;
+
+    size_t index = static_cast<size_t>(found);
+    sphere_hit_record(r, point3(center_x[index], center_y[index], center_z[index]), radius[index], mat_ids[index],
+                      closest_so_far, rec);
+    return true;
+}
+
+
+long sphere_set::closest(isa_tag<isa_scalar>, const point3& origin, const vec3& dir, real a, real t_min,
+                         real& closest_so_far) const {
+    long closest = -1;
+    for (size_t i = 0; i < size(); i++) {
+        real near, far;
+        if (!sphere_roots(origin - point3(center_x[i], center_y[i], center_z[i]), dir, a, radius_squared[i],
+                          near, far))
+            continue;
+
+        real temp = near;
+        if (!(temp < closest_so_far && temp > t_min))
+            temp = far;
+        if (temp < closest_so_far && temp > t_min) {
+            closest_so_far = temp;
+            closest = static_cast<long>(i);
+        }
+    }
+    return closest;
+}
+
+
+#if RT_X86_SIMD
+// Every instantiation is only ever inlined into the closest() of its level,
+// which has the target the registers need; the warning about passing them
+// without it does not apply.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+template <class V>
+long sphere_set::closest_in_lanes(const point3& origin, const vec3& dir, real a, real t_min,
+                                  real& closest_so_far) const {
+    const typename V::type ox = V::set1(origin.x()), oy = V::set1(origin.y()), oz = V::set1(origin.z());
+    const typename V::type dx = V::set1(dir.x()), dy = V::set1(dir.y()), dz = V::set1(dir.z());
+    const typename V::type va = V::set1(a);
+    const typename V::type vt_min = V::set1(t_min);
+    const typename V::type zero = V::zero();
+    typename V::type vt_max = V::set1(closest_so_far);
+    long closest = -1;
+
+    for (size_t i = 0; i < size(); i += V::width) {
+        // Same operations, in the same order, as sphere_roots.
+        typename V::type ocx = V::sub(ox, V::load(&center_x[i]));
+        typename V::type ocy = V::sub(oy, V::load(&center_y[i]));
+        typename V::type ocz = V::sub(oz, V::load(&center_z[i]));
+        typename V::type r2 = V::load(&radius_squared[i]);
+
+        typename V::type half_b = V::add(V::add(V::mul(ocx, dx), V::mul(ocy, dy)), V::mul(ocz, dz));
+        typename V::type lx = V::sub(V::mul(va, ocx), V::mul(half_b, dx));
+        typename V::type ly = V::sub(V::mul(va, ocy), V::mul(half_b, dy));
+        typename V::type lz = V::sub(V::mul(va, ocz), V::mul(half_b, dz));
+        typename V::type l_len2 = V::add(V::add(V::mul(lx, lx), V::mul(ly, ly)), V::mul(lz, lz));
+        typename V::type scaled_discriminant = V::sub(V::mul(V::mul(va, va), r2), l_len2);
+
+        typename V::mask has_roots = V::greater(scaled_discriminant, zero);
+        if (V::bits(has_roots) == 0)
+            continue;
+
+        typename V::type root = V::sqrt(V::max(V::div(scaled_discriminant, va), zero));
+        typename V::type neg_half_b = V::sub(zero, half_b);
+        typename V::type q = V::select(V::greater(half_b, zero), V::sub(neg_half_b, root), V::add(neg_half_b, root));
+        typename V::type oc_len2 = V::add(V::add(V::mul(ocx, ocx), V::mul(ocy, ocy)), V::mul(ocz, ocz));
+        typename V::type t0 = V::div(q, va);
+        typename V::type t1 = V::div(V::sub(oc_len2, r2), q);
+        typename V::type t_near = V::min(t0, t1);
+        typename V::type t_far = V::max(t0, t1);
+
+        typename V::mask near_ok = V::both(V::less(t_near, vt_max), V::greater(t_near, vt_min));
+        typename V::mask far_ok  = V::both(V::less(t_far, vt_max), V::greater(t_far, vt_min));
+        typename V::type t = V::select(near_ok, t_near, t_far);
+        int mask = V::bits(V::both(has_roots, V::either(near_ok, far_ok)));
+        if (mask == 0)
+            continue;
+
+        // Lanes are scanned in order and only a strictly closer hit wins, which is
+        // what hittable_list does with the same spheres.
+        real lane_t[V::width];
+        V::store(lane_t, t);
+        for (; mask; mask &= mask - 1) {
+            int k = __builtin_ctz(mask);
+            if (lane_t[k] < closest_so_far) {
+                closest_so_far = lane_t[k];
+                closest = static_cast<long>(i) + k;
+            }
+        }
+        vt_max = V::set1(closest_so_far);
+    }
+    return closest;
+}
+#pragma GCC diagnostic pop
+#endif
+
+
+bool sphere_set::bounding_box(double time0, double time1, aabb& output_box) const {
+    if (mat_ids.empty())
+        return false;
+
+    for (size_t i = 0; i < size(); i++) {
+        point3 center(center_x[i], center_y[i], center_z[i]);
+        vec3 extent(radius[i], radius[i], radius[i]);
+        aabb box(center - extent, center + extent);
+        output_box = i == 0 ? box : surrounding_box(output_box, box);
+    }
+    return true;
+}
+
+
+// Splits a range of spheres by the surface area heuristic until every piece fits
+// one sphere_set, so each set holds spheres that are close together.
+inline void cluster_spheres(std::vector<bvh_primitive>& primitives, size_t start, size_t end,
+                            size_t set_size, hittable_list& out) {
+    if (end - start == 1) {
+        out.add(primitives[start].object);
+        return;
+    }
+
+    if (end - start <= set_size) {
+        auto set = make_shared<sphere_set>();
+        for (size_t i = start; i < end; i++)
+            set->add(static_cast<const sphere&>(*primitives[i].object));
+        out.add(set);
+        return;
+    }
+
+    auto mid = sah_split(primitives, start, end).mid;
+    cluster_spheres(primitives, start, mid, set_size, out);
+    cluster_spheres(primitives, mid, end, set_size, out);
+}
+
+// Replaces the spheres of a list by sphere_sets of up to set_size nearby spheres,
+// ready to be handed to a BVH as leaves. Everything else is passed through.
+hittable_list group_spheres(const hittable_list& list, size_t set_size = sphere_set::lanes(active_isa())) {
+    hittable_list grouped, spheres;
+    for (const auto& object : list.objects) {
+        if (dynamic_cast<const sphere*>(object.get()))
+            spheres.add(object);
+        else
+            grouped.add(object);
+    }
+
+    if (!spheres.objects.empty()) {
+        auto primitives = bvh_primitives(spheres, 0, 0);
+        cluster_spheres(primitives, 0, primitives.size(), set_size, grouped);
+    }
+    return grouped;
+}
+
+#endif /* sphere_set_h */
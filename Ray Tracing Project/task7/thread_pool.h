@@ -0,0 +1,180 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef thread_pool_h
+#define thread_pool_h
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Counts the jobs of one fork/join batch that have not finished yet.
+struct task_group {
+    std::atomic<int> pending{0};
+};
+
+
+// Work-stealing pool: every worker owns a deque, pops its own jobs from the
+// back and steals from the front of the others when it runs dry. The thread
+// that calls wait() helps out as worker 0, so the pool spawns threads-1 threads.
+class thread_pool {
+    public:
+        explicit thread_pool(unsigned n_threads) {
+            if (n_threads == 0)
+                n_threads = 1;
+
+            for (unsigned i = 0; i < n_threads; i++)
+                queues.push_back(std::make_unique<worker_queue>());
+
+            for (unsigned i = 1; i < n_threads; i++)
+                threads.emplace_back([this, i] { worker_loop(i); });
+        }
+
+        ~thread_pool() {
+            {
+                std::lock_guard<std::mutex> guard(sleep_lock);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto& t : threads)
+                t.join();
+        }
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        unsigned size() const { return static_cast<unsigned>(queues.size()); }
+
+        // Which of the size() workers the calling thread is; 0 for the thread
+        // that waits. No two threads running the pool's jobs share an index, so
+        // jobs can keep per-worker state without atomics.
+        unsigned worker_index() const { return is_worker() ? identity().index : 0; }
+
+        void submit(task_group& group, std::function<void()> fn) {
+            group.pending.fetch_add(1);
+
+            // Jobs spawned by a worker stay local; outside jobs are dealt round-robin.
+            unsigned target = worker_index();
+            if (!is_worker())
+                target = next_queue.fetch_add(1) % size();
+
+            {
+                std::lock_guard<std::mutex> guard(queues[target]->lock);
+                queues[target]->jobs.push_back(job{&group, std::move(fn)});
+            }
+            {
+                std::lock_guard<std::mutex> guard(sleep_lock);
+                queued++;
+            }
+            wake.notify_one();
+        }
+
+        // Blocks until every job of the group is done, running queued jobs meanwhile.
+        void wait(task_group& group) {
+            unsigned self = is_worker() ? worker_index() : 0;
+            while (group.pending.load() > 0) {
+                if (!try_run_one(self))
+                    std::this_thread::yield();
+            }
+        }
+
+        // Runs body(i) for every i in [0, count) and returns once all are done.
+        template <class Body>
+        void parallel_for(size_t count, Body body) {
+            task_group group;
+            for (size_t i = 0; i < count; i++)
+                submit(group, [&body, i] { body(i); });
+            wait(group);
+        }
+
+    private:
+        struct job {
+            task_group* group;
+            std::function<void()> fn;
+        };
+
+        struct worker_queue {
+            std::mutex lock;
+            std::deque<job> jobs;
+        };
+
+        struct worker_identity {
+            const thread_pool* pool = nullptr;
+            unsigned index = 0;
+        };
+
+        static worker_identity& identity() {
+            static thread_local worker_identity id;
+            return id;
+        }
+
+        bool is_worker() const { return identity().pool == this; }
+
+        bool pop(unsigned victim, bool own, job& out) {
+            std::lock_guard<std::mutex> guard(queues[victim]->lock);
+            auto& jobs = queues[victim]->jobs;
+            if (jobs.empty())
+                return false;
+
+            if (own) {
+                out = std::move(jobs.back());
+                jobs.pop_back();
+            } else {
+                out = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            return true;
+        }
+
+        bool try_run_one(unsigned self) {
+            job j;
+            bool found = pop(self, true, j);
+            for (unsigned k = 1; !found && k < size(); k++)
+                found = pop((self + k) % size(), false, j);
+
+            if (!found)
+                return false;
+
+            {
+                std::lock_guard<std::mutex> guard(sleep_lock);
+                queued--;
+            }
+            j.fn();
+            j.group->pending.fetch_sub(1);
+            return true;
+        }
+
+        void worker_loop(unsigned index) {
+            identity().pool = this;
+            identity().index = index;
+
+            while (true) {
+                if (try_run_one(index))
+                    continue;
+
+                std::unique_lock<std::mutex> guard(sleep_lock);
+                wake.wait(guard, [this] { return stopping || queued > 0; });
+                if (stopping && queued <= 0)
+                    return;
+            }
+        }
+
+    private:
+        std::vector<std::unique_ptr<worker_queue>> queues;
+        std::vector<std::thread> threads;
+        std::atomic<unsigned> next_queue{0};
+
+        std::mutex sleep_lock;
+        std::condition_variable wake;
+        int queued = 0;
+        bool stopping = false;
+};
+
+#endif /* thread_pool_h */
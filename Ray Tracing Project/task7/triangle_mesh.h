@@ -0,0 +1,282 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef triangle_mesh_h
+#define triangle_mesh_h
+
+#include "counters.h"
+#include "hittable.h"
+#include "wide_bvh.h"
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+
+// Indexed triangles as loaders and generators hand them over: vertices are shared
+// between the triangles that meet at them. Floats, like the files they come from.
+struct mesh_data {
+    std::vector<float> positions;   // x, y, z per vertex
+    std::vector<float> normals;     // x, y, z per vertex, or empty for face normals
+    std::vector<float> uvs;         // u, v per vertex, or empty
+    std::vector<uint32_t> indices;  // three vertices per triangle
+
+    size_t vertex_count() const { return positions.size() / 3; }
+    size_t triangle_count() const { return indices.size() / 3; }
+};
+
+// Copies position, normal and index arrays of any point type with x, y and z
+// members, such as the glm::vec3 and GLuint arrays GenerateParametricShapeFrom2D
+// fills in the OpenGL projects. normals may be empty.
+template <class Point, class Index>
+mesh_data mesh_from_arrays(const std::vector<Point>& positions, const std::vector<Point>& normals,
+                           const std::vector<Index>& indices) {
+    mesh_data data;
+    data.positions.reserve(3 * positions.size());
+    for (const auto& p : positions) {
+        data.positions.push_back(static_cast<float>(p.x));
+        data.positions.push_back(static_cast<float>(p.y));
+        data.positions.push_back(static_cast<float>(p.z));
+    }
+    if (normals.size() == positions.size()) {
+        data.normals.reserve(3 * normals.size());
+        for (const auto& n : normals) {
+            data.normals.push_back(static_cast<float>(n.x));
+            data.normals.push_back(static_cast<float>(n.y));
+            data.normals.push_back(static_cast<float>(n.z));
+        }
+    }
+    data.indices.assign(indices.begin(), indices.end());
+    return data;
+}
+
+
+// A ray prepared for the watertight triangle test of Woop, Benthin and Wald: the
+// axis the ray mostly travels along becomes z, and a shear turns the ray into the
+// z axis itself. Every triangle is then tested in 2D against the origin, and an
+// edge shared by two triangles gives both the same edge value with opposite sign,
+// so a ray through an edge or a vertex cannot slip between them.
+struct watertight_ray {
+    point3 origin;
+    int kx, ky, kz;
+    real sx, sy, sz;
+
+    explicit watertight_ray(const ray& r) : origin(r.origin()) {
+        const vec3 d = r.direction();
+        kz = std::fabs(d.x()) > std::fabs(d.y())
+            ? (std::fabs(d.x()) > std::fabs(d.z()) ? 0 : 2)
+            : (std::fabs(d.y()) > std::fabs(d.z()) ? 1 : 2);
+        kx = kz == 2 ? 0 : kz + 1;
+        ky = kx == 2 ? 0 : kx + 1;
+        // Swapping keeps the winding of the triangles as seen along the ray.
+        if (d[kz] < 0)
+            std::swap(kx, ky);
+
+        sx = d[kx] / d[kz];
+        sy = d[ky] / d[kz];
+        sz = 1 / d[kz];
+    }
+};
+
+// Intersects the triangle a, b, c. On a hit inside (t_min, t_max) returns t and the
+// barycentric weights of a, b and c.
+inline bool hit_triangle(const watertight_ray& r, const float* a, const float* b, const float* c,
+                         double t_min, double t_max, real& t, real& wa, real& wb, real& wc) {
+    const real ax = a[r.kx] - r.origin[r.kx], ay = a[r.ky] - r.origin[r.ky], az = a[r.kz] - r.origin[r.kz];
+    const real bx = b[r.kx] - r.origin[r.kx], by = b[r.ky] - r.origin[r.ky], bz = b[r.kz] - r.origin[r.kz];
+    const real cx = c[r.kx] - r.origin[r.kx], cy = c[r.ky] - r.origin[r.ky], cz = c[r.kz] - r.origin[r.kz];
+
+    const real sax = ax - r.sx * az, say = ay - r.sy * az;
+    const real sbx = bx - r.sx * bz, sby = by - r.sy * bz;
+    const real scx = cx - r.sx * cz, scy = cy - r.sy * cz;
+
+    // Edge functions, each the weight of the vertex opposite its edge.
+    const real u = scx * sby - scy * sbx;
+    const real v = sax * scy - say * scx;
+    const real w = sbx * say - sby * sax;
+    if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0))
+        return false;
+
+    real det = u + v + w;
+    if (det == 0)
+        return false;
+
+    // Compare the scaled distance against the range before dividing.
+    real scaled_t = r.sz * (u * az + v * bz + w * cz);
+    real sign = det < 0 ? -1 : 1;
+    if (sign * scaled_t <= t_min * sign * det || sign * scaled_t >= t_max * sign * det)
+        return false;
+
+    const real inv_det = 1 / det;
+    t = scaled_t * inv_det;
+    wa = u * inv_det;
+    wb = v * inv_det;
+    wc = w * inv_det;
+    return true;
+}
+
+
+// A triangle mesh with its own wide BVH over the triangles. The triangles are
+// stored in the order the tree's leaves visit them, so a leaf reads neighbouring
+// indices, and are tested without a virtual call or an object per triangle.
+// Vertex normals, when present, are interpolated for shading; uvs likewise, and
+// the barycentric coordinates stand in for them otherwise.
+class triangle_mesh : public hittable {
+    public:
+        triangle_mesh() {}
+        triangle_mesh(mesh_data data, uint32_t mat_id, bvh_build_stats* stats = nullptr,
+                      const bvh_build_options& build = bvh_build_options());
+
+        template <class Point, class Index>
+        triangle_mesh(const std::vector<Point>& positions, const std::vector<Point>& normals,
+                      const std::vector<Index>& indices, uint32_t mat_id)
+            : triangle_mesh(mesh_from_arrays(positions, normals, indices), mat_id) {}
+
+        size_t triangle_count() const { return mesh.triangle_count(); }
+
+        virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
+
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override {
+            return bvh.bounding_box(time0, time1, output_box);
+        }
+
+    public:
+        mesh_data mesh;
+        wide_bvh<4> bvh;    // leaf primitive i is triangle i
+        uint32_t mat_id;
+
+    private:
+        void fill_record(const ray& r, uint32_t triangle, double t, real wa, real wb, real wc,
+                         hit_record& rec) const;
+};
+
+
+triangle_mesh::triangle_mesh(mesh_data data, uint32_t mat_id, bvh_build_stats* stats,
+                             const bvh_build_options& build)
+    : mesh(std::move(data)), mat_id(mat_id) {
+    if (mesh.normals.size() != mesh.positions.size())
+        mesh.normals.clear();
+    if (mesh.uvs.size() / 2 != mesh.vertex_count())
+        mesh.uvs.clear();
+
+    // Triangles pointing past the vertex buffer are dropped.
+    const size_t vertex_count = mesh.vertex_count();
+    std::vector<bvh_primitive> primitives;
+    primitives.reserve(mesh.triangle_count());
+    size_t dropped = 0;
+    for (size_t i = 0; i < mesh.triangle_count(); i++) {
+        const uint32_t* tri = &mesh.indices[3*i];
+        if (tri[0] >= vertex_count || tri[1] >= vertex_count || tri[2] >= vertex_count) {
+            dropped++;
+            continue;
+        }
+
+        point3 lo(INFINITY, INFINITY, INFINITY), hi(-INFINITY, -INFINITY, -INFINITY);
+        for (int k = 0; k < 3; k++) {
+            const float* p = &mesh.positions[3 * tri[k]];
+            for (int a = 0; a < 3; a++) {
+                lo[a] = fmin(lo[a], p[a]);
+                hi[a] = fmax(hi[a], p[a]);
+            }
+        }
+        bvh_primitive prim;
+        prim.box = aabb(lo, hi);
+        prim.centroid = 0.5 * (lo + hi);
+        prim.index = static_cast<uint32_t>(i);
+        primitives.push_back(prim);
+    }
+    if (dropped)
+        std::cerr << "triangle_mesh: dropped " << dropped << " triangles with out of range indices\n";
+
+    bvh = wide_bvh<4>(primitives, stats, build);
+
+    // Put the triangles in leaf order, so leaf primitive i is triangle i.
+    std::vector<uint32_t> ordered;
+    ordered.reserve(3 * bvh.leaf_indices.size());
+    for (uint32_t i : bvh.leaf_indices)
+        ordered.insert(ordered.end(), &mesh.indices[3*i], &mesh.indices[3*i] + 3);
+    mesh.indices = std::move(ordered);
+    bvh.leaf_indices.clear();
+    bvh.leaf_indices.shrink_to_fit();
+}
+
+
+bool triangle_mesh::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+    const watertight_ray wr(r);
+    uint32_t closest = 0;
+    real wa = 0, wb = 0, wc = 0;
+
+    // closest_hit dispatches on the isa_level and inlines this test into the
+    // traversal of each level, so it too is compiled once per level.
+    bool hit_anything = bvh.closest_hit(r, t_min, t_max, rec,
+        [&](int i, const ray&, double t_min, double t_max, hit_record& rec) {
+            RT_COUNT(thread_counters().primitive_tests[render_counters::triangle_test]++);
+            const uint32_t* tri = &mesh.indices[3*i];
+            real t, a, b, c;
+            if (!hit_triangle(wr, &mesh.positions[3*tri[0]], &mesh.positions[3*tri[1]], &mesh.positions[3*tri[2]],
+                              t_min, t_max, t, a, b, c))
+                return false;
+            // Only t is needed to go on traversing; the rest is filled in once.
+            rec.t = t;
+            closest = static_cast<uint32_t>(i);
+            wa = a; wb = b; wc = c;
+            return true;
+        });
+
+    if (hit_anything)
+        fill_record(r, closest, rec.t, wa, wb, wc, rec);
+    return hit_anything;
+}
+
+
+void triangle_mesh::fill_record(const ray& r, uint32_t triangle, double t, real wa, real wb, real wc,
+                                hit_record& rec) const {
+    const uint32_t* tri = &mesh.indices[3*triangle];
+    auto vertex = [&](const std::vector<float>& data, int k) {
+        const float* p = &data[3 * tri[k]];
+        return vec3(p[0], p[1], p[2]);
+    };
+
+    // p from the weights rather than r.at(t), so it lies in the plane of the
+    // triangle up to the rounding of a few products of its own size.
+    vec3 a = vertex(mesh.positions, 0), b = vertex(mesh.positions, 1), c = vertex(mesh.positions, 2);
+    vec3 pa = wa * a, pb = wb * b, pc = wc * c;
+    rec.t = t;
+    rec.p = pa + pb + pc;
+    rec.error = rounding_error<real>(7) * (max_abs_component(pa) + max_abs_component(pb) + max_abs_component(pc));
+    rec.mat_id = mat_id;
+
+    vec3 geometric = cross(b - a, c - a);
+
+    vec3 shading(0, 0, 0);
+    if (!mesh.normals.empty())
+        shading = wa * vertex(mesh.normals, 0) + wb * vertex(mesh.normals, 1) + wc * vertex(mesh.normals, 2);
+
+    if (shading.length_squared() == 0) {
+        rec.set_face_normal(r, unit_vector(geometric));
+    } else {
+        // Which side the ray is on comes from the flat triangle; the interpolated
+        // normal only bends the shading, and decides which side is outside.
+        if (dot(geometric, shading) < 0)
+            geometric = -geometric;
+        rec.set_face_normal(r, unit_vector(geometric));
+        shading = unit_vector(shading);
+        rec.normal = rec.front_face ? shading : -shading;
+    }
+
+    if (mesh.uvs.empty()) {
+        rec.u = wb;
+        rec.v = wc;
+    } else {
+        const float* ua = &mesh.uvs[2 * tri[0]];
+        const float* ub = &mesh.uvs[2 * tri[1]];
+        const float* uc = &mesh.uvs[2 * tri[2]];
+        rec.u = wa * ua[0] + wb * ub[0] + wc * uc[0];
+        rec.v = wa * ua[1] + wb * ub[1] + wc * uc[1];
+    }
+}
+
+#endif /* triangle_mesh_h */
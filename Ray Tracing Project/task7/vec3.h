@@ -1,4 +1,3 @@
-
 //  Created by Melih Kurtaran on 30/10/2020.
 //  Copyright © 2020 melihkurtaran. All rights reserved.
 //
@@ -10,55 +9,88 @@
 #include <cmath>
 #include <iostream>
 
+#include "sampler.h"
+
 using std::sqrt;
 using std::fabs;
 
-inline double random_double() {
-    // Returns a random real in [0,1).
-    return rand() / (RAND_MAX + 1.0);
-}
+const double PI = 3.1415926535897932385;
 
-inline double random_double(double min, double max) {
-    // Returns a random real in [min,max).
-    return min + (max-min)*random_double();
-}
+// Build with -DRT_FLOAT=0 to trace in double precision. Geometry, rays and colors
+// are vec3_t<real>; the float build is the default, the double one the reference
+// it is compared against.
+#ifndef RT_FLOAT
+#define RT_FLOAT 1
+#endif
+
+#if RT_FLOAT
+using real = float;
+#else
+using real = double;
+#endif
 
-class vec3 {
+
+// How a vec3_t<T> is laid out. Floats get a fourth, always zero, lane and 16-byte
+// alignment, so a vector is one SSE register and the component-wise operations
+// below compile to single instructions.
+template <class T> struct vec3_layout {
+    static const int lanes = 3;
+    static const size_t alignment = alignof(T);
+};
+
+template <> struct vec3_layout<float> {
+    static const int lanes = 4;
+    static const size_t alignment = 16;
+};
+
+
+template <class T>
+class vec3_t {
     public:
-        vec3() : e{0,0,0} {}
-        vec3(double e0, double e1, double e2) : e{e0, e1, e2} {}
+        using scalar = T;
+        static const int lanes = vec3_layout<T>::lanes;
+
+        vec3_t() : e{} {}
+        vec3_t(T e0, T e1, T e2) : e{e0, e1, e2} {}
+
+        // Between precisions, e.g. to hand float geometry to double code.
+        template <class U>
+        explicit vec3_t(const vec3_t<U>& v) : e{static_cast<T>(v.x()), static_cast<T>(v.y()), static_cast<T>(v.z())} {}
 
-        double x() const { return e[0]; }
-        double y() const { return e[1]; }
-        double z() const { return e[2]; }
+        T x() const { return e[0]; }
+        T y() const { return e[1]; }
+        T z() const { return e[2]; }
 
-        vec3 operator-() const { return vec3(-e[0], -e[1], -e[2]); }
-        double operator[](int i) const { return e[i]; }
-        double& operator[](int i) { return e[i]; }
+        vec3_t operator-() const {
+            vec3_t v;
+            for (int i = 0; i < lanes; i++)
+                v.e[i] = -e[i];
+            return v;
+        }
+        T operator[](int i) const { return e[i]; }
+        T& operator[](int i) { return e[i]; }
 
-        vec3& operator+=(const vec3 &v) {
-            e[0] += v.e[0];
-            e[1] += v.e[1];
-            e[2] += v.e[2];
+        vec3_t& operator+=(const vec3_t &v) {
+            for (int i = 0; i < lanes; i++)
+                e[i] += v.e[i];
             return *this;
         }
 
-        vec3& operator*=(const double t) {
-            e[0] *= t;
-            e[1] *= t;
-            e[2] *= t;
+        vec3_t& operator*=(const T t) {
+            for (int i = 0; i < lanes; i++)
+                e[i] *= t;
             return *this;
         }
 
-        vec3& operator/=(const double t) {
+        vec3_t& operator/=(const T t) {
             return *this *= 1/t;
         }
 
-        double length() const {
+        T length() const {
             return sqrt(length_squared());
         }
 
-        double length_squared() const {
+        T length_squared() const {
             return e[0]*e[0] + e[1]*e[1] + e[2]*e[2];
         }
 
@@ -68,96 +100,127 @@ class vec3 {
             return (fabs(e[0]) < s) && (fabs(e[1]) < s) && (fabs(e[2]) < s);
         }
 
-        inline static vec3 random() {
-            return vec3(random_double(), random_double(), random_double());
+        inline static vec3_t random(sampler& rng) {
+            return vec3_t(rng.random_double(), rng.random_double(), rng.random_double());
         }
 
-        inline static vec3 random(double min, double max) {
-            return vec3(random_double(min,max), random_double(min,max), random_double(min,max));
+        inline static vec3_t random(sampler& rng, double min, double max) {
+            return vec3_t(rng.random_double(min,max), rng.random_double(min,max), rng.random_double(min,max));
         }
 
     public:
-        double e[3];
+        alignas(vec3_layout<T>::alignment) T e[lanes];
 };
 
 
 // Type aliases for vec3
+using vec3 = vec3_t<real>;
 using point3 = vec3;   // 3D point
 using color = vec3;    // RGB color
 
 
-// vec3 Utility Functions
+// vec3 Utility Functions. Scalars are taken as vec3_t<T>::scalar, so double
+// constants and variables still scale a float vector.
 
-inline std::ostream& operator<<(std::ostream &out, const vec3 &v) {
+template <class T>
+inline std::ostream& operator<<(std::ostream &out, const vec3_t<T> &v) {
     return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
 }
 
-inline vec3 operator+(const vec3 &u, const vec3 &v) {
-    return vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
+template <class T>
+inline vec3_t<T> operator+(const vec3_t<T> &u, const vec3_t<T> &v) {
+    vec3_t<T> w;
+    for (int i = 0; i < vec3_t<T>::lanes; i++)
+        w.e[i] = u.e[i] + v.e[i];
+    return w;
 }
 
-inline vec3 operator-(const vec3 &u, const vec3 &v) {
-    return vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
+template <class T>
+inline vec3_t<T> operator-(const vec3_t<T> &u, const vec3_t<T> &v) {
+    vec3_t<T> w;
+    for (int i = 0; i < vec3_t<T>::lanes; i++)
+        w.e[i] = u.e[i] - v.e[i];
+    return w;
 }
 
-inline vec3 operator*(const vec3 &u, const vec3 &v) {
-    return vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
+template <class T>
+inline vec3_t<T> operator*(const vec3_t<T> &u, const vec3_t<T> &v) {
+    vec3_t<T> w;
+    for (int i = 0; i < vec3_t<T>::lanes; i++)
+        w.e[i] = u.e[i] * v.e[i];
+    return w;
 }
 
-inline vec3 operator*(double t, const vec3 &v) {
-    return vec3(t*v.e[0], t*v.e[1], t*v.e[2]);
+template <class T>
+inline vec3_t<T> operator*(typename vec3_t<T>::scalar t, const vec3_t<T> &v) {
+    vec3_t<T> w;
+    for (int i = 0; i < vec3_t<T>::lanes; i++)
+        w.e[i] = t * v.e[i];
+    return w;
 }
 
-inline vec3 operator*(const vec3 &v, double t) {
+template <class T>
+inline vec3_t<T> operator*(const vec3_t<T> &v, typename vec3_t<T>::scalar t) {
     return t * v;
 }
 
-inline vec3 operator/(vec3 v, double t) {
+template <class T>
+inline vec3_t<T> operator/(vec3_t<T> v, typename vec3_t<T>::scalar t) {
     return (1/t) * v;
 }
 
-inline double dot(const vec3 &u, const vec3 &v) {
+template <class T>
+inline T dot(const vec3_t<T> &u, const vec3_t<T> &v) {
     return u.e[0] * v.e[0]
          + u.e[1] * v.e[1]
          + u.e[2] * v.e[2];
 }
 
-inline vec3 cross(const vec3 &u, const vec3 &v) {
-    return vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1],
-                u.e[2] * v.e[0] - u.e[0] * v.e[2],
-                u.e[0] * v.e[1] - u.e[1] * v.e[0]);
+template <class T>
+inline vec3_t<T> cross(const vec3_t<T> &u, const vec3_t<T> &v) {
+    return vec3_t<T>(u.e[1] * v.e[2] - u.e[2] * v.e[1],
+                     u.e[2] * v.e[0] - u.e[0] * v.e[2],
+                     u.e[0] * v.e[1] - u.e[1] * v.e[0]);
 }
 
-inline vec3 unit_vector(vec3 v) {
+template <class T>
+inline vec3_t<T> unit_vector(vec3_t<T> v) {
     return v / v.length();
 }
 
-inline vec3 random_in_unit_disk() {
-    while (true) {
-        auto p = vec3(random_double(-1,1), random_double(-1,1), 0);
-        if (p.length_squared() >= 1) continue;
-        return p;
-    }
-}
-
-inline vec3 random_in_unit_sphere() {
-    while (true) {
-        auto p = vec3::random(-1,1);
-        if (p.length_squared() >= 1) continue;
-        return p;
+// Shirley and Chiu's concentric map of the unit square onto the disk: two
+// numbers per point, which a low-discrepancy sampler keeps evenly spread.
+inline vec3 random_in_unit_disk(sampler& rng) {
+    auto a = rng.random_double(-1,1);
+    auto b = rng.random_double(-1,1);
+    if (a == 0 && b == 0)
+        return vec3(0, 0, 0);
+    double r, theta;
+    if (fabs(a) > fabs(b)) {
+        r = a;
+        theta = PI/4 * (b / a);
+    } else {
+        r = b;
+        theta = PI/2 - PI/4 * (a / b);
     }
+    return vec3(r*cos(theta), r*sin(theta), 0);
 }
 
-inline vec3 random_unit_vector() {
-    return unit_vector(random_in_unit_sphere());
+// Uniform on the unit sphere, drawn in closed form: z is uniform in [-1, 1].
+inline vec3 random_unit_vector(sampler& rng) {
+    auto a = rng.random_double(0, 2*PI);
+    auto z = rng.random_double(-1, 1);
+    auto r = sqrt(1 - z*z);
+    return vec3(r*cos(a), r*sin(a), z);
 }
 
-inline vec3 random_in_hemisphere(const vec3& normal) {
-    vec3 in_unit_sphere = random_in_unit_sphere();
-    if (dot(in_unit_sphere, normal) > 0.0) // In the same hemisphere as the normal
-        return in_unit_sphere;
-    else
-        return -in_unit_sphere;
+// A direction in the hemisphere around +z with density cos(theta) / pi, drawn
+// in closed form from the unit disk projected up.
+inline vec3 random_cosine_direction(sampler& rng) {
+    auto phi = rng.random_double(0, 2*PI);
+    auto r2 = rng.random_double();
+    auto r = sqrt(r2);
+    return vec3(r*cos(phi), r*sin(phi), sqrt(1 - r2));
 }
 
 inline vec3 reflect(const vec3& v, const vec3& n) {
@@ -0,0 +1,514 @@
+//  Created by Melih Kurtaran on 17/10/2026.
+//  Copyright © 2026 melihkurtaran. All rights reserved.
+//
+
+#ifndef wide_bvh_h
+#define wide_bvh_h
+
+#include "counters.h"
+#include "isa.h"
+#include "linear_bvh.h"
+#include "ray_packet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+// Node of an N-wide BVH. The child boxes are stored as structure-of-arrays so one
+// SIMD register holds the same bound of all N children. A child with count 0 is an
+// interior node at index child[k]; otherwise it is a leaf holding count primitives
+// starting at child[k]. Children are packed at the front; slots past num_children
+// hold an inverted box and are masked out of the hit mask.
+template <int N>
+struct alignas(32) wide_bvh_node {
+    float min_x[N], min_y[N], min_z[N];
+    float max_x[N], max_y[N], max_z[N];
+    int32_t child[N];
+    uint16_t count[N];
+    uint8_t num_children;
+};
+
+
+// Ray data broadcast once per ray, shared by all box tests.
+struct wide_ray {
+    float origin[3];
+    float inv_dir[3];
+    float t_min, t_max;
+};
+
+
+// Tests the ray against all N child boxes of a node. Writes the entry distance of
+// every child and returns a bit mask of the children that were hit. The SIMD
+// levels test four, eight or sixteen children per instruction, as many as the
+// node has and the level's registers hold.
+template <int N>
+inline unsigned intersect_children(isa_tag<isa_scalar>, const wide_bvh_node<N>& node, const wide_ray& r,
+                                   float* t_near) {
+    unsigned mask = 0;
+    for (int k = 0; k < N; k++) {
+        float tx0 = (node.min_x[k] - r.origin[0]) * r.inv_dir[0];
+        float tx1 = (node.max_x[k] - r.origin[0]) * r.inv_dir[0];
+        float ty0 = (node.min_y[k] - r.origin[1]) * r.inv_dir[1];
+        float ty1 = (node.max_y[k] - r.origin[1]) * r.inv_dir[1];
+        float tz0 = (node.min_z[k] - r.origin[2]) * r.inv_dir[2];
+        float tz1 = (node.max_z[k] - r.origin[2]) * r.inv_dir[2];
+
+        float t0 = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), r.t_min));
+        float t1 = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::min(std::max(tz0, tz1), r.t_max));
+        t_near[k] = t0;
+        if (t0 <= t1)
+            mask |= 1u << k;
+    }
+    return mask;
+}
+
+#if RT_X86_SIMD
+// Children k to k+3.
+template <int N>
+inline unsigned slab_test_4(const wide_bvh_node<N>& node, int k, const wide_ray& r, float* t_near) {
+    const __m128 ox = _mm_set1_ps(r.origin[0]), oy = _mm_set1_ps(r.origin[1]), oz = _mm_set1_ps(r.origin[2]);
+    const __m128 ix = _mm_set1_ps(r.inv_dir[0]), iy = _mm_set1_ps(r.inv_dir[1]), iz = _mm_set1_ps(r.inv_dir[2]);
+
+    __m128 tx0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_x + k), ox), ix);
+    __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_x + k), ox), ix);
+    __m128 ty0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_y + k), oy), iy);
+    __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_y + k), oy), iy);
+    __m128 tz0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_z + k), oz), iz);
+    __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_z + k), oz), iz);
+
+    __m128 t0 = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx0, tx1), _mm_min_ps(ty0, ty1)),
+                           _mm_max_ps(_mm_min_ps(tz0, tz1), _mm_set1_ps(r.t_min)));
+    __m128 t1 = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx0, tx1), _mm_max_ps(ty0, ty1)),
+                           _mm_min_ps(_mm_max_ps(tz0, tz1), _mm_set1_ps(r.t_max)));
+    _mm_storeu_ps(t_near + k, t0);
+    return static_cast<unsigned>(_mm_movemask_ps(_mm_cmple_ps(t0, t1))) << k;
+}
+
+// Children k to k+7.
+template <int N>
+RT_TARGET_AVX2
+inline unsigned slab_test_8(const wide_bvh_node<N>& node, int k, const wide_ray& r, float* t_near) {
+    const __m256 ox = _mm256_set1_ps(r.origin[0]), oy = _mm256_set1_ps(r.origin[1]), oz = _mm256_set1_ps(r.origin[2]);
+    const __m256 ix = _mm256_set1_ps(r.inv_dir[0]), iy = _mm256_set1_ps(r.inv_dir[1]), iz = _mm256_set1_ps(r.inv_dir[2]);
+
+    __m256 tx0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.min_x + k), ox), ix);
+    __m256 tx1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.max_x + k), ox), ix);
+    __m256 ty0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.min_y + k), oy), iy);
+    __m256 ty1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.max_y + k), oy), iy);
+    __m256 tz0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.min_z + k), oz), iz);
+    __m256 tz1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.max_z + k), oz), iz);
+
+    __m256 t0 = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(tx0, tx1), _mm256_min_ps(ty0, ty1)),
+                              _mm256_max_ps(_mm256_min_ps(tz0, tz1), _mm256_set1_ps(r.t_min)));
+    __m256 t1 = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(tx0, tx1), _mm256_max_ps(ty0, ty1)),
+                              _mm256_min_ps(_mm256_max_ps(tz0, tz1), _mm256_set1_ps(r.t_max)));
+    _mm256_storeu_ps(t_near + k, t0);
+    return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(t0, t1, _CMP_LE_OQ))) << k;
+}
+
+// Children k to k+15.
+template <int N>
+RT_TARGET_AVX512
+inline unsigned slab_test_16(const wide_bvh_node<N>& node, int k, const wide_ray& r, float* t_near) {
+    const __m512 ox = _mm512_set1_ps(r.origin[0]), oy = _mm512_set1_ps(r.origin[1]), oz = _mm512_set1_ps(r.origin[2]);
+    const __m512 ix = _mm512_set1_ps(r.inv_dir[0]), iy = _mm512_set1_ps(r.inv_dir[1]), iz = _mm512_set1_ps(r.inv_dir[2]);
+
+    __m512 tx0 = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(node.min_x + k), ox), ix);
+    __m512 tx1 = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(node.max_x + k), ox), ix);
+    __m512 ty0 = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(node.min_y + k), oy), iy);
+    __m512 ty1 = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(node.max_y + k), oy), iy);
+    __m512 tz0 = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(node.min_z + k), oz), iz);
+    __m512 tz1 = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(node.max_z + k), oz), iz);
+
+    __m512 t0 = _mm512_max_ps(_mm512_max_ps(_mm512_min_ps(tx0, tx1), _mm512_min_ps(ty0, ty1)),
+                              _mm512_max_ps(_mm512_min_ps(tz0, tz1), _mm512_set1_ps(r.t_min)));
+    __m512 t1 = _mm512_min_ps(_mm512_min_ps(_mm512_max_ps(tx0, tx1), _mm512_max_ps(ty0, ty1)),
+                              _mm512_min_ps(_mm512_max_ps(tz0, tz1), _mm512_set1_ps(r.t_max)));
+    _mm512_storeu_ps(t_near + k, t0);
+    return static_cast<unsigned>(_mm512_cmp_ps_mask(t0, t1, _CMP_LE_OQ)) << k;
+}
+
+template <int N>
+inline unsigned intersect_children(isa_tag<isa_sse2>, const wide_bvh_node<N>& node, const wide_ray& r,
+                                   float* t_near) {
+    if (N % 4 != 0)
+        return intersect_children(isa_tag<isa_scalar>(), node, r, t_near);
+    unsigned mask = 0;
+    for (int k = 0; k < N; k += 4)
+        mask |= slab_test_4(node, k, r, t_near);
+    return mask;
+}
+
+template <int N>
+RT_TARGET_AVX2
+inline unsigned intersect_children(isa_tag<isa_avx2>, const wide_bvh_node<N>& node, const wide_ray& r,
+                                   float* t_near) {
+    if (N % 8 != 0)
+        return intersect_children(isa_tag<isa_sse2>(), node, r, t_near);
+    unsigned mask = 0;
+    for (int k = 0; k < N; k += 8)
+        mask |= slab_test_8(node, k, r, t_near);
+    return mask;
+}
+
+template <int N>
+RT_TARGET_AVX512
+inline unsigned intersect_children(isa_tag<isa_avx512>, const wide_bvh_node<N>& node, const wide_ray& r,
+                                   float* t_near) {
+    if (N % 16 != 0)
+        return intersect_children(isa_tag<isa_avx2>(), node, r, t_near);
+    unsigned mask = 0;
+    for (int k = 0; k < N; k += 16)
+        mask |= slab_test_16(node, k, r, t_near);
+    return mask;
+}
+#endif
+
+
+// N-wide BVH made by collapsing the binary tree of linear_bvh: every wide node
+// pulls up the largest interior descendants until it has N children.
+template <int N>
+class wide_bvh : public hittable {
+    public:
+        wide_bvh() {}
+        wide_bvh(const hittable_list& list, double time0, double time1,
+                 bvh_build_stats* stats = nullptr, const bvh_build_options& build = bvh_build_options());
+        // Builds over primitives prepared by the caller, reordering them.
+        explicit wide_bvh(std::vector<bvh_primitive>& primitives,
+                          bvh_build_stats* stats = nullptr, const bvh_build_options& build = bvh_build_options());
+
+        virtual bool hit(
+            const ray& r, double t_min, double t_max, hit_record& rec) const override;
+
+        // Closest hits of up to packet_size coherent rays, traced together. Returns the
+        // mask of rays that hit something; recs[k] is only written for those rays.
+        unsigned hit_packet(
+            const ray* rays, int count, double t_min, double t_max, hit_record* recs) const;
+
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override {
+            output_box = bounds;
+            return !nodes.empty();
+        }
+
+        // The traversals behind hit() and hit_packet(), with the leaf test left to the
+        // caller: leaf_hit(i, r, t_min, t_max, rec) intersects leaf primitive i. This
+        // lets compiled_scene reuse the tree with its own, non-virtual primitives.
+        // They run at the active isa_level.
+        template <class LeafHit>
+        bool closest_hit(
+            const ray& r, double t_min, double t_max, hit_record& rec, const LeafHit& leaf_hit) const {
+            return dispatch_isa([&](auto isa) { return closest_hit(isa, r, t_min, t_max, rec, leaf_hit); });
+        }
+
+        template <class LeafHit>
+        unsigned closest_hits(
+            const ray* rays, int count, double t_min, double t_max, hit_record* recs,
+            const LeafHit& leaf_hit) const {
+            return dispatch_isa([&](auto isa) { return closest_hits(isa, rays, count, t_min, t_max, recs, leaf_hit); });
+        }
+
+        // The same at the level of isa, for callers that dispatch themselves so
+        // their leaf tests know the level too.
+        template <class Isa, class LeafHit>
+        bool closest_hit(
+            Isa isa, const ray& r, double t_min, double t_max, hit_record& rec, const LeafHit& leaf_hit) const;
+
+        template <class Isa, class LeafHit>
+        unsigned closest_hits(
+            Isa isa, const ray* rays, int count, double t_min, double t_max, hit_record* recs,
+            const LeafHit& leaf_hit) const;
+
+    public:
+        std::vector<wide_bvh_node<N>> nodes;
+        std::vector<shared_ptr<hittable>> objects;
+        std::vector<const hittable*> leaf_objects;
+        std::vector<uint32_t> leaf_indices;     // bvh_primitive::index of each leaf primitive
+        aabb bounds;
+
+        static const int max_stack = 64 * N;
+
+    private:
+        void collapse_all(linear_bvh& binary, const bvh_build_stats& binary_stats,
+                          std::chrono::steady_clock::time_point start_time, bvh_build_stats* stats);
+        int32_t collapse(const linear_bvh& binary, uint32_t index);
+};
+
+
+template <int N>
+wide_bvh<N>::wide_bvh(const hittable_list& list, double time0, double time1, bvh_build_stats* stats,
+                      const bvh_build_options& build) {
+    auto start_time = std::chrono::steady_clock::now();
+
+    bvh_build_stats binary_stats;
+    linear_bvh binary(list, time0, time1, &binary_stats, build);
+    collapse_all(binary, binary_stats, start_time, stats);
+}
+
+template <int N>
+wide_bvh<N>::wide_bvh(std::vector<bvh_primitive>& primitives, bvh_build_stats* stats,
+                      const bvh_build_options& build) {
+    auto start_time = std::chrono::steady_clock::now();
+
+    bvh_build_stats binary_stats;
+    linear_bvh binary(primitives, &binary_stats, build);
+    collapse_all(binary, binary_stats, start_time, stats);
+}
+
+
+template <int N>
+void wide_bvh<N>::collapse_all(linear_bvh& binary, const bvh_build_stats& binary_stats,
+                               std::chrono::steady_clock::time_point start_time, bvh_build_stats* stats) {
+    if (binary.nodes.empty())
+        return;
+
+    binary.bounding_box(0, 0, bounds);
+    nodes.reserve(binary.nodes.size() / (N / 2) + 1);
+    collapse(binary, 0);
+
+    objects = std::move(binary.objects);
+    leaf_objects = std::move(binary.leaf_objects);
+    leaf_indices = std::move(binary.leaf_indices);
+
+    if (stats) {
+        *stats = binary_stats;
+        stats->node_count = nodes.size();
+        stats->build_seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    }
+}
+
+
+template <int N>
+int32_t wide_bvh<N>::collapse(const linear_bvh& binary, uint32_t index) {
+    auto area = [&](uint32_t i) {
+        const auto& n = binary.nodes[i];
+        double a = n.bounds_max[0] - n.bounds_min[0];
+        double b = n.bounds_max[1] - n.bounds_min[1];
+        double c = n.bounds_max[2] - n.bounds_min[2];
+        return a*b + b*c + c*a;
+    };
+
+    // Open the largest interior child until the node is full.
+    uint32_t children[N];
+    int child_count = 0;
+    if (binary.nodes[index].count > 0) {
+        children[child_count++] = index;
+    } else {
+        children[child_count++] = index + 1;
+        children[child_count++] = binary.nodes[index].offset;
+        while (child_count < N) {
+            int best = -1;
+            for (int k = 0; k < child_count; k++)
+                if (binary.nodes[children[k]].count == 0 && (best < 0 || area(children[k]) > area(children[best])))
+                    best = k;
+            if (best < 0)
+                break;
+
+            uint32_t opened = children[best];
+            children[best] = opened + 1;
+            children[child_count++] = binary.nodes[opened].offset;
+        }
+    }
+
+    auto wide_index = static_cast<int32_t>(nodes.size());
+    nodes.emplace_back();
+
+    wide_bvh_node<N> node;
+    for (int k = 0; k < N; k++) {
+        node.min_x[k] = node.min_y[k] = node.min_z[k] = INFINITY;
+        node.max_x[k] = node.max_y[k] = node.max_z[k] = -INFINITY;
+        node.child[k] = -1;
+        node.count[k] = 0;
+    }
+    node.num_children = static_cast<uint8_t>(child_count);
+
+    for (int k = 0; k < child_count; k++) {
+        const auto& c = binary.nodes[children[k]];
+        node.min_x[k] = c.bounds_min[0]; node.min_y[k] = c.bounds_min[1]; node.min_z[k] = c.bounds_min[2];
+        node.max_x[k] = c.bounds_max[0]; node.max_y[k] = c.bounds_max[1]; node.max_z[k] = c.bounds_max[2];
+        if (c.count > 0) {
+            node.child[k] = static_cast<int32_t>(c.offset);
+            node.count[k] = c.count;
+        } else {
+            node.child[k] = collapse(binary, children[k]);
+        }
+    }
+
+    nodes[wide_index] = node;
+    return wide_index;
+}
+
+
+template <int N>
+bool wide_bvh<N>::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+    return closest_hit(r, t_min, t_max, rec,
+        [this](int i, const ray& r, double t_min, double t_max, hit_record& rec) {
+            return leaf_objects[i]->hit(r, t_min, t_max, rec);
+        });
+}
+
+template <int N>
+unsigned wide_bvh<N>::hit_packet(
+    const ray* rays, int count, double t_min, double t_max, hit_record* recs
+) const {
+    return closest_hits(rays, count, t_min, t_max, recs,
+        [this](int i, const ray& r, double t_min, double t_max, hit_record& rec) {
+            return leaf_objects[i]->hit(r, t_min, t_max, rec);
+        });
+}
+
+
+template <int N>
+template <class Isa, class LeafHit>
+bool wide_bvh<N>::closest_hit(
+    Isa isa, const ray& r, double t_min, double t_max, hit_record& rec, const LeafHit& leaf_hit
+) const {
+    if (nodes.empty())
+        return false;
+
+    wide_ray wr;
+    for (int a = 0; a < 3; a++) {
+        wr.origin[a] = static_cast<float>(r.origin()[a]);
+        // Axis-parallel rays get a huge finite reciprocal, so 0 * inf never makes a NaN.
+        double d = r.direction()[a];
+        wr.inv_dir[a] = std::fabs(d) > 1e-30 ? static_cast<float>(1 / d) : std::copysign(1e30f, static_cast<float>(d));
+    }
+    wr.t_min = static_cast<float>(t_min);
+    wr.t_max = next_float_up(static_cast<float>(t_max));
+
+    struct entry {
+        int32_t child;
+        uint16_t count;
+        float t_near;
+    };
+
+    entry stack[max_stack];
+    int stack_size = 0;
+    stack[stack_size++] = { 0, 0, wr.t_min };
+    bool hit_anything = false;
+
+    while (stack_size > 0) {
+        entry e = stack[--stack_size];
+        if (e.t_near > wr.t_max)
+            continue;
+
+        if (e.count > 0) {
+            for (int i = e.child; i < e.child + e.count; i++) {
+                if (leaf_hit(i, r, t_min, t_max, rec)) {
+                    hit_anything = true;
+                    t_max = rec.t;
+                    wr.t_max = next_float_up(static_cast<float>(t_max));
+                }
+            }
+            continue;
+        }
+
+        const auto& node = nodes[e.child];
+        RT_COUNT(thread_counters().box_tests += node.num_children);
+        float t_near[N];
+        unsigned mask = intersect_children(isa, node, wr, t_near) & ((1u << node.num_children) - 1);
+
+        // Push the hit children farthest first, so the nearest one is popped next.
+        int first = stack_size;
+        for (int k = 0; k < N; k++) {
+            if (!(mask & (1u << k)))
+                continue;
+            entry c = { node.child[k], node.count[k], t_near[k] };
+            int slot = stack_size++;
+            while (slot > first && stack[slot-1].t_near < c.t_near) {
+                stack[slot] = stack[slot-1];
+                slot--;
+            }
+            stack[slot] = c;
+        }
+    }
+
+    return hit_anything;
+}
+
+
+template <int N>
+template <class Isa, class LeafHit>
+unsigned wide_bvh<N>::closest_hits(
+    Isa isa, const ray* rays, int count, double t_min, double t_max, hit_record* recs,
+    const LeafHit& leaf_hit
+) const {
+    if (nodes.empty() || count <= 0)
+        return 0;
+
+    ray_packet packet(rays, count, t_min, t_max);
+    double closest[packet_size];
+    for (int k = 0; k < packet_size; k++)
+        closest[k] = t_max;
+
+    struct entry {
+        int32_t child;
+        uint16_t count;
+        unsigned lanes;     // rays of the packet that reached this entry
+        float t_near;       // closest entry distance over those rays
+    };
+
+    entry stack[max_stack];
+    int stack_size = 0;
+    stack[stack_size++] = { 0, 0, packet.active_mask(), packet.t_min[0] };
+    unsigned hit_lanes = 0;
+
+    while (stack_size > 0) {
+        entry e = stack[--stack_size];
+
+        // Drop the rays that have already found something closer than this entry.
+        unsigned lanes = 0;
+        for (unsigned m = e.lanes; m; m &= m - 1) {
+            int k = __builtin_ctz(m);
+            if (e.t_near <= packet.t_max[k])
+                lanes |= 1u << k;
+        }
+        if (!lanes)
+            continue;
+
+        if (e.count > 0) {
+            // Leaves are intersected one ray at a time.
+            for (; lanes; lanes &= lanes - 1) {
+                int k = __builtin_ctz(lanes);
+                for (int i = e.child; i < e.child + e.count; i++) {
+                    if (leaf_hit(i, rays[k], t_min, closest[k], recs[k])) {
+                        hit_lanes |= 1u << k;
+                        closest[k] = recs[k].t;
+                        packet.t_max[k] = next_float_up(static_cast<float>(closest[k]));
+                    }
+                }
+            }
+            continue;
+        }
+
+        // Push the children the packet hits, farthest first.
+        const auto& node = nodes[e.child];
+        RT_COUNT(thread_counters().box_tests += node.num_children * __builtin_popcount(lanes));
+        int first = stack_size;
+        for (int k = 0; k < node.num_children; k++) {
+            const float bmin[3] = { node.min_x[k], node.min_y[k], node.min_z[k] };
+            const float bmax[3] = { node.max_x[k], node.max_y[k], node.max_z[k] };
+            float t_near[packet_size];
+            unsigned child_lanes = packet_hits_box(isa, packet, bmin, bmax, t_near) & lanes;
+            if (!child_lanes)
+                continue;
+
+            entry c = { node.child[k], node.count[k], child_lanes, INFINITY };
+            for (unsigned m = child_lanes; m; m &= m - 1)
+                c.t_near = std::min(c.t_near, t_near[__builtin_ctz(m)]);
+
+            int slot = stack_size++;
+            while (slot > first && stack[slot-1].t_near < c.t_near) {
+                stack[slot] = stack[slot-1];
+                slot--;
+            }
+            stack[slot] = c;
+        }
+    }
+
+    return hit_lanes;
+}
+
+#endif /* wide_bvh_h */